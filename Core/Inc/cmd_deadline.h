@@ -0,0 +1,50 @@
+/*
+ * cmd_deadline.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_CMD_DEADLINE_H_
+#define INC_CMD_DEADLINE_H_
+
+#include "main.h"
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CMD_DEADLINE_CLASSES	8
+#define CMD_DEADLINE_NONE		0		// deadline_ms value for a command that only has a class
+
+// OW_CTRL_DEADLINE sub commands, carried in cmd->reserved
+typedef enum {
+	CMD_DEADLINE_OP_WRAP = 0,	// cmd_deadline_hdr_t then the command's data, answered as that command
+	CMD_DEADLINE_OP_STATUS = 1,	// -> cmd_deadline_status_t, now_ms is the clock deadlines are in
+	CMD_DEADLINE_OP_FLUSH = 2,	// u8 class mask, drops wrapped commands of those classes queued ahead
+} CmdDeadlineOp;
+
+typedef struct __attribute__((packed)) {
+	uint32_t deadline_ms;	// device HAL tick, stale once passed
+	uint8_t cls;			// flush class, 0..CMD_DEADLINE_CLASSES-1
+	uint8_t packet_type;	// the wrapped command
+	uint8_t command;
+	uint8_t addr;
+	uint8_t reserved;
+	uint8_t pad;
+} cmd_deadline_hdr_t;
+
+typedef struct __attribute__((packed)) {
+	uint32_t now_ms;
+	uint32_t executed;		// wrapped commands run in time
+	uint32_t expired;		// dropped past their deadline
+	uint32_t flushed;		// dropped by a FLUSH behind them
+	uint32_t max_late_ms;	// worst lateness of a dropped command
+} cmd_deadline_status_t;
+
+// host batch handling, offsets are frame positions within the batch
+void cmd_deadline_batch_start(void);
+void cmd_deadline_scan(const UartPacket *cmd, uint16_t offset);
+uint8_t cmd_deadline_unwrap(UartPacket *cmd, uint16_t offset);
+
+void cmd_deadline_process(UartPacket *cmd, UartPacket *resp);
+
+#endif /* INC_CMD_DEADLINE_H_ */
@@ -0,0 +1,84 @@
+/*
+ * cmd_macro.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_CMD_MACRO_H_
+#define INC_CMD_MACRO_H_
+
+#include "main.h"
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CMD_MACRO_SLOTS			8
+#define CMD_MACRO_VERSION		1		// kv_store record version
+#define CMD_MACRO_NAME_LEN		12
+#define CMD_MACRO_REC_MAX		1024	// live capture buffer, longer macros go in with WRITE
+#define CMD_MACRO_NO_STEP		0xFFFF
+
+// what starts a stored macro besides CMD_MACRO_OP_RUN
+#define CMD_MACRO_EVT_BOOT		0x01	// once the module is configured after reset
+#define CMD_MACRO_EVT_SEQ_DONE	0x02	// trigger sequence ran to the end
+#define CMD_MACRO_EVT_EXT		0x04	// rising edge on GPIO_1
+
+// OW_CTRL_MACRO sub commands, carried in cmd->reserved
+typedef enum {
+	CMD_MACRO_OP_STATUS = 0,	// -> cmd_macro_status_t
+	CMD_MACRO_OP_LIST = 1,		// -> cmd_macro_info_t per stored slot
+	CMD_MACRO_OP_RECORD = 2,	// u8 slot, u8 events, name; host commands are captured until END
+								// no data drops a capture in progress
+	CMD_MACRO_OP_END = 3,		// store the capture
+	CMD_MACRO_OP_WRITE = 4,		// u8 slot, u8 rsvd, u16 total len, u16 offset, chunk of the record
+	CMD_MACRO_OP_RUN = 5,		// u8 slot
+	CMD_MACRO_OP_DELETE = 6,	// u8 slot
+} CmdMacroOp;
+
+/* Stored record, little endian: the header, then per step a
+ * cmd_macro_step_t followed by its data_len bytes. */
+typedef struct __attribute__((packed)) {
+	uint8_t events;
+	uint8_t reserved;
+	uint16_t steps;
+	char name[CMD_MACRO_NAME_LEN];
+} cmd_macro_hdr_t;
+
+typedef struct __attribute__((packed)) {
+	uint8_t packet_type;
+	uint8_t command;
+	uint8_t addr;
+	uint8_t reserved;
+	uint16_t data_len;
+} cmd_macro_step_t;
+
+typedef struct __attribute__((packed)) {
+	uint8_t slot;
+	uint8_t events;
+	uint16_t steps;
+	uint16_t len;
+	char name[CMD_MACRO_NAME_LEN];
+} cmd_macro_info_t;
+
+typedef struct __attribute__((packed)) {
+	uint8_t recording;
+	uint8_t rec_slot;
+	uint16_t rec_steps;
+	uint16_t rec_len;		// bytes captured so far, header included
+	uint8_t last_slot;
+	uint8_t last_events;	// what started it, 0 for a RUN command
+	uint16_t last_steps;	// steps executed
+	uint16_t failed_step;	// CMD_MACRO_NO_STEP when all of them succeeded
+	uint8_t failed_type;	// response packet type of the failed step
+	uint8_t failed_reserved;
+	uint32_t last_us;
+	uint32_t runs;
+} cmd_macro_status_t;
+
+void cmd_macro_init(void);
+void cmd_macro_run_pending(void);
+void cmd_macro_event(uint8_t events);
+void cmd_macro_record(const UartPacket *cmd, const UartPacket *resp);
+void cmd_macro_process(UartPacket *cmd, UartPacket *resp);
+
+#endif /* INC_CMD_MACRO_H_ */
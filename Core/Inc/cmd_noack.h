@@ -0,0 +1,56 @@
+/*
+ * cmd_noack.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_CMD_NOACK_H_
+#define INC_CMD_NOACK_H_
+
+#include "main.h"
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* A host frame with this bit set in its packet type (0xE2 -> 0xF2 and so
+ * on) is run without a response.  Only a failure is kept, in the log
+ * below, until the host reads and clears it. */
+#define CMD_NOACK_FLAG			0x10
+#define CMD_NOACK_LOG_LEN		16
+
+// OW_CTRL_NOACK sub commands, carried in cmd->reserved
+typedef enum {
+	CMD_NOACK_OP_STATUS = 0,	// -> cmd_noack_status_t then count x cmd_noack_entry_t
+	CMD_NOACK_OP_CLEAR = 1,		// empties the log, answered with the status from before
+	CMD_NOACK_OP_REPORTS = 2,	// u8 1/0, also send each failure as an OW_ERROR frame with its id
+} CmdNoackOp;
+
+typedef struct __attribute__((packed)) {
+	uint16_t id;			// packet id the host sent it with
+	uint8_t packet_type;
+	uint8_t command;
+	uint8_t addr;
+	uint8_t module;			// that reported it, 0 for the master
+	uint8_t result;			// reply packet type, OW_ERROR or OW_TIMEOUT when a slave never finished
+	uint8_t code;			// reply reserved, the error code where there is one
+} cmd_noack_entry_t;
+
+typedef struct __attribute__((packed)) {
+	uint32_t executed;		// frames run without a response
+	uint32_t failed;
+	uint32_t lost;			// failures after the log was full
+	uint8_t count;			// entries in the log
+	uint8_t reports;		// async error frames enabled
+	uint16_t reserved;
+} cmd_noack_status_t;
+
+bool cmd_noack_strip(UartPacket *cmd);
+void cmd_noack_begin(void);
+bool cmd_noack_active(void);
+void cmd_noack_done(const UartPacket *cmd, const UartPacket *resp);
+void cmd_noack_fail(const UartPacket *cmd, uint8_t module, uint8_t result, uint8_t code);
+bool cmd_noack_next_report(UartPacket *frame);
+
+void cmd_noack_process(UartPacket *cmd, UartPacket *resp);
+
+#endif /* INC_CMD_NOACK_H_ */
@@ -19,6 +19,7 @@
 // Configuration: each module has two transmitters; adjust as necessary.
 #define TX_PER_MODULE 2
 #define MAX_MODULES   6  // Total number of modules (master + slaves)
+#define OW_ALL_MODULES 0xFF  // controller command addr for every module, see CONTROLLER_FanOut
 
 #ifndef FW_VERSION
 #define FW_VERSION "unknown"
@@ -66,6 +67,8 @@ typedef enum {
 
 typedef enum {
 	OW_SUCCESS = 0x00,
+	OW_CACHE_MISS = 0xFA,
+	OW_EXPIRED = 0xFB,
 	OW_UNKNOWN_COMMAND = 0xFC,
 	OW_BAD_CRC = 0xFD,
 	OW_INVALID_PACKET = 0xFE,
@@ -81,8 +84,10 @@ typedef enum {
 	OW_CMD_HWID = 0x05,
 	OW_CMD_GET_TEMP = 0x06,
 	OW_CMD_GET_AMBIENT = 0x07,
+	OW_CMD_CREDIT = 0x08,
 	OW_CMD_ASYNC = 0x09,
 	OW_CMD_USR_CFG = 0x0A,
+	OW_CMD_FW_UPDATE = 0x0B,
 	OW_CMD_DISCOVERY = 0x0C,
 	OW_CMD_DFU = 0x0D,
 	OW_CMD_NOP = 0x0E,
@@ -100,6 +105,19 @@ typedef enum {
 	OW_CTRL_STATUS_SWTRIG = 0x17,
 	OW_CTRL_SET_HV = 0x18,
 	OW_CTRL_GET_HV = 0x19,
+	OW_CTRL_TX_POWER = 0x1A,
+	OW_CTRL_LINK = 0x1B,
+	OW_CTRL_KV = 0x1C,
+	OW_CTRL_TX_CAL = 0x1D,
+	OW_CTRL_PROFILE = 0x1E,
+	OW_CTRL_MACRO = 0x1F,
+	// 0x20-0x2F are TX7332 and 0x30-0x3F AFE commands, slaves tell them apart by range
+	OW_CTRL_INTERLOCK = 0x40,
+	OW_CTRL_DEADLINE = 0x41,
+	OW_CTRL_TX_TCOMP = 0x42,
+	OW_CTRL_PROFILE_CACHE = 0x43,
+	OW_CTRL_NOACK = 0x44,
+	OW_CTRL_COALESCE = 0x45,
 } UstxControllerCommands;
 
 typedef enum {
@@ -111,6 +129,9 @@ typedef enum {
 	OW_TX7332_VWREG = 0x25,
 	OW_TX7332_VWBLOCK = 0x26,
 	OW_TX7332_RBLOCK = 0x27,
+	OW_TX7332_SCATTER = 0x28,
+	OW_TX7332_PATTERN = 0x29,
+	OW_TX7332_APPLY = 0x2A,
 	OW_TX7332_DEVICE_COUNT = 0x2C,
 	OW_TX7332_DEMO = 0x2D,
 	OW_TX7332_RESET = 0x2F,
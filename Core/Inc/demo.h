@@ -14,6 +14,7 @@
 extern unsigned int reg_values[][2];
 extern unsigned int reg_1mhz_3p_values[][2];
 
+int get_demo_register_count(void);
 void write_demo_registers(TX7332* pT);
 bool verify_demo_registers(TX7332* pT);
 void write_test_pattern_registers(TX7332* pT);
@@ -16,6 +16,8 @@
 HAL_StatusTypeDef Flash_Write(uint32_t address, const void *src, uint32_t size_bytes);
 HAL_StatusTypeDef Flash_Read(uint32_t address, void *dst, uint32_t size_bytes);
 HAL_StatusTypeDef Flash_Erase(uint32_t start_address, uint32_t end_address);
+HAL_StatusTypeDef Flash_Commit(uint32_t address, const void *src, uint32_t size_bytes);
+int Flash_IsErased(uint32_t address, uint32_t size_bytes);
 
 
 #endif /* INC_FLASH_EEPROM_H_ */
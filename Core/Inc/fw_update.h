@@ -0,0 +1,72 @@
+/*
+ * fw_update.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_FW_UPDATE_H_
+#define INC_FW_UPDATE_H_
+
+#include "main.h"
+#include "common.h"
+#include "memory_map.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FW_UPD_BLOCK_SIZE		1024U
+#define FW_UPD_MAX_BLOCKS		(FW_STAGING_MAX_IMAGE / FW_UPD_BLOCK_SIZE)
+#define FW_UPD_SHA_LEN			41		// NUL padded FW_SHA string
+#define FW_UPD_DESC_MAGIC		0x4657574FU	// 'OWFW'
+
+// OW_CMD_FW_UPDATE sub commands, carried in cmd->reserved
+typedef enum {
+	FW_UPD_INFO = 0,		// -> fw_update_info_t
+	FW_UPD_MANIFEST = 1,	// u16 first block, u8 count -> count x crc32 of the running image
+	FW_UPD_BEGIN = 2,		// u32 size, u32 crc32, base_sha[41], new_sha[41]
+	FW_UPD_BLOCK = 3,		// u16 index, u8 encoding, u8 rsvd, u32 crc32 of decoded block, payload
+	FW_UPD_COMMIT = 4,		// verify staged image, request install on next reset (A/B: mark the slot valid)
+	FW_UPD_ABORT = 5,
+	FW_UPD_ACTIVATE = 6,	// reset into the committed image (A/B: trial boot of the other slot)
+} FwUpdateOp;
+
+typedef enum {
+	FW_BLK_COPY = 0,		// payload empty (same index) or u16 source block of the running image
+	FW_BLK_RAW = 1,			// payload is the block
+	FW_BLK_RLE = 2,			// ctrl < 0x80: ctrl+1 literals follow, else next byte repeated ctrl-0x80+3 times
+} FwBlockEncoding;
+
+typedef enum {
+	FW_UPD_IDLE = 0,
+	FW_UPD_RECEIVING = 1,
+	FW_UPD_COMMITTED = 2,
+} FwUpdateState;
+
+typedef struct __attribute__((packed)) {
+	uint32_t block_size;
+	uint32_t running_size;
+	uint32_t max_image_size;
+	uint16_t blocks_total;
+	uint16_t blocks_received;
+	uint8_t state;
+	char sha[FW_UPD_SHA_LEN];
+	uint32_t running_base;		// slot the running image was linked for
+	uint32_t target_base;		// where an update goes, the image must be linked for it
+	uint32_t running_seq;		// descriptor sequence of the running slot, 0 when it has none
+	uint8_t ab_slots;			// 1: FW_AB_SLOTS build, 0: target_base is the staging area
+} fw_update_info_t;
+
+// written to the last page of the target slot on commit
+typedef struct __attribute__((packed)) {
+	uint32_t magic;
+	uint32_t image_size;
+	uint32_t image_crc32;
+	char sha[FW_UPD_SHA_LEN];
+	uint8_t reserved[3];
+	uint32_t seq;				// A/B: the bootloader prefers the valid slot with the higher seq
+	uint32_t desc_crc32;		// over all preceding fields
+} fw_image_desc_t;
+
+void fw_update_process(UartPacket *cmd, UartPacket *resp);
+
+#endif /* INC_FW_UPDATE_H_ */
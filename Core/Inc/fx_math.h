@@ -0,0 +1,57 @@
+/*
+ * fx_math.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_FX_MATH_H_
+#define INC_FX_MATH_H_
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Fixed point types.  q16_t is Q16.16 (range +-32768, LSB 1.5e-5), q15_t
+ * is Q1.15 / a saturating 16 bit channel value, q31_t is Q1.31. */
+typedef int32_t q16_t;
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define FX_Q16_ONE			((q16_t)0x10000)
+#define FX_Q16_MAX			((q16_t)0x7FFFFFFF)
+#define FX_Q16_MIN			((q16_t)(-0x7FFFFFFF - 1))
+
+// compile time constants only, the double arithmetic folds away
+#define FX_Q16(x)			((q16_t)((x) * 65536.0 + ((x) >= 0 ? 0.5 : -0.5)))
+#define FX_Q16_INT(x)		((q16_t)((uint32_t)(x) << 16))
+
+/* Error against double precision (LSB = 2^-16), as checked by
+ * tools/fx_math_check.py: fx_div_q16 over 2e7 random arguments spread
+ * across the whole input range, the others over every argument:
+ *   fx_div_q16     0.5 LSB, correctly rounded, saturates on overflow
+ *   fx_recip_q16   0.5 LSB
+ *   fx_log2_q16    0.50004 LSB, x <= 0 returns FX_Q16_MIN
+ *   fx_ln_q16      0.85 LSB
+ *   fx_exp2_q16    0.5 LSB + 3e-9 relative, saturates above 2^15
+ *   fx_exp_q16     0.5 LSB + 5e-9 relative
+ *   fx_sqrt_q16    floor, under 1 LSB
+ * Apart from fx_q16_to_float none of them use floating point. */
+q16_t fx_mul_q16(q16_t a, q16_t b);
+q16_t fx_div_q16(q16_t num, q16_t den);
+q16_t fx_recip_q16(q16_t x);
+q16_t fx_log2_q16(q16_t x);
+q16_t fx_ln_q16(q16_t x);
+q16_t fx_exp2_q16(q16_t x);
+q16_t fx_exp_q16(q16_t x);
+q16_t fx_sqrt_q16(q16_t x);
+uint32_t fx_isqrt_u32(uint32_t x);
+float fx_q16_to_float(q16_t x);
+
+/* Channel arrays, saturating to the int16 range.  dst may alias a source.
+ * scale is Q1.15 applied after a left shift, so 0.75 with shift 2 is 3.0. */
+void fx_vadd_q15(const q15_t *a, const q15_t *b, q15_t *dst, uint32_t n);
+void fx_voffset_q15(const q15_t *src, q15_t offset, q15_t *dst, uint32_t n);
+void fx_vscale_q15(const q15_t *src, q15_t scale, uint8_t shift, q15_t *dst, uint32_t n);
+void fx_vclamp_q15(const q15_t *src, q15_t lo, q15_t hi, q15_t *dst, uint32_t n);
+
+#endif /* INC_FX_MATH_H_ */
@@ -12,6 +12,34 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+/* MAX31875 registers, config bits and the limits programmed at boot */
+#define MAX31875_REG_TEMP		0x00
+#define MAX31875_REG_CONFIG		0x01
+#define MAX31875_REG_THYST		0x02
+#define MAX31875_REG_TOS		0x03
+
+#define MAX31875_CFG_OT_STATUS	(1U << 15)	// read only, comparator output
+#define MAX31875_CFG_FAULTQ_2	(1U << 11)	// two faults in a row before OT sets
+#define MAX31875_CFG_RES_12BIT	(3U << 5)
+#define MAX31875_CFG_RATE_4HZ	(2U << 1)
+#define MAX31875_CONFIG			(MAX31875_CFG_FAULTQ_2 | MAX31875_CFG_RES_12BIT | MAX31875_CFG_RATE_4HZ)
+
+#define MAX31875_TOS_C			70.0f
+#define MAX31875_THYST_C		65.0f
+#define MAX31875_SAMPLE_MS		250		// matches the 4 conversions/s rate
+
+#define I2C_GLOBAL_READ_TIMEOUT	500		// ms, each phase of a slave packet read, a full packet included
+
+/* One entry of a chained, interrupt driven transmit on the global bus.
+ * status is filled in by the completion / error callbacks. */
+typedef struct {
+	uint8_t slave_addr;
+	uint8_t* pBuffer;
+	uint16_t buf_len;
+	volatile HAL_StatusTypeDef status;
+	volatile uint32_t done_cycles;	// DWT cycle count when the last byte went out
+} I2C_Async_Transfer;
+
 void I2C_scan_local(void);
 void I2C_scan_global(void);
 uint8_t send_buffer_to_slave_global(uint8_t slave_addr, uint8_t* pBuffer, uint16_t buf_len);
@@ -24,6 +52,15 @@ uint8_t read_raw_from_slave_global(uint8_t slave_addr, uint8_t* pBuffer, size_t
 uint16_t I2C_read_CDCE6214_reg(uint8_t i2c_addr, uint16_t reg_addr);
 bool I2C_write_CDCE6214_reg(uint8_t i2c_addr, uint16_t reg_addr, uint16_t reg_val);
 
-float MAX31875_ReadTemperature(void);
+bool i2c_master_async_start(I2C_Async_Transfer* xfers, uint8_t count);
+bool i2c_master_async_busy(void);
+bool i2c_master_async_wait(uint32_t timeout_ms);
+bool i2c_master_handle_error(I2C_HandleTypeDef *hi2c);
+
+bool MAX31875_Init(void);
+bool MAX31875_StartRead(void);
+bool MAX31875_OverTemp(void);
+uint32_t MAX31875_TripCount(void);
+void MAX31875_Process(void);
 
 #endif /* INC_I2C_MASTER_H_ */
@@ -15,6 +15,12 @@
 
 #define I2C_BUFFER_SIZE 2080
 
+// reserved value (OW_NAK) a slave reports while still processing a packet
+#define I2C_SLAVE_BUSY 0xE1
+
+// tx_id bit: the master won't read the reply, only whether it worked (cmd_noack)
+#define I2C_FLAG_NOACK 0x80
+
 typedef struct {
 	uint16_t pkt_len;
 	uint16_t id;
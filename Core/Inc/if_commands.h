@@ -22,4 +22,18 @@
 
 bool process_if_command(UartPacket *cmd, UartPacket *resp);
 
+// overlap relayed slave work with local chip work in a host batch
+bool if_command_is_local(const UartPacket *cmd);
+bool if_relay_queue(UartPacket *cmd);
+void if_relay_launch(void);
+void if_relay_abandon(void);
+
+// check the slaves still working on a relay nobody waited for
+void if_relay_noack_settle(void);
+
+// a command of the master's own to one slave, true if it answered OW_RESP
+bool if_relay_command(uint8_t module_id, UartPacket *cmd);
+// queue one to go out with if_relay_launch, if_relay_command then only reads the reply
+bool if_relay_post(uint8_t module_id, UartPacket *cmd);
+
 #endif /* INC_IF_COMMANDS_H_ */
@@ -0,0 +1,46 @@
+/*
+ * interlock.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_INTERLOCK_H_
+#define INC_INTERLOCK_H_
+
+#include "main.h"
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define INTERLOCK_BREAK_FILTER	1	// BKIN sampled at fCK_INT, 2 in a row, ~40 ns at 48 MHz
+
+typedef enum {
+	INTERLOCK_CAUSE_NONE = 0,
+	INTERLOCK_CAUSE_LINE = 1,		// the shared line went low, pulled by another module
+	INTERLOCK_CAUSE_HOST = 2,		// INTERLOCK_OP_TRIP
+	INTERLOCK_CAUSE_OVERTEMP = 3,	// ambient sensor past Tos
+} InterlockCause;
+
+// OW_CTRL_INTERLOCK sub commands, carried in cmd->reserved
+typedef enum {
+	INTERLOCK_OP_STATUS = 0,	// -> interlock_status_t
+	INTERLOCK_OP_TRIP = 1,		// assert from this module
+	INTERLOCK_OP_CLEAR = 2,		// release and re-arm, refused while the cause is still there
+} InterlockOp;
+
+typedef struct __attribute__((packed)) {
+	uint8_t master;			// 1: owns the trigger, line is the TIM15 break input
+	uint8_t tripped;
+	uint8_t cause;			// InterlockCause latched at the trip
+	uint8_t line_low;		// level of the shared line now
+	uint32_t trips;
+	uint32_t trip_tick;		// HAL tick of the last trip
+} interlock_status_t;
+
+void interlock_init(bool master);
+void interlock_timer_config(TIM_HandleTypeDef *htim);
+void interlock_trip(InterlockCause cause);
+bool interlock_tripped(void);
+void interlock_process(UartPacket *cmd, UartPacket *resp);
+
+#endif /* INC_INTERLOCK_H_ */
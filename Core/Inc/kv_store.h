@@ -0,0 +1,76 @@
+/*
+ * kv_store.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_KV_STORE_H_
+#define INC_KV_STORE_H_
+
+#include "main.h"
+#include "common.h"
+#include "memory_map.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KV_BANK_MAGIC			0x564B574FU	// 'OWKV', bump if the record layout changes
+#define KV_BANK_HDR_SIZE		8U			// magic, seq
+#define KV_REC_HDR_SIZE			8U
+#define KV_MAX_KEYS				32
+#define KV_MAX_RECORD			(KV_STORE_BANK_SIZE - KV_BANK_HDR_SIZE - KV_REC_HDR_SIZE)
+#define KV_KEY_INVALID			0xFFFF
+
+// keys below KV_KEY_HOST_BASE belong to firmware modules, the rest to the host
+#define KV_KEY_HOST_BASE		0x0100
+#define KV_KEY_TX_CAL			0x0001	// tx_cal_table_t
+#define KV_KEY_TX_TCOMP			0x0002	// tx_tcomp_model_t
+#define KV_KEY_MACRO_BASE		0x0010	// CMD_MACRO_SLOTS keys, cmd_macro_hdr_t and steps
+#define KV_KEY_PCACHE_BASE		0x0020	// PROFILE_CACHE_PINNED keys, profile_cache_hdr_t and words
+
+#define KV_FLAG_DELETED			0x01
+
+// OW_CTRL_KV sub commands, carried in cmd->reserved
+typedef enum {
+	KV_OP_LIST = 0,			// -> u32 free bytes, kv_info_t per key
+	KV_OP_GET = 1,			// u16 key [, u16 offset] -> record bytes from offset
+	KV_OP_WRITE = 2,		// u16 key, u8 version, u8 rsvd, u16 total len, u16 offset, chunk
+	KV_OP_DELETE = 3,		// u16 key
+} KvOp;
+
+// on flash in front of every record, data follows padded to 8 bytes
+typedef struct __attribute__((packed)) {
+	uint16_t key;
+	uint16_t len;
+	uint8_t version;		// layout of the data, owned by whoever writes the key
+	uint8_t flags;
+	uint16_t crc;			// util_crc16 over key..flags and the data
+} kv_rec_hdr_t;
+
+typedef struct __attribute__((packed)) {
+	uint16_t key;
+	uint16_t len;
+	uint8_t version;
+	uint8_t reserved;
+} kv_info_t;
+
+// Whole records
+HAL_StatusTypeDef kv_store_set(uint16_t key, uint8_t version, const void *data, uint16_t len);
+HAL_StatusTypeDef kv_store_get(uint16_t key, void *dst, uint16_t max_len, uint16_t *len, uint8_t *version);
+HAL_StatusTypeDef kv_store_delete(uint16_t key);
+
+// Direct pointer to the record data in flash, NULL if the key is not stored.
+// Valid until the next write to the store.
+const void *kv_store_ptr(uint16_t key, uint16_t *len, uint8_t *version);
+
+// Records written in pieces, only visible once committed. One open at a time.
+HAL_StatusTypeDef kv_store_begin(uint16_t key, uint8_t version, uint16_t len);
+HAL_StatusTypeDef kv_store_append(const void *data, uint16_t len);
+HAL_StatusTypeDef kv_store_commit(void);
+
+uint16_t kv_store_list(kv_info_t *out, uint16_t max);
+uint32_t kv_store_free(void);
+
+void kv_store_process(UartPacket *cmd, UartPacket *resp);
+
+#endif /* INC_KV_STORE_H_ */
@@ -0,0 +1,73 @@
+/*
+ * link_monitor.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_LINK_MONITOR_H_
+#define INC_LINK_MONITOR_H_
+
+#include "main.h"
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LINK_CHECK_INTERVAL_MS	1000	// presence check of every slave
+#define LINK_HWID_INTERVAL_MS	10000	// HWID compare, one slave per interval
+#define LINK_MISS_LIMIT			2		// missed checks in a row before re-discovery
+#define LINK_READY_TIMEOUT_MS	500		// rediscovered slave bringing up its I2C address
+#define LINK_RETRY_MAX_MS		60000	// offline slave retried at doubling intervals up to this
+#define LINK_JOURNAL_SLAVES		4		// slaves whose TX7332 writes are kept for replay (RAM2)
+#define LINK_JOURNAL_REGS		0x1A0	// TX7332 register space, global through pattern profiles
+#define LINK_PROBE_IDLE_MS		200		// host quiet this long before the links are probed
+#define LINK_PROBE_INTERVAL_MS	250		// echo probe, one slave per interval
+#define LINK_PROBE_LEN			8
+#define LINK_POLL_US			250		// reply poll spacing while a slave reports busy
+#define LINK_RELAY_MIN_US		50000	// relay reply timeout floor, commands differ in cost
+#define LINK_RELAY_MAX_US		200000
+
+// OW_CTRL_LINK sub commands, carried in cmd->reserved
+typedef enum {
+	LINK_OP_STATUS = 0,
+	LINK_OP_ENABLE = 1,		// data[0]: 1 enable, 0 disable
+	LINK_OP_RECOVER = 2,	// force re-discovery and restore of module cmd->addr
+} LinkOp;
+
+typedef enum {
+	LINK_OK = 0,
+	LINK_MISSING = 1,		// not answering, recovery pending
+	LINK_OFFLINE = 2,		// re-discovery failed, retried with backoff
+} LinkState;
+
+typedef struct __attribute__((packed)) {
+	uint8_t state;
+	uint8_t misses;
+	uint16_t recoveries;
+	uint16_t journal_regs;	// registers cached for replay, 0xFFFF if no journal slot
+	uint16_t hwid_changes;
+	uint32_t hwid[3];
+	uint32_t srtt_us;		// smoothed slave turnaround, gain 1/8
+	uint32_t rttvar_us;		// its mean deviation, gain 1/4
+	uint32_t baseline_us;	// gain 1/64, srtt drifting above it is a degrading link
+	uint32_t rtt_min_us;
+	uint32_t rtt_max_us;
+	uint32_t samples;		// probes and relays timed
+	uint32_t errors;		// of those, lost, timed out or echoed back wrong
+	uint16_t error_rate;	// recent errors per 1000, gain 1/16
+} link_module_status_t;
+
+void link_monitor_init(void);
+void link_monitor_process(void);
+void link_monitor_enable(bool enable);
+bool link_monitor_enabled(void);
+bool link_monitor_recover(uint8_t module_id);
+const link_module_status_t *link_monitor_status(uint8_t *count);
+
+void link_rtt_sample(uint8_t module_id, uint32_t rtt_us, bool ok);
+uint32_t link_relay_first_poll_us(uint8_t module_id);
+uint32_t link_relay_timeout_us(uint8_t module_id);
+uint32_t link_elapsed_us(uint32_t since_cycles);
+
+void link_journal_write(uint8_t module_id, uint8_t local_tx, uint16_t reg, const uint8_t *le_values, uint16_t count);
+
+#endif /* INC_LINK_MONITOR_H_ */
@@ -56,6 +56,8 @@ void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
 void set_reconfigure();
+void bootloader_request_install(void);
+void bootloader_request_trial(uint32_t slot_base);
 
 /* USER CODE END EFP */
 
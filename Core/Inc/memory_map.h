@@ -143,9 +143,28 @@
  #define ADDR_FLASH_END_ADDRESS ((uint32_t)0x08040000) /* END OF FLASH */
 
 #define FLASH_START_ADDRESS        			((uint32_t)0x08000000)
-#define APPLICATION_ADDRESS        			((uint32_t)0x08010000) // 190 KB application region after metadata
+#define APPLICATION_ADDRESS        			((uint32_t)0x08010000) // 88 KB application region after metadata
 #define APPLICATION_USER_CONFIG    			((uint32_t)0x0803F800) // 2 KB user config region (page 127, end of flash), application use only -- not writable via DFU
-#define APPLICATION_MAX_SIZE                ((uint32_t)(190U * 1024U))
+#define APPLICATION_SLOT_SIZE               ((uint32_t)(88U * 1024U))
+#define APPLICATION_MAX_SIZE                APPLICATION_SLOT_SIZE
+
+/* Update staging area, same size as the application region.  The last page
+ * holds the image descriptor the bootloader checks before installing. */
+#define FW_STAGING_ADDRESS                  ((uint32_t)(APPLICATION_ADDRESS + APPLICATION_SLOT_SIZE)) // 0x08026000
+#define FW_STAGING_DESC_ADDRESS             ((uint32_t)(FW_STAGING_ADDRESS + APPLICATION_SLOT_SIZE - 0x800U))
+#define FW_STAGING_MAX_IMAGE                ((uint32_t)(APPLICATION_SLOT_SIZE - 0x800U))
+
+/* A/B builds (FW_AB_SLOTS): the staging area is the second application slot
+ * and each slot carries its own descriptor in its last page.  The bootloader
+ * boots the valid slot with the highest sequence number. */
+#define FW_SLOT_A_ADDRESS                   APPLICATION_ADDRESS
+#define FW_SLOT_B_ADDRESS                   FW_STAGING_ADDRESS
+#define FW_SLOT_DESC_OFFSET                 FW_STAGING_MAX_IMAGE
+
+/* Key/value record store between the staging area and the user config, two
+ * banks of three pages each.  Page 126 is left free. */
+#define KV_STORE_ADDRESS                    ((uint32_t)(FW_STAGING_ADDRESS + APPLICATION_SLOT_SIZE)) // 0x0803C000
+#define KV_STORE_BANK_SIZE                  ((uint32_t)(3U * 0x800U))
 
 #ifdef __cplusplus
 }
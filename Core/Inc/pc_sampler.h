@@ -0,0 +1,48 @@
+/*
+ * pc_sampler.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_PC_SAMPLER_H_
+#define INC_PC_SAMPLER_H_
+
+#include "main.h"
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PC_SAMPLE_BINS			1024	// uint16 counts, saturating
+#define PC_SAMPLE_RATE_HZ		1000	// default when START gives none
+#define PC_SAMPLE_RATE_MAX_HZ	20000
+
+// OW_CTRL_PROFILE sub commands, carried in cmd->reserved
+typedef enum {
+	PC_SAMPLE_OP_STATUS = 0,	// -> pc_sample_status_t
+	PC_SAMPLE_OP_START = 1,		// optional pc_sample_start_t, clears the histogram
+	PC_SAMPLE_OP_STOP = 2,
+	PC_SAMPLE_OP_DUMP = 3,		// data: first bin (uint16), -> up to DATA_MAX_SIZE / 2 bins
+} PcSampleOp;
+
+// zero fields take the default: PC_SAMPLE_RATE_HZ, the whole image from VTOR to _etext
+typedef struct __attribute__((packed)) {
+	uint32_t rate_hz;
+	uint32_t base;
+	uint8_t shift;			// bin = (pc - base) >> shift
+} pc_sample_start_t;
+
+typedef struct __attribute__((packed)) {
+	uint8_t running;
+	uint8_t shift;
+	uint16_t bins;
+	uint32_t base;
+	uint32_t rate_hz;		// actual, after rounding to the timer clock
+	uint32_t samples;
+	uint32_t outside;		// PC below base or past the last bin
+	uint32_t in_handler;	// taken while an interrupt of lower priority was running
+} pc_sample_status_t;
+
+void pc_sampler_process(UartPacket *cmd, UartPacket *resp);
+void pc_sampler_isr(const uint32_t *frame);
+
+#endif /* INC_PC_SAMPLER_H_ */
@@ -0,0 +1,75 @@
+/*
+ * profile_cache.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_PROFILE_CACHE_H_
+#define INC_PROFILE_CACHE_H_
+
+#include "main.h"
+#include "common.h"
+#include "tx7332.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PROFILE_CACHE_ENTRIES		12		// RAM, least recently used goes first
+#define PROFILE_CACHE_MAX_WORDS		32		// larger blocks are written but not kept
+#define PROFILE_CACHE_PINNED		8		// kv_store keys KV_KEY_PCACHE_BASE + n
+#define PROFILE_CACHE_APPLY_MAX		8		// hashes in one OW_TX7332_APPLY
+#define PROFILE_CACHE_VERSION		1		// kv_store record version of a pinned block
+
+/* A block is a successful OW_TX7332_WBLOCK / VWBLOCK, keyed by fnv1a_32
+ * over its data exactly as sent: u16 reg, u8 count, u8 rsvd, count words.
+ *
+ * OW_TX7332_APPLY data is 1..PROFILE_CACHE_APPLY_MAX u32 hashes, written
+ * in order to the chip in cmd->addr.  Nothing is written unless all of
+ * them are known.  The reply data is profile_cache_result_t; a miss is
+ * OW_ERROR with reserved OW_CACHE_MISS from the master (a slave answers
+ * it as a normal reply so it makes it back over I2C). */
+typedef struct __attribute__((packed)) {
+	uint8_t status;			// OW_SUCCESS or OW_CACHE_MISS
+	uint8_t index;			// first hash that missed
+} profile_cache_result_t;
+
+// OW_CTRL_PROFILE_CACHE sub commands, carried in cmd->reserved
+typedef enum {
+	PROFILE_CACHE_OP_STATUS = 0,	// -> profile_cache_status_t
+	PROFILE_CACHE_OP_LIST = 1,		// -> profile_cache_info_t per block, RAM then pinned
+	PROFILE_CACHE_OP_PIN = 2,		// u32 hash, copies a RAM block to flash, survives reset
+	PROFILE_CACHE_OP_UNPIN = 3,		// u32 hash
+	PROFILE_CACHE_OP_FLUSH = 4,		// forget the RAM blocks, pinned ones stay
+} ProfileCacheOp;
+
+// pinned record in the kv_store, the words follow
+typedef struct __attribute__((packed)) {
+	uint32_t hash;
+	uint16_t reg;
+	uint8_t count;
+	uint8_t reserved;
+} profile_cache_hdr_t;
+
+typedef struct __attribute__((packed)) {
+	uint32_t hash;
+	uint16_t reg;
+	uint8_t count;
+	uint8_t pinned;
+} profile_cache_info_t;
+
+typedef struct __attribute__((packed)) {
+	uint8_t entries;
+	uint8_t pinned;
+	uint16_t reserved;
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t stores;
+	uint32_t evictions;
+	uint32_t too_large;		// blocks over PROFILE_CACHE_MAX_WORDS, not kept
+} profile_cache_status_t;
+
+void profile_cache_store(const UartPacket *cmd, const UartPacket *resp);
+bool profile_cache_find(uint32_t hash, uint16_t *reg, uint8_t *count, const uint32_t **words);
+void profile_cache_apply(TX7332 *tx, const UartPacket *cmd, UartPacket *resp);
+void profile_cache_process(UartPacket *cmd, UartPacket *resp);
+
+#endif /* INC_PROFILE_CACHE_H_ */
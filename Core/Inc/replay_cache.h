@@ -0,0 +1,25 @@
+/*
+ * replay_cache.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_REPLAY_CACHE_H_
+#define INC_REPLAY_CACHE_H_
+
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define REPLAY_CACHE_ENTRIES	8
+#define REPLAY_CACHE_DATA_MAX	32		// largest response payload kept (scatter status, config header)
+
+// Returns true and fills resp with the stored response when cmd is an exact
+// retransmission of a write that already completed
+bool replay_cache_lookup(const UartPacket *cmd, UartPacket *resp);
+bool replay_cache_contains(const UartPacket *cmd);	// lookup without counting a hit
+void replay_cache_store(const UartPacket *cmd, const UartPacket *resp);
+void replay_cache_clear(void);
+uint32_t replay_cache_hits(void);
+
+#endif /* INC_REPLAY_CACHE_H_ */
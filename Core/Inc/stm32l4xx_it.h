@@ -80,6 +80,7 @@ void TIM7_IRQHandler(void);
 void LPTIM1_IRQHandler(void);
 void USB_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void EXTI15_10_IRQHandler(void);
 
 /* USER CODE END EFP */
 
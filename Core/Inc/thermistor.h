@@ -9,16 +9,28 @@
 #define INC_THERMISTOR_H_
 
 #include "main.h"  // Replace with your MCU HAL header
+#include "fx_math.h"
 
 // Define constants
 #define BETA 3380.0       // Beta coefficient of the thermistor
 #define T0 298.15         // 25°C in Kelvin
 #define R0 10000.0        // Resistance at 25°C (10K thermistor)
 
+// cmd->reserved of OW_CMD_GET_TEMP asking for thermistor_status_t instead of the bare reading
+#define THERM_GET_STATUS 1
+
+typedef struct __attribute__((packed)) {
+    float temperature;          // tx_temperature, Celsius
+    uint32_t conv_cycles;       // DWT cycles of the last fixed point conversion
+    uint32_t conv_max_cycles;   // worst since boot
+} thermistor_status_t;
+
 // Function prototypes
 void Thermistor_Start(ADC_HandleTypeDef *hadc, float vRef, float rPullUp);
 void Thermistor_Stop(void);
 float Thermistor_ReadTemperature(void);
+q16_t Thermistor_ReadTemperatureQ16(void);
+const thermistor_status_t *Thermistor_GetStatus(void);
 extern volatile float tx_temperature;
 extern volatile float ambient_temperature;
 
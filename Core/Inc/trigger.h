@@ -43,6 +43,7 @@ extern volatile uint8_t _running;
 void deinit_trigger(void);
 void init_trigger_pulse(OW_TimerData _timerDataConfig);
 uint8_t get_trigger_status(void);
+bool trigger_in_train_gap(void);
 uint8_t start_trigger_pulse(void);
 uint8_t stop_trigger_pulse(void);
 bool get_trigger_data(char *jsonString, size_t max_length);
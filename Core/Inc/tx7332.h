@@ -8,9 +8,12 @@
 extern "C" {
 #endif
 
+struct tx_cal_chip;
+
 typedef struct TX7332 {
     GPIO_TypeDef* cs_port;
     uint16_t cs_pin;
+    const struct tx_cal_chip* cal;   // channel calibration applied on write, NULL for none
 } TX7332;
 
 
@@ -21,6 +24,7 @@ void TX7332_WriteReg(TX7332* device, uint16_t addr, uint32_t val);
 bool TX7332_WriteVerify(TX7332* device, uint16_t addr, uint32_t val);
 uint32_t TX7332_ReadReg(TX7332* device, uint16_t addr);
 
+// delay profile words in pInts are calibrated in place
 bool TX7332_WriteBulk(TX7332* device, uint16_t addr, uint32_t* pInts, int len);
 bool TX7332_WriteBulkVerify(TX7332* device, uint16_t addr, uint32_t* be_bytes, int len);
 
@@ -0,0 +1,66 @@
+/*
+ * tx_cal.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_TX_CAL_H_
+#define INC_TX_CAL_H_
+
+#include "main.h"
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Delay profile memory: 16 profiles of 16 words, each word holds two
+ * channel delays, the even channel in bits 15:0 and the odd one in 31:16. */
+#define TX_DELAY_PROFILE_BASE		0x20
+#define TX_DELAY_PROFILE_WORDS		16
+#define TX_DELAY_PROFILES			16
+#define TX_DELAY_BITS				13
+#define TX_CAL_CHANNELS				(TX_DELAY_PROFILE_WORDS * 2)
+#define TX_CAL_VERSION				1		// kv_store record version of tx_cal_table_t
+
+// OW_CTRL_TX_CAL sub commands, carried in cmd->reserved
+typedef enum {
+	TX_CAL_OP_GET = 0,		// -> tx_cal_status_t
+	TX_CAL_OP_SET = 1,		// tx_cal_table_t, stored and applied from the next profile write
+	TX_CAL_OP_CLEAR = 2,
+} TxCalOp;
+
+// stored per module, little endian
+typedef struct __attribute__((packed)) {
+	int16_t delay_offset[TX_PER_MODULE][TX_CAL_CHANNELS];	// delay LSBs added to every profile
+	uint32_t enable_mask[TX_PER_MODULE];					// 0 bits keep a channel powered down
+} tx_cal_table_t;
+
+typedef struct __attribute__((packed)) {
+	tx_cal_table_t table;
+	uint8_t active;
+	uint8_t reserved[3];
+	uint32_t words_adjusted;	// delay words corrected since boot
+	uint32_t last_cycles;		// cost of the last correction pass
+	uint32_t last_words;
+} tx_cal_status_t;
+
+// per chip state the TX7332 driver applies on every write
+typedef struct tx_cal_chip {
+	uint32_t delay_offset[TX_DELAY_PROFILE_WORDS];	// two int16 offsets per word, register layout
+	uint32_t pdn_force;								// channels kept powered down
+	int32_t delay_scale;							// Q16 relative delay change, temperature compensation
+	bool active;
+} tx_cal_chip_t;
+
+void tx_cal_init(void);
+void tx_cal_apply(const tx_cal_chip_t *cal, uint16_t addr, uint32_t *words, int len);
+uint32_t tx_cal_apply_reg(const tx_cal_chip_t *cal, uint16_t addr, uint32_t val);
+void tx_cal_process(UartPacket *cmd, UartPacket *resp);
+
+// temperature terms on top of the table, used from the next write
+void tx_cal_set_temp(int chip, const int16_t offset[TX_CAL_CHANNELS], int32_t scale_q16);
+
+// host delay words as written, before any correction, to rewrite them with new terms
+uint16_t tx_cal_profiles_written(int chip);
+const uint32_t *tx_cal_raw_profile(int chip, int profile);
+
+#endif /* INC_TX_CAL_H_ */
@@ -0,0 +1,54 @@
+/*
+ * tx_pattern.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_TX_PATTERN_H_
+#define INC_TX_PATTERN_H_
+
+#include "tx7332.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Pattern profile memory: 16 profiles of 8 words, each word holds four
+ * segments of [length - 2 : 5][level : 3], first segment in the low byte.
+ * The clock is the one implied by reg_1mhz_3p_values, where a 1 MHz half
+ * cycle takes three full length (32 clock) segments. */
+#define TX_PATTERN_CLK_HZ			192000000U
+#define TX_PATTERN_PROFILE_BASE		0x120
+#define TX_PATTERN_PROFILE_WORDS	8
+#define TX_PATTERN_PROFILES			16
+#define TX_PATTERN_MAX_SEGMENTS		(TX_PATTERN_PROFILE_WORDS * 4)
+#define TX_PATTERN_SEG_MIN_CLKS		2
+#define TX_PATTERN_SEG_MAX_CLKS		32
+#define TX_CHANNEL_PDN_REG			0x1A
+
+#define TX_PATTERN_LEVEL_GND		0
+#define TX_PATTERN_LEVEL_LOW		1
+#define TX_PATTERN_LEVEL_HIGH		2
+#define TX_PATTERN_LEVEL_END		7
+
+#define TX_PATTERN_FLAG_INVERT		0x01	// start on the low level
+#define TX_PATTERN_FLAG_APOD		0x02	// channel_mask is present
+
+#define TX7332_ALL_CHIPS			0xFF	// cmd->addr for every chip on every module
+
+// OW_TX7332_PATTERN payload, little endian
+typedef struct __attribute__((packed)) {
+	uint32_t frequency_hz;
+	uint8_t cycles;
+	uint8_t profile;
+	uint8_t flags;
+	uint8_t duty;				// drive time per half cycle in 1/255ths, 0 = whole half cycle
+	uint16_t phase_deg;			// grounded lead-in, fraction of one period
+	uint32_t channel_mask;		// apodization, bit set = channel fires
+} tx_pattern_desc_t;
+
+#define TX_PATTERN_DESC_LEN			(sizeof(tx_pattern_desc_t) - sizeof(uint32_t))
+#define TX_PATTERN_DESC_APOD_LEN	sizeof(tx_pattern_desc_t)
+
+int tx_pattern_synthesize(const tx_pattern_desc_t *desc, uint32_t words[TX_PATTERN_PROFILE_WORDS]);
+bool tx_pattern_apply(TX7332 *tx, const tx_pattern_desc_t *desc);
+
+#endif /* INC_TX_PATTERN_H_ */
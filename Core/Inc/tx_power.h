@@ -0,0 +1,50 @@
+/*
+ * tx_power.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_TX_POWER_H_
+#define INC_TX_POWER_H_
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TX_POWER_DEFAULT_IDLE_MS	5000	// 0 disables automatic standby
+#define TX_POWER_DEFAULT_LEAD_US	1000
+#define TX_POWER_MAX_LEAD_US		1000000
+
+// OW_CTRL_TX_POWER sub commands, carried in cmd->reserved
+typedef enum {
+	TX_POWER_OP_GET = 0,
+	TX_POWER_OP_SET = 1,		// data: idle_timeout_ms (u32 LE), lead_time_us (u32 LE)
+	TX_POWER_OP_WAKE = 2,		// wake and hold active until released
+	TX_POWER_OP_RELEASE = 3,	// drop the hold, standby on the next idle check
+} TxPowerOp;
+
+typedef enum {
+	TX_POWER_ACTIVE = 0,
+	TX_POWER_STANDBY = 1,
+} TxPowerState;
+
+typedef struct __attribute__((packed)) {
+	uint32_t idle_timeout_ms;
+	uint32_t lead_time_us;
+	uint8_t state;
+	uint8_t held;
+	uint16_t notify_failed;		// slave wake/release without a good reply
+	uint32_t wake_count;
+	uint32_t last_wake_latency_us;	// wake request to trigger start
+	uint32_t max_wake_latency_us;
+} tx_power_status_t;
+
+void tx_power_init(void);
+void tx_power_process(void);
+void tx_power_wake(bool hold);
+void tx_power_release(void);
+bool tx_power_prepare_start(void);
+void tx_power_set_config(uint32_t idle_timeout_ms, uint32_t lead_time_us);
+const tx_power_status_t* tx_power_get_status(void);
+
+#endif /* INC_TX_POWER_H_ */
@@ -0,0 +1,68 @@
+/*
+ * tx_tcomp.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef INC_TX_TCOMP_H_
+#define INC_TX_TCOMP_H_
+
+#include "main.h"
+#include "common.h"
+#include "fx_math.h"
+#include "tx_cal.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TX_TCOMP_VERSION			1		// kv_store record version of tx_tcomp_model_t
+#define TX_TCOMP_MIN_PERIOD_MS		100
+#define TX_TCOMP_MAX_SCALE_PPM		100000	// 10 % per degree, anything above is a unit mistake
+
+typedef enum {
+	TX_TCOMP_SRC_TX = 0,		// thermistor on the transmitter board, tx_temperature
+	TX_TCOMP_SRC_AMBIENT = 1,	// MAX31875, ambient_temperature
+} TxTcompSource;
+
+// OW_CTRL_TX_TCOMP sub commands, carried in cmd->reserved
+typedef enum {
+	TX_TCOMP_OP_GET = 0,		// -> tx_tcomp_status_t
+	TX_TCOMP_OP_SET = 1,		// tx_tcomp_model_t, stored and tracked from the current corrections
+	TX_TCOMP_OP_CLEAR = 2,		// corrections walk back to zero at the same rate
+} TxTcompOp;
+
+/* Stored per module, little endian.  The correction of a channel at
+ * temperature T is coeff * (T - ref) + delay * scale_ppm * (T - ref) / 1e6
+ * delay LSBs, the second term follows the speed of sound in the medium. */
+typedef struct __attribute__((packed)) {
+	int16_t ref_temp_c8;		// temperature the host profiles are made for, degC x 256
+	uint8_t source;				// TxTcompSource
+	uint8_t max_step;			// delay LSBs a channel may move per update, > 0
+	uint16_t period_ms;			// time between updates, >= TX_TCOMP_MIN_PERIOD_MS
+	uint16_t deadband_c8;		// temperature change that recomputes the target, degC x 256
+	int32_t scale_ppm;			// relative delay change per degC, ppm
+	int16_t coeff[TX_PER_MODULE][TX_CAL_CHANNELS];	// delay LSBs per degC x 256
+} tx_tcomp_model_t;
+
+typedef struct __attribute__((packed)) {
+	uint8_t enabled;
+	uint8_t source;
+	uint8_t converged;			// corrections reached the target and are in the chips
+	uint8_t reserved;
+	q16_t temp;					// last good sample, degC
+	q16_t delta;				// temp - ref the target is computed for
+	q16_t scale;				// relative delay scale applied
+	int16_t max_offset;			// largest applied channel offset, LSB
+	int16_t max_error;			// largest distance left to the target, LSB
+	uint32_t updates;			// rate limited steps taken
+	uint32_t profiles_rewritten;
+	uint32_t sensor_faults;		// samples out of range, corrections held
+	uint32_t last_update_tick;
+	int16_t offset[TX_PER_MODULE][TX_CAL_CHANNELS];	// applied per channel offset, LSB
+} tx_tcomp_status_t;
+
+void tx_tcomp_init(void);
+void tx_tcomp_run(void);
+const tx_tcomp_status_t* tx_tcomp_get_status(void);
+void tx_tcomp_process(UartPacket *cmd, UartPacket *resp);
+
+#endif /* INC_TX_TCOMP_H_ */
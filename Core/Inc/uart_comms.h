@@ -13,8 +13,40 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+// Commands the host may have in flight, bounds how many responses one batch sends back-to-back
+#define HOST_RX_MAX_FRAMES 16
+
+// Receive credit advertised to the host: frames and bytes it can still send
+// without the device holding off the OUT endpoint
+typedef struct __attribute__((packed)) {
+	uint16_t frames;
+	uint16_t bytes;
+	uint16_t max_frames;
+	uint16_t max_bytes;
+} host_credit_t;
+
+// Longest a response may wait for others to share its USB transfer
+#define HOST_COALESCE_MAX_WINDOW_US 10000
+
+// Response coalescing: frames queue in the transmit buffer and go out in
+// one CDC transfer once max_bytes are waiting, the oldest has waited
+// window_us, or (window_us 0) the host batch they answer is done
+typedef struct __attribute__((packed)) {
+	uint16_t max_bytes;		// 0 sends every frame on its own
+	uint16_t window_us;
+	uint32_t transfers;
+	uint32_t frames;
+} host_coalesce_t;
+
+extern volatile bool credit_reports_enabled;	// OW_CMD_CREDIT frame after every host batch
+
 void comms_host_start(void);
+void comms_host_get_credit(host_credit_t *credit);
+bool comms_host_set_coalesce(uint16_t max_bytes, uint16_t window_us);
+const host_coalesce_t *comms_host_get_coalesce(void);
 void comms_host_check_received(void);
+void comms_host_tx_poll(void);
+uint32_t comms_host_idle_ms(void);
 bool comms_onewire_slave_start(void);
 void comms_onewire_check_received(void);
 bool comms_onewire_master_sendreceive(UartPacket* pSendPacket, UartPacket* pRetPacket);
@@ -25,6 +57,7 @@ void comms_handle_ow_CallOut_TxCpltCallback(UART_HandleTypeDef *huart);
 void comms_handle_ow_CallIn_RxEventCallback(UART_HandleTypeDef *huart, uint16_t size);
 void comms_handle_ow_CallIn_TxCpltCallback(UART_HandleTypeDef *huart);
 
+uint8_t comms_onewire_discover(uint8_t position, uint8_t i2c_address);
 bool enumerate_slaves(void);
 
 void CDC_handle_TxCpltCallback();
@@ -0,0 +1,111 @@
+/*
+ * cmd_deadline.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Commands that are only worth running while they are fresh.  The host
+ *  wraps a command in OW_CTRL_DEADLINE with a deadline on the device clock
+ *  and a class; the host path unwraps it before execution and answers
+ *  OW_EXPIRED instead once the deadline is past.  A FLUSH acts when its
+ *  frame arrives, not when its turn comes: wrapped commands of the flushed
+ *  classes that are still queued ahead of it in the same batch are
+ *  dropped the same way.  Unwrapped commands are never touched.
+ */
+
+#include "cmd_deadline.h"
+
+#include <string.h>
+
+static cmd_deadline_status_t deadline_status;
+static uint16_t flush_before[CMD_DEADLINE_CLASSES];	// batch offset of the last FLUSH per class
+
+static bool is_deadline_op(const UartPacket *cmd, uint8_t op)
+{
+	return (cmd->packet_type == OW_CONTROLLER || cmd->packet_type == OW_CMD) &&
+		   cmd->command == OW_CTRL_DEADLINE && cmd->reserved == op;
+}
+
+void cmd_deadline_batch_start(void)
+{
+	memset(flush_before, 0, sizeof(flush_before));
+}
+
+// every complete frame of a batch, before any of them runs
+void cmd_deadline_scan(const UartPacket *cmd, uint16_t offset)
+{
+	if (!is_deadline_op(cmd, CMD_DEADLINE_OP_FLUSH) || cmd->data_len != 1) {
+		return;
+	}
+	for (int cls = 0; cls < CMD_DEADLINE_CLASSES; cls++) {
+		if (cmd->data[0] & (1U << cls)) {
+			flush_before[cls] = offset;
+		}
+	}
+}
+
+/* Turns a wrapper into the command it carries.  OW_SUCCESS to run it,
+ * OW_EXPIRED when it is stale, OW_INVALID_PACKET for a broken wrapper. */
+uint8_t cmd_deadline_unwrap(UartPacket *cmd, uint16_t offset)
+{
+	cmd_deadline_hdr_t hdr;
+	uint32_t now = HAL_GetTick();
+
+	if (!is_deadline_op(cmd, CMD_DEADLINE_OP_WRAP)) {
+		return OW_SUCCESS;
+	}
+	if (cmd->data_len < sizeof(hdr)) {
+		return OW_INVALID_PACKET;
+	}
+	memcpy(&hdr, cmd->data, sizeof(hdr));
+	if (hdr.cls >= CMD_DEADLINE_CLASSES ||
+		((hdr.packet_type == OW_CONTROLLER || hdr.packet_type == OW_CMD) && hdr.command == OW_CTRL_DEADLINE)) {
+		return OW_INVALID_PACKET;
+	}
+
+	cmd->packet_type = hdr.packet_type;
+	cmd->command = hdr.command;
+	cmd->addr = hdr.addr;
+	cmd->reserved = hdr.reserved;
+	cmd->data += sizeof(hdr);
+	cmd->data_len -= sizeof(hdr);
+
+	if (offset < flush_before[hdr.cls]) {
+		deadline_status.flushed++;
+		return OW_EXPIRED;
+	}
+	if (hdr.deadline_ms != CMD_DEADLINE_NONE && (int32_t)(now - hdr.deadline_ms) > 0) {
+		deadline_status.expired++;
+		if ((now - hdr.deadline_ms) > deadline_status.max_late_ms) {
+			deadline_status.max_late_ms = now - hdr.deadline_ms;
+		}
+		return OW_EXPIRED;
+	}
+	deadline_status.executed++;
+	return OW_SUCCESS;
+}
+
+void cmd_deadline_process(UartPacket *cmd, UartPacket *resp)
+{
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+
+	switch (cmd->reserved)
+	{
+	case CMD_DEADLINE_OP_STATUS:
+		break;
+	case CMD_DEADLINE_OP_FLUSH:
+		// already applied when the batch was scanned
+		if (cmd->data_len != 1) {
+			resp->packet_type = OW_ERROR;
+		}
+		break;
+	default:
+		// a wrapper only means something on the host path
+		resp->packet_type = OW_ERROR;
+		break;
+	}
+	deadline_status.now_ms = HAL_GetTick();
+	resp->data_len = sizeof(deadline_status);
+	resp->data = (uint8_t *)&deadline_status;
+}
@@ -0,0 +1,355 @@
+/*
+ * cmd_macro.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Command macros.  A fixed setup sequence is stored once in the kv_store
+ *  as the host frames it is made of, minus framing, and replayed on the
+ *  module through process_if_command, so relays to slaves go out exactly
+ *  as they would from the host.  A macro is either captured live (RECORD,
+ *  then the host sends the sequence as usual, then END) or written whole
+ *  when it is longer than the capture buffer.  It runs on a RUN command
+ *  or on the events it was stored with.
+ *
+ *  Steps are executed straight from flash, so nothing a macro runs may
+ *  write the store: kv, calibration, macro, update and reset commands are
+ *  refused when the macro is checked before its first step.
+ */
+
+#include "cmd_macro.h"
+#include "if_commands.h"
+#include "i2c_protocol.h"
+#include "kv_store.h"
+
+#include <string.h>
+
+static uint8_t rec_buf[CMD_MACRO_REC_MAX];
+static bool rec_overflow = false;
+static cmd_macro_status_t macro_status;
+static volatile uint8_t pending_events = 0;
+static bool macro_running = false;
+
+static uint16_t macro_key(uint8_t slot)
+{
+	return KV_KEY_MACRO_BASE + slot;
+}
+
+static bool step_allowed(const cmd_macro_step_t *step)
+{
+	if (step->packet_type != OW_CMD && step->packet_type != OW_CONTROLLER) {
+		return step->packet_type == OW_TX7332 || step->packet_type == OW_I2C_PASSTHRU;
+	}
+	switch (step->command)
+	{
+	case OW_CMD_FW_UPDATE:
+	case OW_CMD_DFU:
+	case OW_CMD_RESET:
+	case OW_CTRL_KV:
+	case OW_CTRL_TX_CAL:
+	case OW_CTRL_TX_TCOMP:
+	case OW_CTRL_MACRO:
+	case OW_CTRL_PROFILE_CACHE:
+		return false;
+	default:
+		return true;
+	}
+}
+
+// walk the whole record before running any of it
+static bool macro_check(const uint8_t *rec, uint16_t len)
+{
+	const cmd_macro_hdr_t *hdr = (const cmd_macro_hdr_t *)rec;
+	uint16_t off = sizeof(cmd_macro_hdr_t);
+
+	if (len < sizeof(cmd_macro_hdr_t)) {
+		return false;
+	}
+	for (uint16_t i = 0; i < hdr->steps; i++) {
+		const cmd_macro_step_t *step = (const cmd_macro_step_t *)&rec[off];
+		if ((uint32_t)off + sizeof(cmd_macro_step_t) > len ||
+			(uint32_t)off + sizeof(cmd_macro_step_t) + step->data_len > len ||
+			step->data_len > DATA_MAX_SIZE || !step_allowed(step)) {
+			return false;
+		}
+		off += sizeof(cmd_macro_step_t) + step->data_len;
+	}
+	return off == len;
+}
+
+static bool macro_run(uint8_t slot, uint8_t events)
+{
+	static UartPacket step_resp;
+	const uint8_t *rec;
+	const cmd_macro_hdr_t *hdr;
+	uint16_t len = 0;
+	uint8_t version = 0;
+	uint16_t off = sizeof(cmd_macro_hdr_t);
+	uint32_t t0 = DWT->CYCCNT;
+
+	if (macro_running || slot >= CMD_MACRO_SLOTS) {
+		return false;
+	}
+	rec = kv_store_ptr(macro_key(slot), &len, &version);
+	if (rec == NULL || version != CMD_MACRO_VERSION || !macro_check(rec, len)) {
+		return false;
+	}
+	hdr = (const cmd_macro_hdr_t *)rec;
+
+	// relays queued ahead for host frames must not be taken for macro steps
+	if_relay_abandon();
+	macro_running = true;
+	macro_status.last_slot = slot;
+	macro_status.last_events = events;
+	macro_status.last_steps = 0;
+	macro_status.failed_step = CMD_MACRO_NO_STEP;
+	macro_status.failed_type = 0;
+	macro_status.failed_reserved = 0;
+
+	for (uint16_t i = 0; i < hdr->steps; i++) {
+		const cmd_macro_step_t *step = (const cmd_macro_step_t *)&rec[off];
+		UartPacket cmd;
+
+		cmd.id = i;
+		cmd.packet_type = step->packet_type;
+		cmd.command = step->command;
+		cmd.addr = step->addr;
+		cmd.reserved = step->reserved;
+		cmd.data_len = step->data_len;
+		cmd.data = (uint8_t *)&rec[off + sizeof(cmd_macro_step_t)];
+		cmd.crc = 0;
+		off += sizeof(cmd_macro_step_t) + step->data_len;
+
+		process_if_command(&cmd, &step_resp);
+		macro_status.last_steps++;
+		if (step_resp.packet_type == OW_ERROR || step_resp.packet_type == I2C_SLAVE_BUSY) {
+			macro_status.failed_step = i;
+			macro_status.failed_type = step_resp.packet_type;
+			macro_status.failed_reserved = step_resp.reserved;
+			break;
+		}
+	}
+
+	macro_status.last_us = (DWT->CYCCNT - t0) / (SystemCoreClock / 1000000U);
+	macro_status.runs++;
+	macro_running = false;
+	return macro_status.failed_step == CMD_MACRO_NO_STEP;
+}
+
+void cmd_macro_init(void)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	memset(&macro_status, 0, sizeof(macro_status));
+	macro_status.failed_step = CMD_MACRO_NO_STEP;
+	pending_events = CMD_MACRO_EVT_BOOT;
+
+	// GPIO_1 is a spare input, pulled down so an open pin never starts anything
+	GPIO_InitStruct.Pin = GPIO_1_Pin;
+	GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+	GPIO_InitStruct.Pull = GPIO_PULLDOWN;
+	HAL_GPIO_Init(GPIO_1_GPIO_Port, &GPIO_InitStruct);
+	HAL_NVIC_SetPriority(EXTI15_10_IRQn, 3, 0);
+	HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+}
+
+// interrupt context, the macros themselves run from cmd_macro_run_pending
+void cmd_macro_event(uint8_t events)
+{
+	__disable_irq();
+	pending_events |= events;
+	__enable_irq();
+}
+
+void cmd_macro_run_pending(void)
+{
+	uint8_t events;
+
+	if (pending_events == 0 || macro_running) {
+		return;
+	}
+	__disable_irq();
+	events = pending_events;
+	pending_events = 0;
+	__enable_irq();
+
+	for (uint8_t slot = 0; slot < CMD_MACRO_SLOTS; slot++) {
+		uint16_t len = 0;
+		uint8_t version = 0;
+		const cmd_macro_hdr_t *hdr = kv_store_ptr(macro_key(slot), &len, &version);
+		if (hdr != NULL && version == CMD_MACRO_VERSION && len >= sizeof(cmd_macro_hdr_t) &&
+			(hdr->events & events) != 0) {
+			macro_run(slot, hdr->events & events);
+		}
+	}
+}
+
+// host commands that went through while recording, after they were executed
+void cmd_macro_record(const UartPacket *cmd, const UartPacket *resp)
+{
+	cmd_macro_hdr_t *hdr = (cmd_macro_hdr_t *)rec_buf;
+	cmd_macro_step_t step;
+
+	if (!macro_status.recording || resp->packet_type == OW_ERROR ||
+		((cmd->packet_type == OW_CMD || cmd->packet_type == OW_CONTROLLER) && cmd->command == OW_CTRL_MACRO)) {
+		return;
+	}
+	step.packet_type = cmd->packet_type;
+	step.command = cmd->command;
+	step.addr = cmd->addr;
+	step.reserved = cmd->reserved;
+	step.data_len = cmd->data_len;
+	if (!step_allowed(&step) || (macro_status.rec_len + sizeof(step) + cmd->data_len) > CMD_MACRO_REC_MAX) {
+		rec_overflow = true;	// END refuses a capture with a hole in it
+		return;
+	}
+	memcpy(&rec_buf[macro_status.rec_len], &step, sizeof(step));
+	memcpy(&rec_buf[macro_status.rec_len + sizeof(step)], cmd->data, cmd->data_len);
+	macro_status.rec_len += sizeof(step) + cmd->data_len;
+	macro_status.rec_steps++;
+	hdr->steps = macro_status.rec_steps;
+}
+
+static bool macro_record_start(UartPacket *cmd)
+{
+	cmd_macro_hdr_t *hdr = (cmd_macro_hdr_t *)rec_buf;
+
+	macro_status.recording = 0;
+	macro_status.rec_steps = 0;
+	macro_status.rec_len = 0;
+	if (cmd->data_len == 0) {
+		return true;
+	}
+	if (cmd->data_len < 2 || cmd->data_len > 2 + CMD_MACRO_NAME_LEN || cmd->data[0] >= CMD_MACRO_SLOTS) {
+		return false;
+	}
+	memset(hdr, 0, sizeof(cmd_macro_hdr_t));
+	hdr->events = cmd->data[1];
+	memcpy(hdr->name, &cmd->data[2], cmd->data_len - 2);
+	rec_overflow = false;
+	macro_status.rec_slot = cmd->data[0];
+	macro_status.rec_len = sizeof(cmd_macro_hdr_t);
+	macro_status.recording = 1;
+	return true;
+}
+
+static bool macro_record_end(void)
+{
+	bool ok = macro_status.recording && !rec_overflow && macro_status.rec_steps > 0;
+
+	if (ok) {
+		ok = kv_store_set(macro_key(macro_status.rec_slot), CMD_MACRO_VERSION, rec_buf, macro_status.rec_len) == HAL_OK;
+	}
+	macro_status.recording = 0;
+	return ok;
+}
+
+static bool macro_write(UartPacket *cmd)
+{
+	static uint16_t written = 0;
+	uint16_t total;
+	uint16_t offset;
+	uint16_t chunk;
+	const uint8_t *rec;
+	uint16_t len = 0;
+	uint8_t version = 0;
+
+	if (cmd->data_len < 6 || cmd->data[0] >= CMD_MACRO_SLOTS) {
+		return false;
+	}
+	total = cmd->data[2] | (cmd->data[3] << 8);
+	offset = cmd->data[4] | (cmd->data[5] << 8);
+	chunk = cmd->data_len - 6;
+	if (offset == 0) {
+		written = 0;
+		if (total < sizeof(cmd_macro_hdr_t) ||
+			kv_store_begin(macro_key(cmd->data[0]), CMD_MACRO_VERSION, total) != HAL_OK) {
+			return false;
+		}
+	} else if (offset != written) {
+		return false;
+	}
+	if (kv_store_append(&cmd->data[6], chunk) != HAL_OK) {
+		return false;
+	}
+	written += chunk;
+	if (written < total) {
+		return true;
+	}
+	if (kv_store_commit() != HAL_OK) {
+		return false;
+	}
+
+	// a record that would be refused at run time is not kept
+	rec = kv_store_ptr(macro_key(cmd->data[0]), &len, &version);
+	if (rec == NULL || !macro_check(rec, len)) {
+		kv_store_delete(macro_key(cmd->data[0]));
+		return false;
+	}
+	return true;
+}
+
+static uint16_t macro_list(cmd_macro_info_t *out)
+{
+	uint16_t count = 0;
+
+	for (uint8_t slot = 0; slot < CMD_MACRO_SLOTS; slot++) {
+		uint16_t len = 0;
+		uint8_t version = 0;
+		const cmd_macro_hdr_t *hdr = kv_store_ptr(macro_key(slot), &len, &version);
+		if (hdr == NULL || version != CMD_MACRO_VERSION || len < sizeof(cmd_macro_hdr_t)) {
+			continue;
+		}
+		out[count].slot = slot;
+		out[count].events = hdr->events;
+		out[count].steps = hdr->steps;
+		out[count].len = len;
+		memcpy(out[count].name, hdr->name, CMD_MACRO_NAME_LEN);
+		count++;
+	}
+	return count;
+}
+
+void cmd_macro_process(UartPacket *cmd, UartPacket *resp)
+{
+	static cmd_macro_info_t list[CMD_MACRO_SLOTS];
+	bool ok = true;
+
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+	resp->data_len = sizeof(macro_status);
+	resp->data = (uint8_t *)&macro_status;
+
+	switch (cmd->reserved)
+	{
+	case CMD_MACRO_OP_STATUS:
+		break;
+	case CMD_MACRO_OP_LIST:
+		resp->data_len = macro_list(list) * sizeof(cmd_macro_info_t);
+		resp->data = (uint8_t *)list;
+		break;
+	case CMD_MACRO_OP_RECORD:
+		ok = macro_record_start(cmd);
+		break;
+	case CMD_MACRO_OP_END:
+		ok = macro_record_end();
+		break;
+	case CMD_MACRO_OP_WRITE:
+		ok = macro_write(cmd);
+		break;
+	case CMD_MACRO_OP_RUN:
+		ok = cmd->data_len == 1 && macro_run(cmd->data[0], 0);
+		break;
+	case CMD_MACRO_OP_DELETE:
+		ok = cmd->data_len == 1 && cmd->data[0] < CMD_MACRO_SLOTS &&
+			kv_store_delete(macro_key(cmd->data[0])) == HAL_OK;
+		break;
+	default:
+		ok = false;
+		break;
+	}
+
+	if (!ok) {
+		resp->packet_type = OW_ERROR;
+	}
+}
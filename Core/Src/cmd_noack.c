@@ -0,0 +1,129 @@
+/*
+ * cmd_noack.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Fire and forget commands.  A host frame flagged with CMD_NOACK_FLAG is
+ *  run like any other but its response is dropped, so a bulk register
+ *  load is one way over USB.  Chip writes relayed to a slave are sent the
+ *  same way over I2C and only checked when something else is about to go
+ *  to that slave, or at the end of the batch.  Failures are latched here
+ *  with their packet ids until the host clears them, and optionally sent
+ *  as error frames once the batch they were in is done.
+ */
+
+#include "cmd_noack.h"
+
+#include <string.h>
+
+static cmd_noack_status_t noack_status;
+static cmd_noack_entry_t noack_log[CMD_NOACK_LOG_LEN];
+static uint8_t noack_reported = 0;	// entries already sent as error frames
+static bool noack_running = false;
+static cmd_noack_entry_t noack_report;
+static uint8_t noack_buf[sizeof(cmd_noack_status_t) + sizeof(noack_log)];
+
+// true if cmd came flagged, with the flag taken off
+bool cmd_noack_strip(UartPacket *cmd)
+{
+	if ((cmd->packet_type & 0xF0) != (0xE0 | CMD_NOACK_FLAG)) {
+		return false;
+	}
+	cmd->packet_type &= ~CMD_NOACK_FLAG;
+	cmd_noack_begin();
+	return true;
+}
+
+// for a command that came without the flag, a slave's relayed write
+void cmd_noack_begin(void)
+{
+	noack_running = true;
+}
+
+// the command being run now answers nobody
+bool cmd_noack_active(void)
+{
+	return noack_running;
+}
+
+void cmd_noack_done(const UartPacket *cmd, const UartPacket *resp)
+{
+	noack_running = false;
+	noack_status.executed++;
+	if (resp->packet_type == OW_ERROR) {
+		cmd_noack_fail(cmd, 0, OW_ERROR, resp->reserved);
+	}
+}
+
+void cmd_noack_fail(const UartPacket *cmd, uint8_t module, uint8_t result, uint8_t code)
+{
+	cmd_noack_entry_t *e;
+
+	noack_status.failed++;
+	if (noack_status.count >= CMD_NOACK_LOG_LEN) {
+		noack_status.lost++;	// the first failures explain the rest
+		return;
+	}
+	e = &noack_log[noack_status.count++];
+	e->id = cmd->id;
+	e->packet_type = cmd->packet_type;
+	e->command = cmd->command;
+	e->addr = cmd->addr;
+	e->module = module;
+	e->result = result;
+	e->code = code;
+}
+
+// next failure to send as an error frame, when the host asked for them
+bool cmd_noack_next_report(UartPacket *frame)
+{
+	if (!noack_status.reports || noack_reported >= noack_status.count) {
+		return false;
+	}
+	noack_report = noack_log[noack_reported++];
+	memset(frame, 0, sizeof(*frame));
+	frame->id = noack_report.id;
+	frame->packet_type = OW_ERROR;
+	frame->command = noack_report.command;
+	frame->addr = noack_report.addr;
+	frame->reserved = noack_report.code;
+	frame->data_len = sizeof(noack_report);
+	frame->data = (uint8_t *)&noack_report;
+	return true;
+}
+
+void cmd_noack_process(UartPacket *cmd, UartPacket *resp)
+{
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+
+	// the reply shows the log as it was, a CLEAR doesn't lose what it cleared
+	memcpy(noack_buf, &noack_status, sizeof(noack_status));
+	memcpy(&noack_buf[sizeof(noack_status)], noack_log, noack_status.count * sizeof(cmd_noack_entry_t));
+	resp->data_len = sizeof(noack_status) + (noack_status.count * sizeof(cmd_noack_entry_t));
+	resp->data = noack_buf;
+
+	switch (cmd->reserved)
+	{
+	case CMD_NOACK_OP_STATUS:
+		break;
+	case CMD_NOACK_OP_CLEAR:
+		noack_status.count = 0;
+		noack_status.lost = 0;
+		noack_reported = 0;
+		break;
+	case CMD_NOACK_OP_REPORTS:
+		if (cmd->data_len != 1) {
+			resp->packet_type = OW_ERROR;
+			break;
+		}
+		noack_status.reports = cmd->data[0] ? 1 : 0;
+		// only failures from here on
+		noack_reported = noack_status.count;
+		break;
+	default:
+		resp->packet_type = OW_ERROR;
+		break;
+	}
+}
@@ -454,6 +454,11 @@ unsigned int reg_1mhz_3p_values[][2] = {
 };
 
 
+int get_demo_register_count(void)
+{
+	return sizeof(reg_values) / sizeof(reg_values[0]);
+}
+
 void write_demo_registers(TX7332* pT)
 {
 	int num_registers = sizeof(reg_values) / sizeof(reg_values[0]);
@@ -148,3 +148,23 @@ HAL_StatusTypeDef Flash_Write(uint32_t address, const void *src, uint32_t size_b
   HAL_FLASH_Lock();
   return HAL_OK;
 }
+
+/* --- Public: replace the pages covering [address, address+size) with src --- */
+HAL_StatusTypeDef Flash_Commit(uint32_t address, const void *src, uint32_t size_bytes)
+{
+  HAL_StatusTypeDef st = Flash_Erase(address, address + size_bytes);
+  if (st != HAL_OK) return st;
+
+  return Flash_Write(address, src, size_bytes);
+}
+
+/* --- Public: 1 if every byte in range still reads erased (0xFF) --- */
+int Flash_IsErased(uint32_t address, uint32_t size_bytes)
+{
+  const uint32_t *w = (const uint32_t*)address;
+
+  for (uint32_t i = 0; i < size_bytes / 4U; i++) {
+    if (w[i] != 0xFFFFFFFFU) return 0;
+  }
+  return 1;
+}
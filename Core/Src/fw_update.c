@@ -0,0 +1,386 @@
+/*
+ * fw_update.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Block level delta / compressed firmware update into the staging area.
+ *  The host compares its new image against the manifest of the running
+ *  image (identified by FW_SHA) and only sends the blocks that changed,
+ *  RLE compressed where that helps.  Unchanged blocks are copied on device
+ *  from the running image.  Every decoded block is CRC checked before it is
+ *  programmed and the whole image is checked again on commit, after which
+ *  the bootloader is asked to install it on the next reset.
+ *
+ *  A/B builds (FW_AB_SLOTS) never copy: the staging area is the second
+ *  application slot and an update is written to whichever slot is not
+ *  running, while this image keeps serving.  Commit gives the new image a
+ *  descriptor with a sequence number above the running one and ACTIVATE
+ *  resets into it as a trial boot; the bootloader falls back to the other
+ *  slot if the new image never confirms with bootloader_mark_boot_ok.
+ */
+
+#include "fw_update.h"
+#include "flash_eeprom.h"
+#include "utils.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define STAGING_PAGES	(APPLICATION_SLOT_SIZE / FLASH_PAGE_SIZE)
+
+extern uint32_t g_pfnVectors[];
+extern uint32_t _sidata, _sdata, _edata;
+
+static FwUpdateState upd_state = FW_UPD_IDLE;
+static uint32_t upd_base = FW_STAGING_ADDRESS;
+static uint32_t upd_prev_seq = 0;		// seq the target slot had before it was erased
+static uint32_t upd_size = 0;
+static uint32_t upd_crc = 0;
+static bool upd_delta = false;
+static char upd_sha[FW_UPD_SHA_LEN];
+static uint8_t blocks_done[(FW_UPD_MAX_BLOCKS + 7) / 8];
+static uint8_t pages_erased[(STAGING_PAGES + 7) / 8];
+static uint16_t blocks_received = 0;
+
+static uint8_t block_buf[FW_UPD_BLOCK_SIZE] __attribute__((aligned(8)));
+static uint8_t resp_buf[sizeof(uint32_t) * 255];
+
+static inline bool bit_get(const uint8_t *map, uint32_t i) { return (map[i >> 3] >> (i & 7)) & 1U; }
+static inline void bit_set(uint8_t *map, uint32_t i) { map[i >> 3] |= (uint8_t)(1U << (i & 7)); }
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t running_base(void)
+{
+	return (uint32_t)g_pfnVectors;
+}
+
+static uint32_t running_size(void)
+{
+	return ((uint32_t)&_sidata - running_base()) + ((uint32_t)&_edata - (uint32_t)&_sdata);
+}
+
+// the slot that is not running, the staging area for single slot builds
+static uint32_t target_base(void)
+{
+	return running_base() == FW_SLOT_B_ADDRESS ? FW_SLOT_A_ADDRESS : FW_STAGING_ADDRESS;
+}
+
+static const fw_image_desc_t *slot_desc(uint32_t base)
+{
+	return (const fw_image_desc_t *)(base + FW_SLOT_DESC_OFFSET);
+}
+
+static bool desc_valid(const fw_image_desc_t *desc)
+{
+	return desc->magic == FW_UPD_DESC_MAGIC && desc->image_size != 0 &&
+		   desc->image_size <= FW_STAGING_MAX_IMAGE &&
+		   util_hw_crc32((const uint8_t *)desc, offsetof(fw_image_desc_t, desc_crc32)) == desc->desc_crc32;
+}
+
+static uint32_t slot_seq(uint32_t base)
+{
+	const fw_image_desc_t *desc = slot_desc(base);
+	return desc_valid(desc) ? desc->seq : 0;
+}
+
+static uint32_t block_len(uint32_t image_size, uint16_t index)
+{
+	uint32_t off = (uint32_t)index * FW_UPD_BLOCK_SIZE;
+	if (off >= image_size) return 0;
+	return (image_size - off) < FW_UPD_BLOCK_SIZE ? (image_size - off) : FW_UPD_BLOCK_SIZE;
+}
+
+static void reset_session(void)
+{
+	upd_state = FW_UPD_IDLE;
+	upd_base = FW_STAGING_ADDRESS;
+	upd_size = 0;
+	upd_crc = 0;
+	upd_delta = false;
+	blocks_received = 0;
+	memset(upd_sha, 0, sizeof(upd_sha));
+	memset(blocks_done, 0, sizeof(blocks_done));
+	memset(pages_erased, 0, sizeof(pages_erased));
+}
+
+static int rle_decode(const uint8_t *src, uint16_t src_len, uint8_t *dst, uint32_t dst_len)
+{
+	uint32_t out = 0;
+	uint16_t in = 0;
+
+	while (in < src_len) {
+		uint8_t ctrl = src[in++];
+		if (ctrl < 0x80) {
+			uint32_t n = ctrl + 1U;
+			if ((in + n) > src_len || (out + n) > dst_len) return -1;
+			memcpy(&dst[out], &src[in], n);
+			in += n;
+			out += n;
+		} else {
+			uint32_t n = (ctrl - 0x80U) + 3U;
+			if (in >= src_len || (out + n) > dst_len) return -1;
+			memset(&dst[out], src[in++], n);
+			out += n;
+		}
+	}
+	return (int)out;
+}
+
+static bool staging_program(uint16_t index, const uint8_t *data, uint32_t len)
+{
+	uint32_t addr = upd_base + ((uint32_t)index * FW_UPD_BLOCK_SIZE);
+	uint32_t page = (addr - upd_base) / FLASH_PAGE_SIZE;
+
+	// pages are erased lazily so the cost is spread over the transfer
+	if (!bit_get(pages_erased, page)) {
+		uint32_t page_addr = upd_base + (page * FLASH_PAGE_SIZE);
+		if (Flash_Erase(page_addr, page_addr + FLASH_PAGE_SIZE) != HAL_OK) return false;
+		bit_set(pages_erased, page);
+	}
+	return Flash_Write(addr, data, len) == HAL_OK;
+}
+
+static bool handle_begin(UartPacket *cmd)
+{
+	const uint32_t need = 8 + (2 * FW_UPD_SHA_LEN);
+	char base_sha[FW_UPD_SHA_LEN];
+
+	if (cmd->data_len != need) return false;
+
+	reset_session();
+	upd_size = get_le32(&cmd->data[0]);
+	upd_crc = get_le32(&cmd->data[4]);
+	memcpy(base_sha, &cmd->data[8], FW_UPD_SHA_LEN);
+	memcpy(upd_sha, &cmd->data[8 + FW_UPD_SHA_LEN], FW_UPD_SHA_LEN);
+	base_sha[FW_UPD_SHA_LEN - 1] = 0;
+	upd_sha[FW_UPD_SHA_LEN - 1] = 0;
+
+	if (upd_size == 0 || upd_size > FW_STAGING_MAX_IMAGE) return false;
+
+	// the target must not overlap what is running (standalone builds)
+	upd_base = target_base();
+	if ((running_base() + running_size()) > upd_base &&
+		running_base() < (upd_base + APPLICATION_SLOT_SIZE)) {
+		printf("fw_update: staging overlaps running image\r\n");
+		return false;
+	}
+
+	// an empty base sha means a full update, otherwise it must be us
+	if (base_sha[0] != 0) {
+		if (strcmp(base_sha, FW_SHA_STRING) != 0) {
+			printf("fw_update: base %s does not match %s\r\n", base_sha, FW_SHA_STRING);
+			return false;
+		}
+		upd_delta = true;
+	}
+
+	// nothing may boot or install the slot while it is half written
+	upd_prev_seq = slot_seq(upd_base);
+	if (Flash_Erase(upd_base + FW_SLOT_DESC_OFFSET, upd_base + APPLICATION_SLOT_SIZE) != HAL_OK) return false;
+
+	upd_state = FW_UPD_RECEIVING;
+	return true;
+}
+
+static bool handle_block(UartPacket *cmd)
+{
+	uint16_t index;
+	uint8_t encoding;
+	uint32_t crc, len;
+	const uint8_t *payload;
+	uint16_t payload_len;
+
+	if (upd_state != FW_UPD_RECEIVING || cmd->data_len < 8) return false;
+
+	index = cmd->data[0] | (cmd->data[1] << 8);
+	encoding = cmd->data[2];
+	crc = get_le32(&cmd->data[4]);
+	payload = &cmd->data[8];
+	payload_len = cmd->data_len - 8;
+	len = block_len(upd_size, index);
+	if (len == 0) return false;
+
+	switch (encoding) {
+	case FW_BLK_COPY:
+	{
+		uint16_t src = index;
+		if (!upd_delta) return false;
+		if (payload_len == 2) {
+			src = payload[0] | (payload[1] << 8);
+		} else if (payload_len != 0) {
+			return false;
+		}
+		if (((uint32_t)src * FW_UPD_BLOCK_SIZE) + len > running_size()) return false;
+		memcpy(block_buf, (const void *)(running_base() + ((uint32_t)src * FW_UPD_BLOCK_SIZE)), len);
+		break;
+	}
+	case FW_BLK_RAW:
+		if (payload_len != len) return false;
+		memcpy(block_buf, payload, len);
+		break;
+	case FW_BLK_RLE:
+		if (rle_decode(payload, payload_len, block_buf, len) != (int)len) return false;
+		break;
+	default:
+		return false;
+	}
+
+	if (util_hw_crc32(block_buf, len) != crc) {
+		printf("fw_update: block %d crc mismatch\r\n", index);
+		return false;
+	}
+
+	// a retried block is fine as long as it is the same data
+	if (bit_get(blocks_done, index)) {
+		return memcmp(block_buf, (const void *)(upd_base + ((uint32_t)index * FW_UPD_BLOCK_SIZE)), len) == 0;
+	}
+
+	if (!staging_program(index, block_buf, len)) return false;
+	bit_set(blocks_done, index);
+	blocks_received++;
+	return true;
+}
+
+static bool handle_commit(void)
+{
+	fw_image_desc_t desc;
+	uint16_t blocks = (upd_size + FW_UPD_BLOCK_SIZE - 1) / FW_UPD_BLOCK_SIZE;
+
+	if (upd_state != FW_UPD_RECEIVING || blocks_received != blocks) return false;
+
+	if (util_hw_crc32((const uint8_t *)upd_base, upd_size) != upd_crc) {
+		printf("fw_update: image crc mismatch\r\n");
+		return false;
+	}
+
+	memset(&desc, 0, sizeof(desc));
+	desc.magic = FW_UPD_DESC_MAGIC;
+	desc.image_size = upd_size;
+	desc.image_crc32 = upd_crc;
+	memcpy(desc.sha, upd_sha, FW_UPD_SHA_LEN);
+	desc.seq = (upd_prev_seq > slot_seq(running_base()) ? upd_prev_seq : slot_seq(running_base())) + 1U;
+	desc.desc_crc32 = util_hw_crc32((const uint8_t *)&desc, offsetof(fw_image_desc_t, desc_crc32));
+
+	// the descriptor page was erased by BEGIN
+	if (Flash_Write(upd_base + FW_SLOT_DESC_OFFSET, &desc, sizeof(desc)) != HAL_OK) {
+		return false;
+	}
+
+#ifndef FW_AB_SLOTS
+	bootloader_request_install();
+#endif
+	upd_state = FW_UPD_COMMITTED;
+	return true;
+}
+
+// same path as OW_CMD_RESET, the response goes out first
+static bool schedule_reset(void)
+{
+	__HAL_LPTIM_CLEAR_FLAG(&RESET_TIMER, LPTIM_FLAG_ARRM | LPTIM_FLAG_CMPM |
+										  LPTIM_FLAG_EXTTRIG | LPTIM_FLAG_DOWN |
+										  LPTIM_FLAG_UP    | LPTIM_FLAG_ARROK);
+	return HAL_LPTIM_Counter_Start_IT(&RESET_TIMER, 1500000) == HAL_OK;
+}
+
+static bool handle_activate(void)
+{
+#ifdef FW_AB_SLOTS
+	uint32_t target = target_base();
+	const fw_image_desc_t *desc = slot_desc(target);
+
+	// also valid after a reboot, as long as the other slot holds a newer image
+	if (upd_state == FW_UPD_RECEIVING || !desc_valid(desc) || desc->seq <= slot_seq(running_base())) return false;
+	if (util_hw_crc32((const uint8_t *)target, desc->image_size) != desc->image_crc32) return false;
+	bootloader_request_trial(target);
+#else
+	if (upd_state != FW_UPD_COMMITTED) return false;
+#endif
+	return schedule_reset();
+}
+
+void fw_update_process(UartPacket *cmd, UartPacket *resp)
+{
+	bool ok = true;
+
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+	resp->data_len = 0;
+	resp->data = NULL;
+
+	switch (cmd->reserved)
+	{
+	case FW_UPD_INFO:
+	{
+		fw_update_info_t *info = (fw_update_info_t *)resp_buf;
+		memset(info, 0, sizeof(*info));
+		info->block_size = FW_UPD_BLOCK_SIZE;
+		info->running_size = running_size();
+		info->max_image_size = FW_STAGING_MAX_IMAGE;
+		info->blocks_total = (upd_size + FW_UPD_BLOCK_SIZE - 1) / FW_UPD_BLOCK_SIZE;
+		info->blocks_received = blocks_received;
+		info->state = (uint8_t)upd_state;
+		strncpy(info->sha, FW_SHA_STRING, FW_UPD_SHA_LEN - 1);
+		info->running_base = running_base();
+		info->target_base = target_base();
+		info->running_seq = slot_seq(running_base());
+#ifdef FW_AB_SLOTS
+		info->ab_slots = 1;
+#endif
+		resp->data_len = sizeof(*info);
+		resp->data = resp_buf;
+		break;
+	}
+	case FW_UPD_MANIFEST:
+	{
+		uint16_t first;
+		uint8_t count;
+		uint32_t size = running_size();
+
+		if (cmd->data_len != 3) {
+			ok = false;
+			break;
+		}
+		first = cmd->data[0] | (cmd->data[1] << 8);
+		count = cmd->data[2];
+		for (uint8_t i = 0; i < count; i++) {
+			uint32_t len = block_len(size, first + i);
+			uint32_t crc;
+			if (len == 0) break;
+			crc = util_hw_crc32((const uint8_t *)(running_base() + ((uint32_t)(first + i) * FW_UPD_BLOCK_SIZE)), len);
+			memcpy(&resp_buf[resp->data_len], &crc, sizeof(crc));
+			resp->data_len += sizeof(crc);
+		}
+		resp->data = resp_buf;
+		break;
+	}
+	case FW_UPD_BEGIN:
+		ok = handle_begin(cmd);
+		if (!ok) reset_session();
+		break;
+	case FW_UPD_BLOCK:
+		ok = handle_block(cmd);
+		break;
+	case FW_UPD_COMMIT:
+		ok = handle_commit();
+		break;
+	case FW_UPD_ABORT:
+		reset_session();
+		break;
+	case FW_UPD_ACTIVATE:
+		ok = handle_activate();
+		break;
+	default:
+		ok = false;
+		break;
+	}
+
+	if (!ok) {
+		resp->packet_type = OW_ERROR;
+	}
+}
@@ -0,0 +1,263 @@
+/*
+ * fx_math.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Integer replacements for the libm calls conversions used to make.  Every
+ *  function is plain 32/64 bit integer arithmetic with a fixed number of
+ *  steps, so results are bit exact between runs and between the target and
+ *  a host build, and the time taken does not depend on the argument.
+ */
+
+#include "fx_math.h"
+
+#define FX_LN2_Q31			1488522236U		// ln(2)
+#define FX_LOG2E_Q30		1549082005		// log2(e)
+#define FX_RECIP_C1_Q30		3031741621U		// 48/17, linear start for 1/m over [0.5, 1)
+#define FX_RECIP_C2_Q30		2021161080U		// 32/17
+#define FX_RECIP_STEPS		3				// Newton steps, error 17^-8 before rounding
+
+// 2^(2^-(k+1)) in Q30, one factor per fraction bit of the exp2 argument
+static const uint32_t exp2_bits_q30[16] = {
+	1518500250U, 1276901417U, 1170923762U, 1121280436U,
+	1097253708U, 1085434106U, 1079572136U, 1076653033U,
+	1075196443U, 1074468888U, 1074105294U, 1073923544U,
+	1073832680U, 1073787251U, 1073764537U, 1073753181U,
+};
+
+q16_t fx_mul_q16(q16_t a, q16_t b)
+{
+	int64_t p = ((int64_t)a * b + 0x8000) >> 16;
+
+	if (p > FX_Q16_MAX) return FX_Q16_MAX;
+	if (p < FX_Q16_MIN) return FX_Q16_MIN;
+	return (q16_t)p;
+}
+
+float fx_q16_to_float(q16_t x)
+{
+	return (float)x * (1.0f / 65536.0f);
+}
+
+/* 1/d for d != 0 as a Q30 mantissa in [1, 2] and the shift that goes with
+ * it: 1/d = r * 2^(*shift - 62). */
+static uint32_t recip_norm(uint32_t d, int *shift)
+{
+	int n = __CLZ(d);
+	uint32_t m = d << n;	// [0.5, 1) as Q32
+	uint32_t r = FX_RECIP_C1_Q30 - (uint32_t)(((uint64_t)FX_RECIP_C2_Q30 * m) >> 32);
+
+	for (int i = 0; i < FX_RECIP_STEPS; i++) {
+		uint32_t e = (uint32_t)(((uint64_t)m * r) >> 32);		// m * r, Q30 just under 1.0
+		r = (uint32_t)(((uint64_t)r * ((2U << 30) - e)) >> 30);
+	}
+	*shift = n;
+	return r;
+}
+
+q16_t fx_div_q16(q16_t num, q16_t den)
+{
+	uint32_t a = (num < 0) ? -(uint32_t)num : (uint32_t)num;
+	uint32_t d = (den < 0) ? -(uint32_t)den : (uint32_t)den;
+	bool neg = (num < 0) != (den < 0);
+	uint64_t q;
+	int64_t rem;
+	int n;
+
+	if (d == 0) {
+		return neg ? FX_Q16_MIN : FX_Q16_MAX;
+	}
+	q = ((uint64_t)a * recip_norm(d, &n)) >> (46 - n);
+
+	// the estimate is within a couple of LSB, settle it against the remainder
+	rem = ((int64_t)a << 16) - (int64_t)(q * d);
+	while (rem < 0) {
+		q--;
+		rem += d;
+	}
+	while (rem >= (int64_t)d) {
+		q++;
+		rem -= d;
+	}
+	if (2 * rem >= (int64_t)d) {
+		q++;
+	}
+	if (q > 0x7FFFFFFFULL) {
+		return neg ? FX_Q16_MIN : FX_Q16_MAX;
+	}
+	return neg ? -(q16_t)q : (q16_t)q;
+}
+
+q16_t fx_recip_q16(q16_t x)
+{
+	return fx_div_q16(FX_Q16_ONE, x);
+}
+
+/* Integer part from the leading bit, then one fraction bit per squaring of
+ * the mantissa in [1, 2). */
+q16_t fx_log2_q16(q16_t x)
+{
+	uint32_t m;
+	int32_t result;
+	int n;
+
+	if (x <= 0) {
+		return FX_Q16_MIN;
+	}
+	n = __CLZ((uint32_t)x);
+	result = (15 - n) * (2 * FX_Q16_ONE);	// one guard bit, rounded off at the end
+	m = (uint32_t)x << n;	// [1, 2) as Q31
+
+	for (int bit = 16; bit >= 0; bit--) {
+		uint64_t sq = ((uint64_t)m * m) >> 31;
+		if (sq >= (2ULL << 31)) {
+			sq >>= 1;
+			result |= 1 << bit;
+		}
+		m = (uint32_t)sq;
+	}
+	return (result + 1) >> 1;
+}
+
+q16_t fx_ln_q16(q16_t x)
+{
+	q16_t l2 = fx_log2_q16(x);
+
+	if (l2 == FX_Q16_MIN) {
+		return FX_Q16_MIN;
+	}
+	return (q16_t)(((int64_t)l2 * FX_LN2_Q31 + (1LL << 30)) >> 31);
+}
+
+/* 2^ipart * 2^(frac / 2^32) in Q16.  The top 16 fraction bits go through
+ * the table, below that 2^f is 1 + f ln2 to well under 2^-30. */
+static q16_t exp2_q16(int32_t ipart, uint32_t frac)
+{
+	uint32_t r = 1U << 30;
+	uint32_t lo = frac & 0xFFFF;
+	int sh;
+
+	if (ipart >= 15) {
+		return FX_Q16_MAX;
+	}
+	if (ipart < -17) {
+		return 0;
+	}
+	for (int k = 0; k < 16; k++) {
+		if (frac & (0x80000000U >> k)) {
+			r = (uint32_t)(((uint64_t)r * exp2_bits_q30[k] + (1U << 29)) >> 30);
+		}
+	}
+	r += (uint32_t)(((((uint64_t)r * lo) >> 16) * FX_LN2_Q31) >> 47);
+	// r is 2^frac in Q30, the result wants Q16 scaled by 2^ipart
+	sh = 14 - ipart;
+	if (sh == 0) {
+		return (r > (uint32_t)FX_Q16_MAX) ? FX_Q16_MAX : (q16_t)r;
+	}
+	return (q16_t)((r + (1U << (sh - 1))) >> sh);
+}
+
+q16_t fx_exp2_q16(q16_t x)
+{
+	// floor, the fraction left over is always positive
+	return exp2_q16(x >> 16, (uint32_t)x << 16);
+}
+
+q16_t fx_exp_q16(q16_t x)
+{
+	int64_t l = (int64_t)x * FX_LOG2E_Q30;	// Q46
+
+	return exp2_q16((int32_t)(l >> 46), (uint32_t)(l >> 14));
+}
+
+// digit by digit, floor(sqrt(x)) in 16 fixed steps
+uint32_t fx_isqrt_u32(uint32_t x)
+{
+	uint32_t root = 0;
+	uint32_t bit = 1U << 30;
+
+	while (bit != 0) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+// sqrt(x * 2^16), the same digit by digit walk over 48 bits
+q16_t fx_sqrt_q16(q16_t x)
+{
+	uint64_t v = (uint64_t)(uint32_t)x << 16;
+	uint64_t root = 0;
+	uint64_t bit = 1ULL << 46;
+
+	if (x <= 0) {
+		return 0;
+	}
+	while (bit != 0) {
+		if (v >= root + bit) {
+			v -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (q16_t)root;
+}
+
+void fx_vadd_q15(const q15_t *a, const q15_t *b, q15_t *dst, uint32_t n)
+{
+	uint32_t i = 0;
+
+	// two channels per QADD16
+	for (; i + 1 < n; i += 2) {
+		uint32_t pa = (uint16_t)a[i] | ((uint32_t)(uint16_t)a[i + 1] << 16);
+		uint32_t pb = (uint16_t)b[i] | ((uint32_t)(uint16_t)b[i + 1] << 16);
+		uint32_t s = __QADD16(pa, pb);
+		dst[i] = (q15_t)(s & 0xFFFF);
+		dst[i + 1] = (q15_t)(s >> 16);
+	}
+	if (i < n) {
+		dst[i] = (q15_t)__SSAT((int32_t)a[i] + b[i], 16);
+	}
+}
+
+void fx_voffset_q15(const q15_t *src, q15_t offset, q15_t *dst, uint32_t n)
+{
+	uint32_t po = (uint16_t)offset | ((uint32_t)(uint16_t)offset << 16);
+	uint32_t i = 0;
+
+	for (; i + 1 < n; i += 2) {
+		uint32_t ps = (uint16_t)src[i] | ((uint32_t)(uint16_t)src[i + 1] << 16);
+		uint32_t s = __QADD16(ps, po);
+		dst[i] = (q15_t)(s & 0xFFFF);
+		dst[i + 1] = (q15_t)(s >> 16);
+	}
+	if (i < n) {
+		dst[i] = (q15_t)__SSAT((int32_t)src[i] + offset, 16);
+	}
+}
+
+void fx_vscale_q15(const q15_t *src, q15_t scale, uint8_t shift, q15_t *dst, uint32_t n)
+{
+	int sh = 15 - (shift > 15 ? 15 : shift);
+	int32_t round = (sh > 0) ? (1 << (sh - 1)) : 0;
+
+	for (uint32_t i = 0; i < n; i++) {
+		int32_t p = ((int32_t)src[i] * scale + round) >> sh;
+		dst[i] = (q15_t)__SSAT(p, 16);
+	}
+}
+
+void fx_vclamp_q15(const q15_t *src, q15_t lo, q15_t hi, q15_t *dst, uint32_t n)
+{
+	for (uint32_t i = 0; i < n; i++) {
+		q15_t v = src[i];
+		dst[i] = (v < lo) ? lo : (v > hi) ? hi : v;
+	}
+}
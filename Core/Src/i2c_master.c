@@ -9,6 +9,9 @@
 #include "i2c_protocol.h"
 #include "i2c_master.h"
 #include "if_commands.h"
+#include "thermistor.h"
+#include "trigger.h"
+#include "interlock.h"
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
@@ -20,6 +23,35 @@ uint8_t selected_slave = 0xFF;
 uint8_t found_address_count = 0;
 uint8_t found_addresses[MAX_FOUND_ADDRESSES];
 
+/* chained IT transmit state (global bus, master role only) */
+static I2C_Async_Transfer* async_xfers = NULL;
+static uint8_t async_count = 0;
+static volatile uint8_t async_index = 0;
+static volatile bool async_active = false;
+
+static void async_start_next(void);
+
+/* background MAX31875 read on the local bus: temperature then configuration */
+#define MAX31875_STEP_IDLE		0
+#define MAX31875_STEP_TEMP		1
+#define MAX31875_STEP_CONFIG	2
+#define MAX31875_BUS_WAIT_MS	5
+
+static volatile uint8_t max31875_step = MAX31875_STEP_IDLE;
+static uint8_t max31875_rx[4];
+static volatile bool max31875_overtemp = false;
+static volatile bool max31875_stop_pending = false;	// trip seen in the callback, trigger stopped from the loop
+static volatile uint32_t max31875_trips = 0;
+static volatile uint32_t max31875_errors = 0;
+
+/* Blocking users of the local bus wait out a background sensor read */
+static void local_bus_acquire(void)
+{
+	uint32_t start = HAL_GetTick();
+	while (max31875_step != MAX31875_STEP_IDLE && (HAL_GetTick() - start) < MAX31875_BUS_WAIT_MS) {
+	}
+}
+
 void I2C_scan_local(void)
 {
     // Reset the global array and counter
@@ -69,6 +101,8 @@ void I2C_scan_global(void)
 }
 uint8_t send_buffer_to_slave_local(uint8_t slave_addr, uint8_t* pBuffer, uint16_t buf_len)
 {
+	local_bus_acquire();
+
 	// Check if the I2C handle is valid
     if (HAL_I2C_GetState(LOCAL_I2C_DEVICE) != HAL_I2C_STATE_READY) {
     	printf("===> ERROR I2C Not in ready state\r\n");
@@ -121,7 +155,7 @@ uint16_t read_buffer_of_slave_global(uint8_t slave_addr, uint8_t* pBuffer, uint1
     uint8_t len_bytes[2] = {0};
     if (HAL_I2C_Mem_Read(GLOBAL_I2C_DEVICE, (uint16_t)(slave_addr << 1),
                           0x00, I2C_MEMADD_SIZE_8BIT,
-                          len_bytes, 2, 500) != HAL_OK) {
+                          len_bytes, 2, I2C_GLOBAL_READ_TIMEOUT) != HAL_OK) {
         return 0;
     }
 
@@ -137,10 +171,13 @@ uint16_t read_buffer_of_slave_global(uint8_t slave_addr, uint8_t* pBuffer, uint1
         return 0;
     }
 
+    /* A slave that stops answering mid packet is a failed read like any
+     * other, the callers poll again or report it. */
     if (HAL_I2C_Mem_Read(GLOBAL_I2C_DEVICE, (uint16_t)(slave_addr << 1),
                           0x00, I2C_MEMADD_SIZE_8BIT,
-                          pBuffer, pkt_len, HAL_MAX_DELAY) != HAL_OK) {
-        Error_Handler();
+                          pBuffer, pkt_len, I2C_GLOBAL_READ_TIMEOUT) != HAL_OK) {
+        printf("===> ERROR reading %d byte packet from slave 0x%02X\r\n", pkt_len, slave_addr);
+        return 0;
     }
 
     return pkt_len;
@@ -148,6 +185,8 @@ uint16_t read_buffer_of_slave_global(uint8_t slave_addr, uint8_t* pBuffer, uint1
 
 uint8_t read_data_register_of_slave_local(uint8_t slave_addr, uint8_t* pBuffer, size_t rx_len)
 {
+	local_bus_acquire();
+
 	// Check if the I2C handle is valid
     if (HAL_I2C_GetState(LOCAL_I2C_DEVICE) != HAL_I2C_STATE_READY) {
     	printf("===> ERROR I2C Not in ready state\r\n");
@@ -213,6 +252,8 @@ uint16_t I2C_read_CDCE6214_reg(uint8_t i2c_addr, uint16_t reg_addr)
 
     uint8_t data_to_receive[2];
 
+    local_bus_acquire();
+
     // Start I2C communication
     status = HAL_I2C_Master_Transmit(LOCAL_I2C_DEVICE, i2c_addr << 1, data_to_send, 2, HAL_MAX_DELAY);
     if (status != HAL_OK) {
@@ -245,6 +286,8 @@ bool I2C_write_CDCE6214_reg(uint8_t i2c_addr, uint16_t reg_addr, uint16_t reg_va
     data_to_send[2] = (uint8_t)(reg_val >> 8); // Data high byte
     data_to_send[3] = (uint8_t)(reg_val & 0xFF); // Data low byte
 
+    local_bus_acquire();
+
     // Start I2C communication and send the data
     status = HAL_I2C_Master_Transmit(LOCAL_I2C_DEVICE, i2c_addr << 1, data_to_send, 4, HAL_MAX_DELAY);
     if (status != HAL_OK) {
@@ -255,21 +298,183 @@ bool I2C_write_CDCE6214_reg(uint8_t i2c_addr, uint16_t reg_addr, uint16_t reg_va
 	return b_res;
 }
 
-float MAX31875_ReadTemperature(void) {
-    uint8_t pointer_byte = 0x00;  // Temperature Register
-    uint8_t temp_data[2];
-    int16_t raw_temp;
-    float temperature;
+/*
+ * Chained transmit: the transfers are sent back to back from the I2C
+ * interrupt so the caller can do other work (e.g. program the local TX
+ * chips) while the bus is busy.  Each entry's status is updated as it
+ * completes; a failed entry does not stop the rest of the chain.
+ */
+static void async_start_next(void)
+{
+	while (async_index < async_count) {
+		I2C_Async_Transfer* x = &async_xfers[async_index];
+		x->status = HAL_BUSY;
+		if (HAL_I2C_Master_Transmit_IT(GLOBAL_I2C_DEVICE, (uint16_t)(x->slave_addr << 1),
+										x->pBuffer, x->buf_len) == HAL_OK) {
+			return;
+		}
+		x->status = HAL_ERROR;
+		async_index++;
+	}
+	async_active = false;
+}
+
+bool i2c_master_async_start(I2C_Async_Transfer* xfers, uint8_t count)
+{
+	if (async_active || xfers == NULL || count == 0) {
+		return false;
+	}
+    if (HAL_I2C_GetState(GLOBAL_I2C_DEVICE) != HAL_I2C_STATE_READY) {
+    	printf("===> ERROR I2C Not in ready state (async)\r\n");
+        return false;
+    }
+
+	for (uint8_t i = 0; i < count; i++) {
+		xfers[i].status = HAL_BUSY;
+	}
+	async_xfers = xfers;
+	async_count = count;
+	async_index = 0;
+	async_active = true;
+	async_start_next();
+	return true;
+}
+
+bool i2c_master_async_busy(void)
+{
+	return async_active;
+}
 
-    // Set pointer register to Temperature Register
-    HAL_I2C_Master_Transmit(LOCAL_I2C_DEVICE, MAX31875_ADDRESS << 1, &pointer_byte, 1, HAL_MAX_DELAY);
+bool i2c_master_async_wait(uint32_t timeout_ms)
+{
+	bool ok = true;
+	uint32_t t0 = HAL_GetTick();
+
+	while (async_active) {
+		if ((HAL_GetTick() - t0) >= timeout_ms) {
+			HAL_I2C_Master_Abort_IT(GLOBAL_I2C_DEVICE, (uint16_t)(async_xfers[async_index].slave_addr << 1));
+			async_active = false;
+			break;
+		}
+	}
 
-    // Read temperature data
-    HAL_I2C_Master_Receive(LOCAL_I2C_DEVICE, MAX31875_ADDRESS << 1, temp_data, 2, HAL_MAX_DELAY);
+	for (uint8_t i = 0; i < async_count; i++) {
+		if (async_xfers[i].status != HAL_OK) {
+			async_xfers[i].status = HAL_ERROR;
+			ok = false;
+		}
+	}
+	return ok;
+}
 
-    // Convert raw data to temperature
-    raw_temp = (temp_data[0] << 8) | temp_data[1];
-    temperature = (raw_temp >> 4) * 0.0625;  // For 12-bit resolution
+/* Called from HAL_I2C_ErrorCallback; returns true if the error belonged to
+ * a chained master transfer and has been handled here. */
+bool i2c_master_handle_error(I2C_HandleTypeDef *hi2c)
+{
+	if (max31875_step != MAX31875_STEP_IDLE && hi2c->Instance == LOCAL_I2C_DEVICE->Instance) {
+		max31875_errors++;
+		max31875_step = MAX31875_STEP_IDLE;
+		return true;
+	}
+	if (!async_active || hi2c->Instance != GLOBAL_I2C_DEVICE->Instance) {
+		return false;
+	}
+	async_xfers[async_index].status = HAL_ERROR;
+	async_index++;
+	async_start_next();
+	return true;
+}
 
-    return temperature;
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	if (!async_active || hi2c->Instance != GLOBAL_I2C_DEVICE->Instance) {
+		return;
+	}
+	async_xfers[async_index].status = HAL_OK;
+	async_xfers[async_index].done_cycles = DWT->CYCCNT;
+	async_index++;
+	async_start_next();
+}
+
+static bool MAX31875_WriteReg(uint8_t reg, uint16_t value)
+{
+	uint8_t data[3] = { reg, (uint8_t)(value >> 8), (uint8_t)(value & 0xFF) };
+	return HAL_I2C_Master_Transmit(LOCAL_I2C_DEVICE, MAX31875_ADDRESS << 1, data, 3, 100) == HAL_OK;
+}
+
+bool MAX31875_Init(void)
+{
+	bool ok = true;
+
+	// limits are in the temperature register format, 1/256 C per LSB
+	ok &= MAX31875_WriteReg(MAX31875_REG_THYST, (uint16_t)(int16_t)(MAX31875_THYST_C * 256));
+	ok &= MAX31875_WriteReg(MAX31875_REG_TOS, (uint16_t)(int16_t)(MAX31875_TOS_C * 256));
+	ok &= MAX31875_WriteReg(MAX31875_REG_CONFIG, MAX31875_CONFIG);
+	return ok;
+}
+
+/* Start the background read, the result lands in ambient_temperature from
+ * the completion callbacks.  Skipped while the bus is in use. */
+bool MAX31875_StartRead(void)
+{
+	if (max31875_step != MAX31875_STEP_IDLE || HAL_I2C_GetState(LOCAL_I2C_DEVICE) != HAL_I2C_STATE_READY) {
+		return false;
+	}
+	max31875_step = MAX31875_STEP_TEMP;
+	if (HAL_I2C_Mem_Read_IT(LOCAL_I2C_DEVICE, MAX31875_ADDRESS << 1, MAX31875_REG_TEMP, I2C_MEMADD_SIZE_8BIT, &max31875_rx[0], 2) != HAL_OK) {
+		max31875_errors++;
+		max31875_step = MAX31875_STEP_IDLE;
+		return false;
+	}
+	return true;
+}
+
+bool MAX31875_OverTemp(void)
+{
+	return max31875_overtemp;
+}
+
+uint32_t MAX31875_TripCount(void)
+{
+	return max31875_trips;
+}
+
+/* Finish an over-temperature trip from the superloop */
+void MAX31875_Process(void)
+{
+	if (max31875_stop_pending) {
+		max31875_stop_pending = false;
+		stop_trigger_pulse();
+	}
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	if (max31875_step == MAX31875_STEP_IDLE || hi2c->Instance != LOCAL_I2C_DEVICE->Instance) {
+		return;
+	}
+
+	if (max31875_step == MAX31875_STEP_TEMP) {
+		int16_t raw_temp = (int16_t)((max31875_rx[0] << 8) | max31875_rx[1]);
+		ambient_temperature = (raw_temp >> 4) * 0.0625f;  // For 12-bit resolution
+
+		max31875_step = MAX31875_STEP_CONFIG;
+		if (HAL_I2C_Mem_Read_IT(hi2c, MAX31875_ADDRESS << 1, MAX31875_REG_CONFIG, I2C_MEMADD_SIZE_8BIT, &max31875_rx[2], 2) != HAL_OK) {
+			max31875_errors++;
+			max31875_step = MAX31875_STEP_IDLE;
+		}
+		return;
+	}
+
+	// The sensor has no alert pin, its comparator sets the OT bit past Tos
+	// (after the fault queue) and clears it below Thyst.  Act on the edge.
+	bool overtemp = (max31875_rx[2] & (MAX31875_CFG_OT_STATUS >> 8)) != 0;
+	if (overtemp && !max31875_overtemp) {
+		// the interlock takes the output down here, the timers are stopped outside the ISR
+		max31875_trips++;
+		interlock_trip(INTERLOCK_CAUSE_OVERTEMP);
+		max31875_stop_pending = true;
+	}
+	max31875_overtemp = overtemp;
+	max31875_step = MAX31875_STEP_IDLE;
 }
@@ -16,6 +16,8 @@
 #include "if_commands.h"
 #include "i2c_protocol.h"
 #include "i2c_slave.h"
+#include "i2c_master.h"
+#include "cmd_noack.h"
 #include "utils.h"
 #include <stdio.h>
 #include <string.h>
@@ -94,6 +96,7 @@ void I2C_Process() {
 
 	UartPacket new_cmd;
 	UartPacket resp;
+	bool noack;
 
 	memset(rec_data_buffer, 0, DATA_BUFFER_SIZE);
 
@@ -119,6 +122,7 @@ void I2C_Process() {
 	}
 	packet_to_send_to_master.id = data_available->id;
 	packet_to_send_to_master.cmd = data_available->cmd;
+	noack = (data_available->tx_id & I2C_FLAG_NOACK) != 0;
 
 	// clear data available buffer
 	data_available = NULL;
@@ -131,15 +135,36 @@ void I2C_Process() {
 	{
 		new_cmd.packet_type = OW_CMD;
 	}
+	else if((new_cmd.command & 0xF0) == 0x10 || (new_cmd.command & 0xF0) == 0x40)
+	{
+		new_cmd.packet_type = OW_CONTROLLER;
+	}
 	else
 	{
 		new_cmd.packet_type = OW_ERROR;
 	}
 
+	if(noack)
+	{
+		cmd_noack_begin();
+	}
 	process_if_command(&new_cmd, &resp);
 
+	if(noack)
+	{
+		cmd_noack_done(&new_cmd, &resp);
+		// the master only reads whether it worked, before it sends the next packet
+		__disable_irq();
+		if(data_available == NULL)
+		{
+			packet_to_send_to_master.reserved = (resp.packet_type == OW_ERROR) ? OW_ERROR : OW_RESP;
+			packet_to_send_to_master.data_len = 0;
+			packet_to_send_to_master.pData = NULL;
+		}
+		__enable_irq();
+	}
 	// convert response to i2c return
-	if(resp.packet_type != OW_ERROR)
+	else if(resp.packet_type != OW_ERROR)
 	{
 		packet_to_send_to_master.id = resp.id;
 		packet_to_send_to_master.cmd = resp.command;
@@ -286,6 +311,10 @@ void HAL_I2C_SlaveRxCpltCallback(I2C_HandleTypeDef *I2cHandle)
 			}
 			packet_to_send_to_master.id = rx_packet.id;
 			packet_to_send_to_master.cmd = rx_packet.cmd;
+			// mark busy until I2C_Process posts the real response
+			packet_to_send_to_master.reserved = I2C_SLAVE_BUSY;
+			packet_to_send_to_master.data_len = 0;
+			packet_to_send_to_master.pData = NULL;
 			// printBuffer(rx_buffer, rx_count);
 			// process or send for processing
 			data_available = &rx_packet;
@@ -306,6 +335,10 @@ void HAL_I2C_SlaveRxCpltCallback(I2C_HandleTypeDef *I2cHandle)
   */
 void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *I2cHandle)
 {
+  if (i2c_master_handle_error(I2cHandle))
+  {
+	return;
+  }
   countError++;
   uint32_t errorcode = HAL_I2C_GetError(I2cHandle);
   if (errorcode == 4)  // AF error
@@ -17,6 +17,21 @@
 #include "demo.h"
 #include "thermistor.h"
 #include "lifu_config.h"
+#include "tx_power.h"
+#include "fw_update.h"
+#include "uart_comms.h"
+#include "replay_cache.h"
+#include "tx_pattern.h"
+#include "link_monitor.h"
+#include "kv_store.h"
+#include "tx_cal.h"
+#include "tx_tcomp.h"
+#include "pc_sampler.h"
+#include "cmd_macro.h"
+#include "interlock.h"
+#include "cmd_deadline.h"
+#include "profile_cache.h"
+#include "cmd_noack.h"
 
 #include <stdio.h>
 #include <stdbool.h>
@@ -36,7 +51,55 @@ uint8_t receive_buffer[I2C_BUFFER_SIZE] = {0};
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
-static void process_i2c_read_buffer(UartPacket *uartResp, UartPacket* cmd, uint8_t module_id);
+/* Scatter write: [tx_id][flags][len lo][len hi] followed by a WBLOCK body
+ * (addr lo, addr hi, count, dummy, count x uint32) per section. */
+#define SCATTER_SECTION_HDR		4
+#define SCATTER_MAX_SECTIONS	32
+#define SCATTER_FLAG_VERIFY		0x01
+#define SCATTER_BUFFER_SIZE		(DATA_MAX_SIZE + (MAX_MODULES * HEADER_SIZE))
+#define SCATTER_XFER_TIMEOUT	200
+#define SCATTER_SLAVE_TIMEOUT	50
+
+/* Relays started ahead of their command so the global I2C transfer runs
+ * while the master's own chips are programmed over SPI.  The packets are
+ * packed into scatter_buff, a scatter write never overlaps them. */
+#define RELAY_FLASH_WAIT_MS		400		// flash erase+program on the slave
+#define RELAY_XFER_TIMEOUT		200
+
+// fan-out response section: [module][packet type][len lo][len hi] then the module's data
+#define FANOUT_SECTION_HDR		4
+
+typedef struct {
+	uint16_t id;
+	uint8_t packet_type;
+	uint8_t command;
+	uint8_t module_id;
+	bool joined;
+} relay_slot_t;
+
+// a fire and forget relay whose result hasn't been read back yet
+typedef struct {
+	bool pending;
+	uint16_t id;
+	uint8_t packet_type;
+	uint8_t command;
+	uint8_t addr;
+	uint32_t sent_cycles;
+} noack_slot_t;
+
+static uint8_t scatter_buff[SCATTER_BUFFER_SIZE];
+static uint8_t scatter_status[SCATTER_MAX_SECTIONS];
+static uint32_t scatter_regs[REG_DATA_LEN];
+
+static relay_slot_t relay_slots[MAX_MODULES];
+static I2C_Async_Transfer relay_xfers[MAX_MODULES];
+static uint8_t relay_count = 0;
+static uint16_t relay_pack_off = 0;
+static bool relay_launched = false;
+static bool relay_in_flight = false;
+static noack_slot_t noack_slots[MAX_MODULES];
+
+static bool process_i2c_read_buffer(UartPacket *uartResp, UartPacket* cmd, uint8_t module_id);
 static void process_i2c_forward(UartPacket *uartResp, UartPacket* cmd, uint8_t module_id);
 
 static void print_uart_packet(const UartPacket* packet) {
@@ -53,7 +116,7 @@ static void print_uart_packet(const UartPacket* packet) {
 }
 
 
-static void process_i2c_read_buffer(UartPacket *uartResp, UartPacket* cmd, uint8_t module_id)
+static bool process_i2c_read_buffer(UartPacket *uartResp, UartPacket* cmd, uint8_t module_id)
 {
 	uint16_t rx_len = 0;
 	uint8_t slave_addr = ModuleManager_GetModule(module_id)->i2c_address;
@@ -67,7 +130,7 @@ static void process_i2c_read_buffer(UartPacket *uartResp, UartPacket* cmd, uint8
 		uartResp->command = cmd->command;
 		uartResp->data_len = 0;
 		uartResp->data = NULL;
-		return;
+		return false;
 	}else{
 		uartResp->id = cmd->id;
 		uartResp->packet_type = cmd->packet_type;
@@ -84,22 +147,264 @@ static void process_i2c_read_buffer(UartPacket *uartResp, UartPacket* cmd, uint8
 	}
 
 	rx_len = read_buffer_of_slave_global(slave_addr, receive_buffer, uartResp->data_len);
-	printf("Received %d Bytes \r\n", rx_len);
-	if(i2c_packet_fromBuffer(receive_buffer, &ret_i2c_packet)){
+	if(rx_len > 0 && i2c_packet_fromBuffer(receive_buffer, &ret_i2c_packet)){
 		uartResp->packet_type = ret_i2c_packet.reserved;
 		uartResp->data_len = ret_i2c_packet.data_len;
 		uartResp->data = (uint8_t *)ret_i2c_packet.pData;
+		return true;
+	}
+	uartResp->packet_type = OW_ERROR;
+	return false;
+}
+
+/* Build the I2C packet relaying cmd to module_id, 0 if it can't be relayed */
+static uint16_t relay_pack(UartPacket* cmd, uint8_t module_id, uint8_t flags, uint8_t *buf)
+{
+	I2C_TX_Packet send_i2c_packet;
+	int local_tx_idx = 0;
+
+	/* For TX7332 commands cmd->addr is the global TX chip index, so we compute
+	 * the local chip index within the slave.  For all other packet types
+	 * (HWID, PING, VERSION, USR_CFG, etc.) cmd->addr is the module index and
+	 * local_tx_idx is unused / irrelevant on the slave, so default to 0. */
+	if (cmd->packet_type == OW_TX7332) {
+		local_tx_idx = (cmd->addr == TX7332_ALL_CHIPS) ? TX7332_ALL_CHIPS : cmd->addr - (module_id * TX_PER_MODULE);
 	} else {
+		local_tx_idx = 0;
+	}
+
+	if(cmd->packet_type == OW_TX7332 && local_tx_idx != TX7332_ALL_CHIPS && (local_tx_idx<0 || local_tx_idx>1)){
+		return 0;
+	}
+	if(cmd->data_len > DATA_MAX_SIZE){
+		return 0;
+	}
+
+	send_i2c_packet.id = cmd->id;
+	send_i2c_packet.cmd = cmd->command;
+	send_i2c_packet.tx_id = flags;
+	/* For TX7332 packets the reserved field carries the local chip index.
+	 * For all other packet types (PING, VERSION, HWID, USR_CFG, etc.) pass
+	 * the original reserved value through so read/write mode is preserved. */
+	send_i2c_packet.reserved = (cmd->packet_type == OW_TX7332)
+	                           ? (uint8_t)local_tx_idx
+	                           : cmd->reserved;
+	send_i2c_packet.data_len = cmd->data_len;
+	send_i2c_packet.pData = cmd->data;
+
+	return (uint16_t)i2c_packet_toBuffer(&send_i2c_packet, buf);
+}
+
+/* Commands that may erase and program flash on the slave, a page erase
+ * alone can take ~25 ms and a key-value compaction several of them. */
+static bool relay_writes_flash(const UartPacket *cmd)
+{
+	if (cmd->packet_type == OW_CMD) {
+		switch (cmd->command)
+		{
+		case OW_CMD_USR_CFG:
+			return cmd->reserved == 1;
+		case OW_CMD_FW_UPDATE:
+			return cmd->reserved == FW_UPD_BEGIN || cmd->reserved == FW_UPD_BLOCK || cmd->reserved == FW_UPD_COMMIT;
+		default:
+			return false;
+		}
+	}
+	if (cmd->packet_type != OW_CONTROLLER) {
+		return false;
+	}
+	switch (cmd->command)
+	{
+	case OW_CTRL_KV:
+		return cmd->reserved == KV_OP_WRITE || cmd->reserved == KV_OP_DELETE;
+	case OW_CTRL_TX_CAL:
+		return cmd->reserved == TX_CAL_OP_SET || cmd->reserved == TX_CAL_OP_CLEAR;
+	case OW_CTRL_MACRO:
+		return cmd->reserved == CMD_MACRO_OP_END || cmd->reserved == CMD_MACRO_OP_WRITE ||
+			cmd->reserved == CMD_MACRO_OP_DELETE;
+	case OW_CTRL_PROFILE_CACHE:
+		return cmd->reserved == PROFILE_CACHE_OP_PIN || cmd->reserved == PROFILE_CACHE_OP_UNPIN;
+	case OW_CTRL_TX_TCOMP:
+		return cmd->reserved == TX_TCOMP_OP_SET || cmd->reserved == TX_TCOMP_OP_CLEAR;
+	default:
+		return false;
+	}
+}
+
+/* Read the reply to a relayed command.  Polling starts about when this
+ * slave usually answers and repeats while it still reports busy, the
+ * turnaround measured goes back into the link monitor's estimate.  A
+ * slave still busy at the limit comes back as an OW_TIMEOUT error. */
+static void relay_collect(UartPacket *uartResp, UartPacket* cmd, uint8_t module_id, uint32_t sent_cycles)
+{
+	/* Flash writes keep the slave busy well past its usual turnaround,
+	 * they are given the erase+program time and left out of the estimate. */
+	bool flash_write = relay_writes_flash(cmd);
+	uint32_t first_us = flash_write ? RELAY_FLASH_WAIT_MS * 1000 : link_relay_first_poll_us(module_id);
+	uint32_t limit_us = link_relay_timeout_us(module_id) + (flash_write ? first_us : 0);
+	uint32_t rtt_us;
+	bool ok;
+
+	while (link_elapsed_us(sent_cycles) < first_us) { /* wait for slave to process */ }
+	for (;;) {
+		ok = process_i2c_read_buffer(uartResp, cmd, module_id);
+		rtt_us = link_elapsed_us(sent_cycles);
+		if (!ok || uartResp->packet_type != I2C_SLAVE_BUSY || rtt_us >= limit_us) {
+			break;
+		}
+		uint32_t t0 = DWT->CYCCNT;
+		while (link_elapsed_us(t0) < LINK_POLL_US) { }
+	}
+
+	if (!flash_write) {
+		link_rtt_sample(module_id, rtt_us, ok && uartResp->packet_type != I2C_SLAVE_BUSY);
+	}
+	if (ok && uartResp->packet_type == I2C_SLAVE_BUSY) {
+		uartResp->packet_type = OW_ERROR;
+		uartResp->reserved = OW_TIMEOUT;
+		uartResp->data_len = 0;
+	}
+}
+
+/* Chip writes are all a no-ack relay sends.  Anything with a reply worth
+ * having, or that keeps the slave busy for long, is relayed as usual. */
+static bool relay_noack_ok(const UartPacket *cmd)
+{
+	if (!cmd_noack_active() || cmd->packet_type != OW_TX7332) {
+		return false;
+	}
+	switch (cmd->command)
+	{
+	case OW_TX7332_WREG:
+	case OW_TX7332_VWREG:
+	case OW_TX7332_WBLOCK:
+	case OW_TX7332_VWBLOCK:
+	case OW_TX7332_APPLY:
+	case OW_TX7332_PATTERN:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* The slave holds one packet, the next one may only go once it has
+ * finished the last.  Its result is logged if it didn't work. */
+static void relay_noack_settle(uint8_t module_id)
+{
+	noack_slot_t *ns = &noack_slots[module_id];
+	UartPacket cmd;
+	UartPacket resp;
+
+	if (module_id >= MAX_MODULES || !ns->pending) {
+		return;
+	}
+	ns->pending = false;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.id = ns->id;
+	cmd.packet_type = ns->packet_type;
+	cmd.command = ns->command;
+	cmd.addr = ns->addr;
+	relay_collect(&resp, &cmd, module_id, ns->sent_cycles);
+	if (resp.packet_type == OW_ERROR && resp.reserved == OW_TIMEOUT) {
+		cmd_noack_fail(&cmd, module_id, OW_TIMEOUT, 0);
+	} else if (resp.packet_type != OW_RESP) {
+		cmd_noack_fail(&cmd, module_id, OW_ERROR, resp.packet_type == OW_ERROR ? OW_UNKNOWN_ERROR : resp.packet_type);
+	}
+}
+
+void if_relay_noack_settle(void)
+{
+	for (uint8_t module_id = 1; module_id < MAX_MODULES; module_id++) {
+		relay_noack_settle(module_id);
+	}
+}
+
+static int relay_find(UartPacket* cmd, uint8_t module_id)
+{
+	for (int i = 0; i < relay_count; i++) {
+		if (!relay_slots[i].joined && relay_slots[i].module_id == module_id && relay_slots[i].id == cmd->id &&
+			relay_slots[i].packet_type == cmd->packet_type && relay_slots[i].command == cmd->command) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// the chained transmit has to finish before anything else uses the global bus
+static void relay_settle(void)
+{
+	if (relay_in_flight) {
+		i2c_master_async_wait(RELAY_XFER_TIMEOUT);
+		relay_in_flight = false;
+	}
+}
+
+static bool relay_queue(UartPacket* cmd, uint8_t module_id)
+{
+	uint16_t len;
+
+	if (relay_launched || relay_count >= MAX_MODULES || module_id == 0 || module_id >= get_module_count()) {
+		return false;
+	}
+	for (int i = 0; i < relay_count; i++) {
+		if (relay_slots[i].module_id == module_id) {
+			return false;	// a slave holds one reply, one relay each
+		}
+	}
+	if ((relay_pack_off + HEADER_SIZE + cmd->data_len) > SCATTER_BUFFER_SIZE) {
+		return false;
+	}
+	relay_noack_settle(module_id);
+	len = relay_pack(cmd, module_id, 0, &scatter_buff[relay_pack_off]);
+	if (len == 0) {
+		return false;
+	}
+
+	relay_slots[relay_count].id = cmd->id;
+	relay_slots[relay_count].packet_type = cmd->packet_type;
+	relay_slots[relay_count].command = cmd->command;
+	relay_slots[relay_count].module_id = module_id;
+	relay_slots[relay_count].joined = false;
+	relay_xfers[relay_count].slave_addr = ModuleManager_GetModule(module_id)->i2c_address;
+	relay_xfers[relay_count].pBuffer = &scatter_buff[relay_pack_off];
+	relay_xfers[relay_count].buf_len = len;
+	relay_pack_off += len;
+	relay_count++;
+	return true;
+}
+
+static void relay_join(UartPacket *uartResp, UartPacket* cmd, int slot)
+{
+	I2C_Async_Transfer *x = &relay_xfers[slot];
+	bool all_joined = true;
+
+	relay_settle();
+	relay_slots[slot].joined = true;
+	if (x->status != HAL_OK) {
+		link_rtt_sample(relay_slots[slot].module_id, 0, false);
 		uartResp->packet_type = OW_ERROR;
+		uartResp->command = cmd->command;
+		uartResp->data_len = 0;
+		uartResp->data = NULL;
+	} else {
+		// slave turnaround counts from when its packet finished arriving
+		relay_collect(uartResp, cmd, relay_slots[slot].module_id, x->done_cycles);
+	}
+
+	for (int i = 0; i < relay_count; i++) {
+		if (!relay_slots[i].joined) all_joined = false;
+	}
+	if (all_joined) {
+		if_relay_abandon();
 	}
 }
 
 static void process_i2c_forward(UartPacket *uartResp, UartPacket* cmd, uint8_t module_id)
 {
-	I2C_TX_Packet send_i2c_packet;
 	uint16_t send_len = 0;
 	uint8_t slave_addr = 0;
-	int local_tx_idx = 0;
+	bool noack;
+	int slot;
 
 	if(module_id == 0){
 		uartResp->id = cmd->id;
@@ -110,56 +415,291 @@ static void process_i2c_forward(UartPacket *uartResp, UartPacket* cmd, uint8_t m
 		return;
 	}
 
+	// already sent ahead of its turn, only the reply is left to collect
+	slot = relay_find(cmd, module_id);
+	if(slot >= 0){
+		relay_join(uartResp, cmd, slot);
+		return;
+	}
+	relay_settle();
+	relay_noack_settle(module_id);
+	noack = relay_noack_ok(cmd);
+
 	memset(send_buff, 0, I2C_BUFFER_SIZE);
 
 	slave_addr = ModuleManager_GetModule(module_id)->i2c_address;
 
-	/* For TX7332 commands cmd->addr is the global TX chip index, so we compute
-	 * the local chip index within the slave.  For all other packet types
-	 * (HWID, PING, VERSION, USR_CFG, etc.) cmd->addr is the module index and
-	 * local_tx_idx is unused / irrelevant on the slave, so default to 0. */
-	if (cmd->packet_type == OW_TX7332) {
-		local_tx_idx = cmd->addr - (module_id * TX_PER_MODULE);
-	} else {
-		local_tx_idx = 0;
+	// relay to one of the slaves
+	send_len = relay_pack(cmd, module_id, noack ? I2C_FLAG_NOACK : 0, send_buff);
+	if(send_len == 0){
+		uartResp->packet_type = OW_ERROR;
+		uartResp->command = cmd->command;
+		uartResp->data_len = 0;
+		uartResp->data = NULL;
+		return;
 	}
 
-	if(cmd->packet_type == OW_TX7332 && (local_tx_idx<0 || local_tx_idx>1)){
+	if(send_buffer_to_slave_global(slave_addr, send_buff, send_len) != 0) { // send buffer to slave
 		uartResp->packet_type = OW_ERROR;
+		link_rtt_sample(module_id, 0, false);
+	}else if(noack){
+		// the result is read when the slave is needed next
+		noack_slots[module_id].pending = true;
+		noack_slots[module_id].id = cmd->id;
+		noack_slots[module_id].packet_type = cmd->packet_type;
+		noack_slots[module_id].command = cmd->command;
+		noack_slots[module_id].addr = cmd->addr;
+		noack_slots[module_id].sent_cycles = DWT->CYCCNT;
+		uartResp->id = cmd->id;
+		uartResp->packet_type = OW_RESP;
 		uartResp->command = cmd->command;
-	}else {
-		if(cmd->data_len > DATA_MAX_SIZE){
+		uartResp->data_len = 0;
+		uartResp->data = NULL;
+	}else{
+		relay_collect(uartResp, cmd, module_id, DWT->CYCCNT);
+	}
+}
+
+bool if_relay_post(uint8_t module_id, UartPacket *cmd)
+{
+	return relay_queue(cmd, module_id);
+}
+
+bool if_relay_command(uint8_t module_id, UartPacket *cmd)
+{
+	UartPacket resp;
+
+	memset(&resp, 0, sizeof(resp));
+	resp.id = cmd->id;
+	resp.packet_type = OW_RESP;
+	process_i2c_forward(&resp, cmd, module_id);
+	return resp.packet_type == OW_RESP;
+}
+
+/* Slave chip work that can be sent ahead: register reads and writes and
+ * single chip patterns, validated here the way TX7332_ProcessCommand does
+ * so nothing is relayed that would then be refused. */
+static bool relay_eligible(const UartPacket *cmd)
+{
+	if (cmd->packet_type != OW_TX7332 || get_device_role() != ROLE_MASTER || cmd->addr >= get_tx_chip_count()) {
+		return false;
+	}
+	switch (cmd->command)
+	{
+	case OW_TX7332_WREG:
+	case OW_TX7332_VWREG:
+		return cmd->data_len == 6;
+	case OW_TX7332_WBLOCK:
+	case OW_TX7332_VWBLOCK:
+		return cmd->data_len > 6;
+	case OW_TX7332_RREG:
+		return cmd->data_len == 2;
+	case OW_TX7332_RBLOCK:
+		return cmd->data_len == 4;
+	case OW_TX7332_PATTERN:
+		return cmd->data_len == TX_PATTERN_DESC_LEN || cmd->data_len == TX_PATTERN_DESC_APOD_LEN;
+	case OW_TX7332_APPLY:
+		return cmd->data_len > 0 && (cmd->data_len % 4) == 0 && cmd->data_len <= (PROFILE_CACHE_APPLY_MAX * 4);
+	default:
+		return false;
+	}
+}
+
+bool if_command_is_local(const UartPacket *cmd)
+{
+	return relay_eligible(cmd) && ModuleManager_GetModuleIndex(cmd->addr) == 0;
+}
+
+bool if_relay_queue(UartPacket *cmd)
+{
+	if (!relay_eligible(cmd)) {
+		return false;
+	}
+	return relay_queue(cmd, ModuleManager_GetModuleIndex(cmd->addr));
+}
+
+void if_relay_launch(void)
+{
+	if (relay_count == 0 || relay_launched) {
+		return;
+	}
+	relay_in_flight = i2c_master_async_start(relay_xfers, relay_count);
+	if (!relay_in_flight) {
+		// bus busy, drop the queue and let each command relay the usual way
+		relay_count = 0;
+		relay_pack_off = 0;
+		return;
+	}
+	relay_launched = true;
+}
+
+void if_relay_abandon(void)
+{
+	// a reply nobody collects is overwritten by that slave's next command
+	relay_settle();
+	relay_count = 0;
+	relay_pack_off = 0;
+	relay_launched = false;
+}
+
+/* Poll a slave until it posts its response (it reports I2C_SLAVE_BUSY
+ * while still working) or the timeout expires. */
+static bool read_slave_reply(uint8_t slave_addr, I2C_TX_Packet* reply, uint32_t timeout_ms)
+{
+	uint32_t t0 = HAL_GetTick();
+
+	do {
+		memset(receive_buffer, 0, I2C_BUFFER_SIZE);
+		if (read_buffer_of_slave_global(slave_addr, receive_buffer, I2C_BUFFER_SIZE) > 0 &&
+			i2c_packet_fromBuffer(receive_buffer, reply) &&
+			reply->reserved != I2C_SLAVE_BUSY) {
+			return true;
+		}
+		HAL_Delay(1);
+	} while ((HAL_GetTick() - t0) < timeout_ms);
+
+	return false;
+}
+
+static void TX7332_ScatterWrite(UartPacket *uartResp, UartPacket* cmd)
+{
+	uint16_t sec_off[SCATTER_MAX_SECTIONS];
+	I2C_Async_Transfer xfers[MAX_MODULES];
+	uint8_t xfer_module[MAX_MODULES];
+	uint8_t section_count = 0;
+	uint8_t xfer_count = 0;
+	uint16_t offset = 0;
+	uint16_t pack_off = 0;
+	bool in_flight = false;
+	bool failed = false;
+
+	uartResp->addr = cmd->addr;
+	uartResp->reserved = 0;
+	uartResp->data_len = 0;
+	uartResp->data = NULL;
+	if_relay_abandon();	// scatter_buff is about to be reused
+	if_relay_noack_settle();
+
+	if (cmd->data_len == 0 || cmd->data_len > DATA_MAX_SIZE) {
+		uartResp->packet_type = OW_ERROR;
+		return;
+	}
+
+	// validate every section before touching any hardware
+	while (offset < cmd->data_len) {
+		const uint8_t *sec = &cmd->data[offset];
+		uint16_t body_len;
+		uint8_t reg_count;
+
+		if (section_count >= SCATTER_MAX_SECTIONS || (offset + SCATTER_SECTION_HDR + 4) > cmd->data_len) {
 			uartResp->packet_type = OW_ERROR;
-			uartResp->command = cmd->command;
-			uartResp->data_len = 0;
-			uartResp->data = NULL;
 			return;
 		}
-		// relay to one of the slaves
-		send_i2c_packet.id = cmd->id;
-		send_i2c_packet.cmd = cmd->command;
-		/* For TX7332 packets the reserved field carries the local chip index.
-		 * For all other packet types (PING, VERSION, HWID, USR_CFG, etc.) pass
-		 * the original reserved value through so read/write mode is preserved. */
-		send_i2c_packet.reserved = (cmd->packet_type == OW_TX7332)
-		                           ? (uint8_t)local_tx_idx
-		                           : cmd->reserved;
-		send_i2c_packet.data_len = cmd->data_len;
-		send_i2c_packet.pData = cmd->data;
-
-		send_len = i2c_packet_toBuffer(&send_i2c_packet, send_buff);  // rebuild buffer
-
-		if(send_buffer_to_slave_global(slave_addr, send_buff, send_len) != 0) { // send buffer to slave
+		body_len = sec[2] | (sec[3] << 8);
+		reg_count = sec[SCATTER_SECTION_HDR + 2];
+		if (sec[0] >= get_tx_chip_count() || reg_count == 0 || reg_count > REG_DATA_LEN ||
+			body_len != (4 + (4 * reg_count)) ||
+			(offset + SCATTER_SECTION_HDR + body_len) > cmd->data_len) {
 			uartResp->packet_type = OW_ERROR;
-		}else{
-			/* USR_CFG write involves a flash erase+program cycle on the slave
-			 * which can take up to ~300 ms; give it enough time to finish. */
-			uint32_t wait_ms = (cmd->command == OW_CMD_USR_CFG && cmd->reserved == 1) ? 400U : 50U;
-			uint32_t _t0 = HAL_GetTick();
-			while ((HAL_GetTick() - _t0) < wait_ms) { /* wait for slave to process */ }
-			process_i2c_read_buffer(uartResp, cmd, module_id);
+			return;
+		}
+		sec_off[section_count++] = offset;
+		offset += SCATTER_SECTION_HDR + body_len;
+	}
+	memset(scatter_status, OW_SUCCESS, section_count);
+
+	// pack one i2c packet per slave, with tx ids rewritten to local chip indices
+	for (uint8_t module = 1; module < get_module_count(); module++) {
+		uint8_t *payload = &scatter_buff[pack_off + HEADER_SIZE - 2];
+		uint16_t payload_len = 0;
+		I2C_TX_Packet pkt;
+
+		for (uint8_t i = 0; i < section_count; i++) {
+			const uint8_t *sec = &cmd->data[sec_off[i]];
+			uint16_t sec_len = SCATTER_SECTION_HDR + (sec[2] | (sec[3] << 8));
+			if (ModuleManager_GetModuleIndex(sec[0]) != module) continue;
+			memcpy(&payload[payload_len], sec, sec_len);
+			payload[payload_len] = sec[0] - (module * TX_PER_MODULE);
+			payload_len += sec_len;
+		}
+		if (payload_len == 0) continue;
+
+		pkt.id = cmd->id;
+		pkt.cmd = OW_TX7332_SCATTER;
+		pkt.tx_id = 0;
+		pkt.reserved = 0;
+		pkt.data_len = payload_len;
+		pkt.pData = payload;	// already in place, copied onto itself
+
+		xfers[xfer_count].slave_addr = ModuleManager_GetModule(module)->i2c_address;
+		xfers[xfer_count].pBuffer = &scatter_buff[pack_off];
+		xfers[xfer_count].buf_len = (uint16_t)i2c_packet_toBuffer(&pkt, &scatter_buff[pack_off]);
+		xfer_module[xfer_count] = module;
+		pack_off += xfers[xfer_count].buf_len;
+		xfer_count++;
+	}
+
+	// slaves receive in the background while the local chips are programmed
+	if (xfer_count > 0) {
+		in_flight = i2c_master_async_start(xfers, xfer_count);
+		if (!in_flight) {
+			for (uint8_t x = 0; x < xfer_count; x++) {
+				xfers[x].status = HAL_ERROR;
+			}
+		}
+	}
+
+	for (uint8_t i = 0; i < section_count; i++) {
+		const uint8_t *sec = &cmd->data[sec_off[i]];
+		const uint8_t *body = &sec[SCATTER_SECTION_HDR];
+		uint16_t reg_address = body[0] | (body[1] << 8);
+		uint8_t reg_count = body[2];
+		bool ok;
+
+		if (ModuleManager_GetModuleIndex(sec[0]) != 0) continue;
+
+		memcpy((uint8_t*)scatter_regs, &body[4], sizeof(uint32_t) * reg_count);
+		if (sec[1] & SCATTER_FLAG_VERIFY) {
+			ok = TX7332_WriteBulkVerify(&transmitters[sec[0]], reg_address, scatter_regs, reg_count);
+		} else {
+			ok = TX7332_WriteBulk(&transmitters[sec[0]], reg_address, scatter_regs, reg_count);
 		}
-	}	
+		if (!ok) {
+			scatter_status[i] = OW_UNKNOWN_ERROR;
+		}
+	}
+
+	// single join: collect each slave's result as soon as it is posted
+	if (in_flight) {
+		i2c_master_async_wait(SCATTER_XFER_TIMEOUT);
+	}
+	for (uint8_t x = 0; x < xfer_count; x++) {
+		I2C_TX_Packet reply;
+		uint8_t status = OW_SUCCESS;
+
+		if (xfers[x].status != HAL_OK) {
+			status = OW_INVALID_PACKET;
+		} else if (!read_slave_reply(xfers[x].slave_addr, &reply, SCATTER_SLAVE_TIMEOUT) ||
+				   reply.reserved != OW_RESP) {
+			status = OW_UNKNOWN_ERROR;
+		}
+		if (status == OW_SUCCESS) continue;
+
+		for (uint8_t i = 0; i < section_count; i++) {
+			if (ModuleManager_GetModuleIndex(cmd->data[sec_off[i]]) == xfer_module[x]) {
+				scatter_status[i] = status;
+			}
+		}
+	}
+
+	for (uint8_t i = 0; i < section_count; i++) {
+		if (scatter_status[i] != OW_SUCCESS) failed = true;
+	}
+	if (failed) {
+		uartResp->packet_type = OW_ERROR;
+	}
+	uartResp->data_len = section_count;
+	uartResp->data = scatter_status;
 }
 
 static void ONE_WIRE_ProcessCommand(UartPacket *uartResp, UartPacket *cmd)
@@ -212,8 +752,13 @@ static void ONE_WIRE_ProcessCommand(UartPacket *uartResp, UartPacket *cmd)
 		case OW_CMD_GET_TEMP:
 			uartResp->id = cmd->id;
 			uartResp->command = cmd->command;
-			uartResp->data_len = 4;
-			uartResp->data = (uint8_t *)&tx_temperature;
+			if (cmd->reserved == THERM_GET_STATUS) {
+				uartResp->data_len = sizeof(thermistor_status_t);
+				uartResp->data = (uint8_t *)Thermistor_GetStatus();
+			} else {
+				uartResp->data_len = 4;
+				uartResp->data = (uint8_t *)&tx_temperature;
+			}
 			break;
 		case OW_CMD_GET_AMBIENT:
 			uartResp->id = cmd->id;
@@ -340,9 +885,112 @@ static void ONE_WIRE_ProcessCommand(UartPacket *uartResp, UartPacket *cmd)
 	}
 }
 
+static void CONTROLLER_ProcessCommand(UartPacket *uartResp, UartPacket* cmd);
+
+/* Commands that can go to every module at once, reads and harmless actions */
+static bool fanout_allowed(const UartPacket *cmd)
+{
+	switch (cmd->command)
+	{
+	case OW_CMD_PING:
+	case OW_CMD_VERSION:
+	case OW_CMD_HWID:
+	case OW_CMD_TOGGLE_LED:
+	case OW_CMD_RESET:
+	case OW_CMD_GET_TEMP:
+	case OW_CMD_GET_AMBIENT:
+		return true;
+	case OW_CMD_USR_CFG:
+	case OW_CTRL_TX_POWER:
+	case OW_CTRL_TX_CAL:
+	case OW_CTRL_TX_TCOMP:
+	case OW_CTRL_MACRO:
+	case OW_CTRL_INTERLOCK:
+	case OW_CTRL_PROFILE_CACHE:
+		return cmd->reserved == 0;
+	default:
+		return false;
+	}
+}
+
+static void fanout_section(uint16_t *offset, uint8_t module_id, const UartPacket *resp)
+{
+	uint8_t *sec = &scatter_buff[*offset];
+	uint8_t packet_type = resp->packet_type;
+	uint16_t len = (packet_type == OW_RESP) ? resp->data_len : 0;
+
+	if ((*offset + FANOUT_SECTION_HDR + len) > DATA_MAX_SIZE) {
+		packet_type = OW_ERROR;	// does not fit, ask this module on its own
+		len = 0;
+	}
+	sec[0] = module_id;
+	sec[1] = packet_type;
+	sec[2] = len & 0xFF;
+	sec[3] = len >> 8;
+	if (len > 0) {
+		memcpy(&sec[FANOUT_SECTION_HDR], resp->data, len);
+	}
+	*offset += FANOUT_SECTION_HDR + len;
+}
+
+/* addr OW_ALL_MODULES: the command goes to every slave in one chained
+ * transmit, the master does its own part while that is on the bus and the
+ * replies come back as one response, a section per module in module order. */
+static void CONTROLLER_FanOut(UartPacket *uartResp, UartPacket* cmd)
+{
+	UartPacket sub;
+	UartPacket sub_resp;
+	uint16_t offset = 0;
+	uint8_t module_count = get_module_count();
+
+	uartResp->command = cmd->command;
+	uartResp->addr = cmd->addr;
+	uartResp->reserved = cmd->reserved;
+	uartResp->data_len = 0;
+	uartResp->data = NULL;
+	if (!fanout_allowed(cmd) || get_device_role() != ROLE_MASTER) {
+		uartResp->packet_type = OW_ERROR;
+		return;
+	}
+
+	for (uint8_t module_id = 1; module_id < module_count; module_id++) {
+		relay_queue(cmd, module_id);	// one that doesn't queue is relayed on its own below
+	}
+	if_relay_launch();
+
+	sub = *cmd;
+	sub.addr = 0;
+	memset(&sub_resp, 0, sizeof(sub_resp));
+	sub_resp.id = cmd->id;
+	sub_resp.packet_type = OW_RESP;
+	CONTROLLER_ProcessCommand(&sub_resp, &sub);
+
+	// relay packets are out once settled, the sections reuse their buffer
+	relay_settle();
+	fanout_section(&offset, 0, &sub_resp);
+
+	for (uint8_t module_id = 1; module_id < module_count; module_id++) {
+		sub = *cmd;
+		sub.addr = module_id;
+		memset(&sub_resp, 0, sizeof(sub_resp));
+		sub_resp.id = cmd->id;
+		sub_resp.packet_type = OW_RESP;
+		process_i2c_forward(&sub_resp, &sub, module_id);
+		fanout_section(&offset, module_id, &sub_resp);
+	}
+	if_relay_abandon();
+
+	uartResp->data_len = offset;
+	uartResp->data = scatter_buff;
+}
+
 static void CONTROLLER_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 {
 	uint8_t module_id = 0;
+	if (cmd->addr == OW_ALL_MODULES) {
+		CONTROLLER_FanOut(uartResp, cmd);
+		return;
+	}
 	if (cmd->addr >= get_module_count()) {
 		uartResp->packet_type = OW_ERROR;
 		return;
@@ -415,12 +1063,22 @@ static void CONTROLLER_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 			}
 			break;
 		case OW_CMD_GET_TEMP:
-			cmd->data_len = TEMPERATURE_DATA_LENGTH; //passing amount to read if forwarding to slave
+			// reserved THERM_GET_STATUS adds what the conversion cost to the reading
+			if (cmd->reserved == THERM_GET_STATUS) {
+				cmd->data_len = sizeof(thermistor_status_t);
+			} else {
+				cmd->data_len = TEMPERATURE_DATA_LENGTH; //passing amount to read if forwarding to slave
+			}
 			if (module_id == 0){
 				uartResp->id = cmd->id;
 				uartResp->command = cmd->command;
-				uartResp->data_len = TEMPERATURE_DATA_LENGTH;
-				uartResp->data = (uint8_t *)&tx_temperature;
+				if (cmd->reserved == THERM_GET_STATUS) {
+					uartResp->data_len = sizeof(thermistor_status_t);
+					uartResp->data = (uint8_t *)Thermistor_GetStatus();
+				} else {
+					uartResp->data_len = TEMPERATURE_DATA_LENGTH;
+					uartResp->data = (uint8_t *)&tx_temperature;
+				}
 			}else{
 				process_i2c_forward(uartResp, cmd, module_id);
 			}
@@ -441,6 +1099,13 @@ static void CONTROLLER_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 			uartResp->addr = cmd->addr;
 			uartResp->reserved = cmd->reserved;
 			uartResp->data_len = 0;
+			if(MAX31875_OverTemp())
+			{
+				// ambient sensor is over Tos, stays refused until it drops below Thyst
+				uartResp->packet_type = OW_ERROR;
+				break;
+			}
+			tx_power_prepare_start();
 			if(start_trigger_pulse() != TRIGGER_STATUS_RUNNING)
 			{
 				uartResp->packet_type = OW_ERROR;
@@ -583,6 +1248,169 @@ static void CONTROLLER_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 				process_i2c_forward(uartResp, cmd, module_id);
 			}
 			break;
+		case OW_CMD_FW_UPDATE:
+			if (module_id != 0x00)
+			{
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			fw_update_process(cmd, uartResp);
+			break;
+		case OW_CTRL_TX_POWER:
+			if (module_id != 0x00)
+			{
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			uartResp->command = cmd->command;
+			uartResp->addr = cmd->addr;
+			uartResp->reserved = cmd->reserved;
+			switch (cmd->reserved)
+			{
+				case TX_POWER_OP_GET:
+					break;
+				case TX_POWER_OP_SET:
+					if (cmd->data_len != 8) {
+						uartResp->packet_type = OW_ERROR;
+						break;
+					}
+					tx_power_set_config(cmd->data[0] | (cmd->data[1] << 8) | (cmd->data[2] << 16) | ((uint32_t)cmd->data[3] << 24),
+										cmd->data[4] | (cmd->data[5] << 8) | (cmd->data[6] << 16) | ((uint32_t)cmd->data[7] << 24));
+					break;
+				case TX_POWER_OP_WAKE:
+					tx_power_wake(true);
+					break;
+				case TX_POWER_OP_RELEASE:
+					tx_power_release();
+					break;
+				default:
+					uartResp->packet_type = OW_ERROR;
+					break;
+			}
+			uartResp->data_len = sizeof(tx_power_status_t);
+			uartResp->data = (uint8_t *)tx_power_get_status();
+			break;
+		case OW_CTRL_TX_CAL:
+			if (module_id != 0x00)
+			{
+				// the table goes to the slave as it came, refuse a short one here
+				if (cmd->reserved == TX_CAL_OP_SET && cmd->data_len != sizeof(tx_cal_table_t)) {
+					uartResp->command = cmd->command;
+					uartResp->addr = cmd->addr;
+					uartResp->reserved = cmd->reserved;
+					uartResp->packet_type = OW_ERROR;
+					uartResp->data_len = 0;
+					uartResp->data = NULL;
+					break;
+				}
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			tx_cal_process(cmd, uartResp);
+			break;
+		case OW_CTRL_TX_TCOMP:
+			if (module_id != 0x00)
+			{
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			tx_tcomp_process(cmd, uartResp);
+			break;
+		case OW_CTRL_PROFILE_CACHE:
+			if (module_id != 0x00)
+			{
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			profile_cache_process(cmd, uartResp);
+			break;
+		case OW_CTRL_NOACK:
+			if (module_id != 0x00)
+			{
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			cmd_noack_process(cmd, uartResp);
+			break;
+		case OW_CTRL_COALESCE:
+			// u16 max_bytes, u16 window_us to set, nothing to read
+			uartResp->command = cmd->command;
+			uartResp->addr = cmd->addr;
+			if((cmd->data_len != 0 && cmd->data_len != 4) ||
+			   (cmd->data_len == 4 && !comms_host_set_coalesce(cmd->data[0] | (cmd->data[1] << 8),
+															  cmd->data[2] | (cmd->data[3] << 8)))){
+				uartResp->packet_type = OW_ERROR;
+			}
+			uartResp->data_len = sizeof(host_coalesce_t);
+			uartResp->data = (uint8_t *)comms_host_get_coalesce();
+			break;
+		case OW_CTRL_PROFILE:
+			if (module_id != 0x00)
+			{
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			pc_sampler_process(cmd, uartResp);
+			break;
+		case OW_CTRL_MACRO:
+			if (module_id != 0x00)
+			{
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			cmd_macro_process(cmd, uartResp);
+			break;
+		case OW_CTRL_INTERLOCK:
+			if (module_id != 0x00)
+			{
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			interlock_process(cmd, uartResp);
+			break;
+		case OW_CTRL_DEADLINE:
+			cmd_deadline_process(cmd, uartResp);
+			break;
+		case OW_CTRL_KV:
+			if (module_id != 0x00)
+			{
+				process_i2c_forward(uartResp, cmd, module_id);
+				break;
+			}
+			kv_store_process(cmd, uartResp);
+			break;
+		case OW_CTRL_LINK:
+		{
+			uint8_t count;
+			uartResp->command = cmd->command;
+			uartResp->addr = cmd->addr;
+			uartResp->reserved = cmd->reserved;
+			if(get_device_role() != ROLE_MASTER){
+				uartResp->packet_type = OW_ERROR;
+				break;
+			}
+			switch (cmd->reserved)
+			{
+				case LINK_OP_STATUS:
+					break;
+				case LINK_OP_ENABLE:
+					if(cmd->data_len == 1){
+						link_monitor_enable(cmd->data[0] == 1);
+					}
+					break;
+				case LINK_OP_RECOVER:
+					if(cmd->addr == 0 || cmd->addr >= get_module_count() || !link_monitor_recover(cmd->addr)){
+						uartResp->packet_type = OW_ERROR;
+					}
+					break;
+				default:
+					uartResp->packet_type = OW_ERROR;
+					break;
+			}
+			uartResp->data = (uint8_t *)link_monitor_status(&count);
+			uartResp->data_len = count * sizeof(link_module_status_t);
+			break;
+		}
 		case OW_CMD_ASYNC:
 			uartResp->command = cmd->command;
 			uartResp->addr = cmd->addr;
@@ -592,6 +1420,20 @@ static void CONTROLLER_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 			uartResp->reserved = async_enabled?1:0;
 			uartResp->data_len = 0;
 			break;
+		case OW_CMD_CREDIT:
+		{
+			static host_credit_t credit;
+			uartResp->command = cmd->command;
+			uartResp->addr = cmd->addr;
+			if(cmd->data_len == 1){
+				credit_reports_enabled = cmd->data[0] == 1? true: false;
+			}
+			comms_host_get_credit(&credit);
+			uartResp->reserved = credit_reports_enabled?1:0;
+			uartResp->data_len = sizeof(credit);
+			uartResp->data = (uint8_t *)&credit;
+			break;
+		}
 		default:
 			uartResp->addr = 0;
 			uartResp->reserved = OW_INVALID_PACKET;
@@ -602,6 +1444,202 @@ static void CONTROLLER_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 
 }
 
+/* Synthesize a pattern profile from the descriptor and program it on one
+ * chip, or with TX7332_ALL_CHIPS on both local chips and then every slave. */
+static void TX7332_Pattern(UartPacket *uartResp, UartPacket* cmd)
+{
+	static tx_pattern_desc_t desc;
+	uint8_t module_id;
+
+	if(cmd->data_len != TX_PATTERN_DESC_LEN && cmd->data_len != TX_PATTERN_DESC_APOD_LEN){
+		uartResp->packet_type = OW_ERROR;
+		return;
+	}
+	memset(&desc, 0, sizeof(desc));
+	memcpy(&desc, cmd->data, cmd->data_len);
+	if(!(desc.flags & TX_PATTERN_FLAG_APOD)){
+		desc.channel_mask = 0xFFFFFFFF;
+	}
+
+	if(cmd->addr != TX7332_ALL_CHIPS){
+		if(cmd->addr >= get_tx_chip_count()){
+			uartResp->packet_type = OW_ERROR;
+			return;
+		}
+		module_id = ModuleManager_GetModuleIndex(cmd->addr);
+		if(module_id != 0x00){
+			process_i2c_forward(uartResp, cmd, module_id);
+		}else if(!tx_pattern_apply(&transmitters[cmd->addr], &desc)){
+			uartResp->packet_type = OW_ERROR;
+		}
+		return;
+	}
+
+	// slaves receive the descriptor while the local chips are programmed
+	if(get_device_role() == ROLE_MASTER){
+		for(module_id = 1; module_id < get_module_count(); module_id++){
+			relay_queue(cmd, module_id);
+		}
+		if_relay_launch();
+	}
+	for(int i = 0; i < TX_PER_MODULE; i++){
+		if(!tx_pattern_apply(&transmitters[i], &desc)){
+			if_relay_abandon();
+			uartResp->packet_type = OW_ERROR;
+			return;
+		}
+	}
+	if(get_device_role() != ROLE_MASTER){
+		return;
+	}
+	for(module_id = 1; module_id < get_module_count(); module_id++){
+		process_i2c_forward(uartResp, cmd, module_id);
+		if(uartResp->packet_type != OW_RESP){
+			uartResp->packet_type = OW_ERROR;
+			uartResp->reserved = module_id;	// first module that failed
+			break;
+		}
+	}
+	if_relay_abandon();
+	uartResp->command = OW_TX7332_PATTERN;
+	uartResp->addr = cmd->addr;
+	uartResp->data_len = 0;
+	uartResp->data = NULL;
+}
+
+/* Record register writes that reached a slave, so the link monitor can put
+ * them back if that slave reboots and has to be re-discovered. */
+static void journal_pattern(uint8_t module_id, uint8_t local_tx, const tx_pattern_desc_t *desc)
+{
+	uint32_t words[TX_PATTERN_PROFILE_WORDS];
+	uint32_t pdn;
+
+	if(tx_pattern_synthesize(desc, words) < 0){
+		return;
+	}
+	link_journal_write(module_id, local_tx, TX_PATTERN_PROFILE_BASE + desc->profile * TX_PATTERN_PROFILE_WORDS,
+					   (const uint8_t *)words, TX_PATTERN_PROFILE_WORDS);
+	pdn = (desc->flags & TX_PATTERN_FLAG_APOD) ? ~desc->channel_mask : 0;
+	link_journal_write(module_id, local_tx, TX_CHANNEL_PDN_REG, (const uint8_t *)&pdn, 1);
+}
+
+static void TX7332_Journal(UartPacket *uartResp, UartPacket* cmd)
+{
+	static tx_pattern_desc_t desc;
+	uint8_t module_id;
+	uint8_t last_module;
+	uint16_t offset = 0;
+	uint8_t section = 0;
+
+	if(get_device_role() != ROLE_MASTER){
+		return;
+	}
+
+	switch(cmd->command)
+	{
+	case OW_TX7332_WREG:
+	case OW_TX7332_VWREG:
+	case OW_TX7332_WBLOCK:
+	case OW_TX7332_VWBLOCK:
+		if(uartResp->packet_type != OW_RESP || cmd->addr >= get_tx_chip_count()){
+			break;
+		}
+		module_id = ModuleManager_GetModuleIndex(cmd->addr);
+		if(module_id == 0x00){
+			break;
+		}
+		if(cmd->command == OW_TX7332_WREG || cmd->command == OW_TX7332_VWREG){
+			link_journal_write(module_id, ModuleManager_GetLocalTxIndex(cmd->addr),
+							   cmd->data[0] | (cmd->data[1] << 8), &cmd->data[2], 1);
+		}else if(cmd->data_len == (4 + (4 * cmd->data[2]))){
+			link_journal_write(module_id, ModuleManager_GetLocalTxIndex(cmd->addr),
+							   cmd->data[0] | (cmd->data[1] << 8), &cmd->data[4], cmd->data[2]);
+		}
+		break;
+	case OW_TX7332_DEMO:
+		// the slave writes the same demo table the master has
+		if(uartResp->packet_type != OW_RESP || cmd->addr >= get_tx_chip_count()){
+			break;
+		}
+		module_id = ModuleManager_GetModuleIndex(cmd->addr);
+		if(module_id == 0x00){
+			break;
+		}
+		for(int i = 0; i < get_demo_register_count(); i++){
+			uint32_t value = reg_values[i][1];
+			link_journal_write(module_id, ModuleManager_GetLocalTxIndex(cmd->addr), (uint16_t)reg_values[i][0],
+							   (const uint8_t *)&value, 1);
+		}
+		break;
+	case OW_TX7332_APPLY:
+		// the master keeps every block it relays, so a slave hit is a hit here too
+		if(uartResp->packet_type != OW_RESP || cmd->addr >= get_tx_chip_count()){
+			break;
+		}
+		module_id = ModuleManager_GetModuleIndex(cmd->addr);
+		if(module_id == 0x00){
+			break;
+		}
+		for(offset = 0; offset < cmd->data_len; offset += 4){
+			const uint32_t *words;
+			uint16_t reg;
+			uint8_t count;
+			if(profile_cache_find(cmd->data[offset] | (cmd->data[offset + 1] << 8) | (cmd->data[offset + 2] << 16) |
+								  ((uint32_t)cmd->data[offset + 3] << 24), &reg, &count, &words)){
+				link_journal_write(module_id, ModuleManager_GetLocalTxIndex(cmd->addr), reg,
+								   (const uint8_t *)words, count);
+			}
+		}
+		break;
+	case OW_TX7332_SCATTER:
+		// sections were validated before any were sent, keep the ones that landed
+		if(uartResp->data != scatter_status){
+			break;
+		}
+		while(offset < cmd->data_len && section < uartResp->data_len){
+			const uint8_t *sec = &cmd->data[offset];
+			const uint8_t *body = &sec[SCATTER_SECTION_HDR];
+			module_id = ModuleManager_GetModuleIndex(sec[0]);
+			if(module_id != 0x00 && scatter_status[section] == OW_SUCCESS){
+				link_journal_write(module_id, ModuleManager_GetLocalTxIndex(sec[0]),
+								   body[0] | (body[1] << 8), &body[4], body[2]);
+			}
+			offset += SCATTER_SECTION_HDR + (sec[2] | (sec[3] << 8));
+			section++;
+		}
+		break;
+	case OW_TX7332_PATTERN:
+		if(cmd->data_len != TX_PATTERN_DESC_LEN && cmd->data_len != TX_PATTERN_DESC_APOD_LEN){
+			break;
+		}
+		memset(&desc, 0, sizeof(desc));
+		memcpy(&desc, cmd->data, cmd->data_len);
+		if(!(desc.flags & TX_PATTERN_FLAG_APOD)){
+			desc.channel_mask = 0xFFFFFFFF;
+		}
+		if(cmd->addr != TX7332_ALL_CHIPS){
+			if(uartResp->packet_type != OW_RESP || cmd->addr >= get_tx_chip_count()){
+				break;
+			}
+			module_id = ModuleManager_GetModuleIndex(cmd->addr);
+			if(module_id != 0x00){
+				journal_pattern(module_id, ModuleManager_GetLocalTxIndex(cmd->addr), &desc);
+			}
+			break;
+		}
+		// broadcast stops at the first module that failed, everything before it took the pattern
+		last_module = (uartResp->packet_type == OW_RESP) ? get_module_count() : uartResp->reserved;
+		for(module_id = 1; module_id < last_module; module_id++){
+			for(uint8_t tx = 0; tx < TX_PER_MODULE; tx++){
+				journal_pattern(module_id, tx, &desc);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
 static void TX7332_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 {
 	uint8_t module_id = 0;
@@ -631,6 +1669,7 @@ static void TX7332_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 		uartResp->data = NULL;
 		uartResp->addr = cmd->addr;
 		module_id = ModuleManager_GetModuleIndex(cmd->addr);
+		replay_cache_clear();	// registers no longer hold what the cached writes put there
 
 		if(module_id == 0x00) // local
 		{
@@ -844,6 +1883,37 @@ static void TX7332_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 			process_i2c_forward(uartResp, cmd, module_id);
 		}
 		break;
+	case OW_TX7332_SCATTER:
+		uartResp->command = OW_TX7332_SCATTER;
+		TX7332_ScatterWrite(uartResp, cmd);
+		break;
+	case OW_TX7332_APPLY:
+		uartResp->command = OW_TX7332_APPLY;
+		uartResp->addr = cmd->addr;
+		uartResp->reserved = 0;
+		uartResp->data_len = 0;
+		uartResp->data = NULL;
+		if(cmd->data_len == 0 || (cmd->data_len % 4) != 0 || cmd->data_len > (PROFILE_CACHE_APPLY_MAX * 4) ||
+		   cmd->addr >= get_tx_chip_count()){
+			uartResp->packet_type = OW_ERROR;
+			break;
+		}
+
+		module_id = ModuleManager_GetModuleIndex(cmd->addr);
+
+		if(module_id == 0x00) // local
+		{
+			profile_cache_apply(&transmitters[cmd->addr], cmd, uartResp);
+		}else{
+			process_i2c_forward(uartResp, cmd, module_id);
+		}
+		// a slave answers a miss as a reply, the host gets it as an error
+		if((get_device_role() == ROLE_MASTER || cmd_noack_active()) && uartResp->packet_type == OW_RESP &&
+		   uartResp->data_len > 0 && uartResp->data[0] == OW_CACHE_MISS){
+			uartResp->packet_type = OW_ERROR;
+			uartResp->reserved = OW_CACHE_MISS;
+		}
+		break;
 	case OW_TX7332_DEVICE_COUNT:
 	{
 		static uint8_t temp_module_count;
@@ -855,7 +1925,16 @@ static void TX7332_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 		uartResp->data_len = 1;
 	}
 		break;
+	case OW_TX7332_PATTERN:
+		uartResp->command = OW_TX7332_PATTERN;
+		uartResp->addr = cmd->addr;
+		uartResp->reserved = 0;
+		uartResp->data_len = 0;
+		uartResp->data = NULL;
+		TX7332_Pattern(uartResp, cmd);
+		break;
 	case OW_TX7332_RESET:
+		replay_cache_clear();
 		uartResp->command = OW_TX7332_RESET;
 		uartResp->addr = 0;
 		uartResp->reserved = 0;
@@ -868,6 +1947,9 @@ static void TX7332_ProcessCommand(UartPacket *uartResp, UartPacket* cmd)
 		uartResp->packet_type = OW_ERROR;
 		break;
 	}
+
+	TX7332_Journal(uartResp, cmd);
+	profile_cache_store(cmd, uartResp);
 }
 
 bool process_if_command(UartPacket *cmd, UartPacket *resp)
@@ -885,6 +1967,10 @@ bool process_if_command(UartPacket *cmd, UartPacket *resp)
 	resp->reserved = 0;
 	resp->data_len = 0;
 	resp->data = 0;
+	// chip work settles the slaves it goes to, anything else may talk to any of them
+	if(cmd->packet_type != OW_TX7332){
+		if_relay_noack_settle();
+	}
 	switch (cmd->packet_type)
 	{
 	case OW_ONE_WIRE:
@@ -0,0 +1,165 @@
+/*
+ * interlock.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Array wide interlock on the shared EXT line (PB12), open drain and
+ *  pulled up on every module.  On the master the pin is TIM15_BKIN: the
+ *  line going low clears MOE in hardware, the trigger output is forced to
+ *  its idle level within the break filter time and stays there until the
+ *  interlock is cleared, whatever the software is doing.  A slave trips
+ *  the array by pulling the line, the master trips its own timer with a
+ *  software break event.  Each module latches its own cause, so after a
+ *  trip a fan-out STATUS shows who pulled the line and why.
+ */
+
+#include "interlock.h"
+#include "trigger.h"
+#include "i2c_master.h"
+
+#include <string.h>
+
+extern TIM_HandleTypeDef htim15;
+
+static interlock_status_t lock_status;
+
+static bool line_low(void)
+{
+	return HAL_GPIO_ReadPin(EXT_GPIO_Port, EXT_Pin) == GPIO_PIN_RESET;
+}
+
+void interlock_init(bool master)
+{
+	GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+	memset(&lock_status, 0, sizeof(lock_status));
+	lock_status.master = master ? 1 : 0;
+
+	HAL_GPIO_DeInit(EXT_GPIO_Port, EXT_Pin);
+	GPIO_InitStruct.Pin = EXT_Pin;
+	GPIO_InitStruct.Pull = GPIO_PULLUP;
+	GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+	if (master) {
+		GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+		GPIO_InitStruct.Alternate = GPIO_AF14_TIM15;
+		HAL_GPIO_Init(EXT_GPIO_Port, &GPIO_InitStruct);
+		interlock_timer_config(&htim15);
+	} else {
+		HAL_GPIO_WritePin(EXT_GPIO_Port, EXT_Pin, GPIO_PIN_SET);	// released
+		GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_OD;
+		HAL_GPIO_Init(EXT_GPIO_Port, &GPIO_InitStruct);
+	}
+}
+
+/* Break and off-state setup of the trigger timer, applied every time the
+ * trigger code reconfigures it.  Off-state selection keeps the pin driven
+ * to its idle (low) level when MOE drops instead of letting it float, and
+ * MOE is only set again by software, on the next start. */
+void interlock_timer_config(TIM_HandleTypeDef *htim)
+{
+	TIM_BreakDeadTimeConfigTypeDef sBreakDeadTimeConfig = {0};
+
+	sBreakDeadTimeConfig.OffStateRunMode = TIM_OSSR_ENABLE;
+	sBreakDeadTimeConfig.OffStateIDLEMode = TIM_OSSI_ENABLE;
+	sBreakDeadTimeConfig.LockLevel = TIM_LOCKLEVEL_OFF;
+	sBreakDeadTimeConfig.DeadTime = 0;
+	sBreakDeadTimeConfig.BreakState = lock_status.master ? TIM_BREAK_ENABLE : TIM_BREAK_DISABLE;
+	sBreakDeadTimeConfig.BreakPolarity = TIM_BREAKPOLARITY_LOW;
+	sBreakDeadTimeConfig.BreakFilter = INTERLOCK_BREAK_FILTER;
+	sBreakDeadTimeConfig.AutomaticOutput = TIM_AUTOMATICOUTPUT_DISABLE;
+	if (HAL_TIMEx_ConfigBreakDeadTime(htim, &sBreakDeadTimeConfig) != HAL_OK)
+	{
+		Error_Handler();
+	}
+	if (lock_status.master && !lock_status.tripped) {
+		__HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_BREAK);
+		__HAL_TIM_ENABLE_IT(htim, TIM_IT_BREAK);
+	}
+}
+
+static void interlock_latch(InterlockCause cause)
+{
+	if (lock_status.tripped) {
+		return;
+	}
+	lock_status.tripped = 1;
+	lock_status.cause = cause;
+	lock_status.trips++;
+	lock_status.trip_tick = HAL_GetTick();
+}
+
+// safe from interrupt context
+void interlock_trip(InterlockCause cause)
+{
+	interlock_latch(cause);
+	if (lock_status.master) {
+		// the output is already off when the break interrupt runs
+		htim15.Instance->EGR = TIM_EGR_BG;
+	} else {
+		HAL_GPIO_WritePin(EXT_GPIO_Port, EXT_Pin, GPIO_PIN_RESET);
+	}
+}
+
+bool interlock_tripped(void)
+{
+	return lock_status.tripped != 0;
+}
+
+void HAL_TIMEx_BreakCallback(TIM_HandleTypeDef *htim)
+{
+	if (htim->Instance != TIM15) {
+		return;
+	}
+	// BIF sets again for as long as the line is held, one interrupt per trip
+	__HAL_TIM_DISABLE_IT(htim, TIM_IT_BREAK);
+	interlock_latch(INTERLOCK_CAUSE_LINE);
+	stop_trigger_pulse();
+}
+
+static bool interlock_clear(void)
+{
+	if (lock_status.cause == INTERLOCK_CAUSE_OVERTEMP && MAX31875_OverTemp()) {
+		return false;
+	}
+	if (!lock_status.master) {
+		HAL_GPIO_WritePin(EXT_GPIO_Port, EXT_Pin, GPIO_PIN_SET);
+		lock_status.tripped = 0;
+		lock_status.cause = INTERLOCK_CAUSE_NONE;
+		return true;
+	}
+	if (line_low()) {
+		return false;	// somebody still holds it, their cause has to go first
+	}
+	lock_status.tripped = 0;
+	lock_status.cause = INTERLOCK_CAUSE_NONE;
+	__HAL_TIM_CLEAR_FLAG(&htim15, TIM_FLAG_BREAK);
+	__HAL_TIM_ENABLE_IT(&htim15, TIM_IT_BREAK);
+	return true;
+}
+
+void interlock_process(UartPacket *cmd, UartPacket *resp)
+{
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+
+	switch (cmd->reserved)
+	{
+	case INTERLOCK_OP_STATUS:
+		break;
+	case INTERLOCK_OP_TRIP:
+		interlock_trip(INTERLOCK_CAUSE_HOST);
+		break;
+	case INTERLOCK_OP_CLEAR:
+		if (!interlock_clear()) {
+			resp->packet_type = OW_ERROR;
+		}
+		break;
+	default:
+		resp->packet_type = OW_ERROR;
+		break;
+	}
+	lock_status.line_low = line_low() ? 1 : 0;
+	resp->data_len = sizeof(lock_status);
+	resp->data = (uint8_t *)&lock_status;
+}
@@ -0,0 +1,502 @@
+/*
+ * kv_store.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Typed binary records in flash, keyed by a u16.  Records are appended to
+ *  the active bank and the newest valid copy of a key wins.  Each record is
+ *  CRC checked and its header is programmed last, so a write that is cut
+ *  short never shows up.  When the bank is full the live records are copied
+ *  to the other bank and that bank's header, again written last, switches
+ *  over in one step.  Readers get the data in place with kv_store_ptr or a
+ *  memcpy with kv_store_get, there is no parsing.
+ */
+
+#include "kv_store.h"
+#include "flash_eeprom.h"
+#include "utils.h"
+
+#include <stddef.h>
+#include <string.h>
+
+typedef struct {
+	uint16_t key;
+	uint32_t addr;			// record header in the active bank
+} kv_index_t;
+
+static kv_index_t kv_index[KV_MAX_KEYS];
+static uint8_t kv_index_count = 0;
+static bool kv_loaded = false;
+static uint8_t kv_active = 0;	// bank holding the live records
+static uint32_t kv_seq = 0;
+static uint32_t kv_end = 0;		// first free byte of the active bank
+static bool kv_dirty = false;	// programmed bytes past kv_end, compact before appending
+
+// record being written
+static bool kv_open = false;
+static uint8_t kv_target = 0;
+static uint32_t kv_rec_addr = 0;
+static uint32_t kv_wr_addr = 0;
+static uint16_t kv_written = 0;
+static uint16_t kv_crc = 0;
+static kv_rec_hdr_t kv_rec;
+static uint8_t kv_tail[8] __attribute__((aligned(8)));
+static uint8_t kv_tail_len = 0;
+
+static uint8_t kv_list_buf[sizeof(uint32_t) + KV_MAX_KEYS * sizeof(kv_info_t)];
+
+_Static_assert(sizeof(kv_rec_hdr_t) == KV_REC_HDR_SIZE, "kv_rec_hdr_t must be one flash doubleword");
+
+static uint32_t bank_base(uint8_t bank)
+{
+	return KV_STORE_ADDRESS + bank * KV_STORE_BANK_SIZE;
+}
+
+static uint32_t rec_span(uint16_t len)
+{
+	return KV_REC_HDR_SIZE + ((len + 7U) & ~7U);
+}
+
+static bool bank_valid(uint8_t bank, uint32_t *seq)
+{
+	const uint32_t *h = (const uint32_t *)bank_base(bank);
+
+	if (h[0] != KV_BANK_MAGIC) {
+		return false;
+	}
+	*seq = h[1];
+	return true;
+}
+
+static int index_find(uint16_t key)
+{
+	for (int i = 0; i < kv_index_count; i++) {
+		if (kv_index[i].key == key) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void index_put(uint16_t key, uint32_t addr, bool deleted)
+{
+	int i = index_find(key);
+
+	if (deleted) {
+		if (i >= 0) {
+			kv_index[i] = kv_index[--kv_index_count];
+		}
+		return;
+	}
+	if (i < 0) {
+		if (kv_index_count >= KV_MAX_KEYS) {
+			return;
+		}
+		i = kv_index_count++;
+	}
+	kv_index[i].key = key;
+	kv_index[i].addr = addr;
+}
+
+static void kv_scan(void)
+{
+	uint32_t addr = bank_base(kv_active) + KV_BANK_HDR_SIZE;
+	uint32_t end = bank_base(kv_active) + KV_STORE_BANK_SIZE;
+
+	kv_index_count = 0;
+	kv_dirty = false;
+
+	while ((addr + KV_REC_HDR_SIZE) <= end) {
+		const kv_rec_hdr_t *h = (const kv_rec_hdr_t *)addr;
+		const uint8_t *data = (const uint8_t *)(addr + KV_REC_HDR_SIZE);
+
+		if (Flash_IsErased(addr, KV_REC_HDR_SIZE)) {
+			break;
+		}
+		if (h->len > KV_MAX_RECORD || (addr + rec_span(h->len)) > end) {
+			kv_dirty = true;
+			break;
+		}
+		if (util_crc16_update(util_crc16((const uint8_t *)h, offsetof(kv_rec_hdr_t, crc)), data, h->len) == h->crc) {
+			index_put(h->key, addr, (h->flags & KV_FLAG_DELETED) != 0);
+		}
+		addr += rec_span(h->len);
+	}
+	kv_end = addr;
+
+	// data of a record whose header never made it
+	if (!Flash_IsErased(kv_end, end - kv_end)) {
+		kv_dirty = true;
+	}
+}
+
+static HAL_StatusTypeDef kv_format(uint8_t bank, uint32_t seq)
+{
+	uint32_t hdr[2] = { KV_BANK_MAGIC, seq };
+	HAL_StatusTypeDef st = Flash_Erase(bank_base(bank), bank_base(bank) + KV_STORE_BANK_SIZE);
+
+	if (st != HAL_OK) {
+		return st;
+	}
+	return Flash_Write(bank_base(bank), hdr, sizeof(hdr));
+}
+
+static HAL_StatusTypeDef kv_ensure_loaded(void)
+{
+	uint32_t seq0 = 0;
+	uint32_t seq1 = 0;
+	bool valid0;
+	bool valid1;
+
+	if (kv_loaded) {
+		return HAL_OK;
+	}
+
+	valid0 = bank_valid(0, &seq0);
+	valid1 = bank_valid(1, &seq1);
+	if (valid0 && valid1) {
+		kv_active = ((int32_t)(seq1 - seq0) > 0) ? 1 : 0;
+	} else if (valid0 || valid1) {
+		kv_active = valid1 ? 1 : 0;
+	} else {
+		// first boot, start an empty store
+		if (kv_format(0, 1) != HAL_OK) {
+			return HAL_ERROR;
+		}
+		kv_active = 0;
+		seq0 = 1;
+	}
+	kv_seq = kv_active ? seq1 : seq0;
+
+	kv_scan();
+	kv_loaded = true;
+	return HAL_OK;
+}
+
+/* Copy every live record except skip_key into the other bank, leaving its
+ * header unwritten so the active bank stays authoritative until commit. */
+static HAL_StatusTypeDef kv_compact(uint16_t skip_key, uint32_t *next_addr)
+{
+	uint8_t other = kv_active ^ 1U;
+	uint32_t dst = bank_base(other) + KV_BANK_HDR_SIZE;
+	HAL_StatusTypeDef st;
+
+	st = Flash_Erase(bank_base(other), bank_base(other) + KV_STORE_BANK_SIZE);
+	if (st != HAL_OK) {
+		return st;
+	}
+	for (int i = 0; i < kv_index_count; i++) {
+		const kv_rec_hdr_t *h = (const kv_rec_hdr_t *)kv_index[i].addr;
+		if (h->key == skip_key) {
+			continue;
+		}
+		st = Flash_Write(dst, h, rec_span(h->len));
+		if (st != HAL_OK) {
+			return st;
+		}
+		dst += rec_span(h->len);
+	}
+	*next_addr = dst;
+	return HAL_OK;
+}
+
+static HAL_StatusTypeDef kv_open_record(uint16_t key, uint8_t version, uint16_t len, uint8_t flags)
+{
+	uint32_t bank_end;
+	HAL_StatusTypeDef st;
+
+	if (kv_ensure_loaded() != HAL_OK || key == KV_KEY_INVALID || len > KV_MAX_RECORD) {
+		return HAL_ERROR;
+	}
+	if (index_find(key) < 0 && kv_index_count >= KV_MAX_KEYS && !(flags & KV_FLAG_DELETED)) {
+		return HAL_ERROR;
+	}
+	kv_open = false;	// whatever was open is abandoned, its bytes are cleaned up by compaction
+
+	bank_end = bank_base(kv_active) + KV_STORE_BANK_SIZE;
+	if (!kv_dirty && (kv_end + rec_span(len)) <= bank_end) {
+		kv_target = kv_active;
+		kv_rec_addr = kv_end;
+		kv_dirty = true;	// until the header lands
+	} else {
+		st = kv_compact(key, &kv_rec_addr);
+		if (st != HAL_OK) {
+			return st;
+		}
+		kv_target = kv_active ^ 1U;
+		if ((kv_rec_addr + rec_span(len)) > (bank_base(kv_target) + KV_STORE_BANK_SIZE)) {
+			return HAL_ERROR;	// store full even without the old copy
+		}
+	}
+
+	kv_rec.key = key;
+	kv_rec.len = len;
+	kv_rec.version = version;
+	kv_rec.flags = flags;
+	kv_crc = util_crc16((const uint8_t *)&kv_rec, offsetof(kv_rec_hdr_t, crc));
+	kv_wr_addr = kv_rec_addr + KV_REC_HDR_SIZE;
+	kv_written = 0;
+	kv_tail_len = 0;
+	kv_open = true;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef kv_store_begin(uint16_t key, uint8_t version, uint16_t len)
+{
+	return kv_open_record(key, version, len, 0);
+}
+
+HAL_StatusTypeDef kv_store_append(const void *data, uint16_t len)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	HAL_StatusTypeDef st = HAL_OK;
+
+	if (!kv_open || (kv_written + len) > kv_rec.len) {
+		return HAL_ERROR;
+	}
+	kv_crc = util_crc16_update(kv_crc, p, len);
+	kv_written += len;
+
+	// flash takes doublewords, odd sized pieces go through kv_tail
+	while (len > 0 && st == HAL_OK) {
+		if (kv_tail_len > 0 || len < 8U) {
+			uint16_t n = (uint16_t)(8U - kv_tail_len) < len ? (uint16_t)(8U - kv_tail_len) : len;
+			memcpy(&kv_tail[kv_tail_len], p, n);
+			kv_tail_len += n;
+			p += n;
+			len -= n;
+			if (kv_tail_len == 8U) {
+				st = Flash_Write(kv_wr_addr, kv_tail, 8U);
+				kv_wr_addr += 8U;
+				kv_tail_len = 0;
+			}
+		} else {
+			uint16_t n = len & ~7U;
+			st = Flash_Write(kv_wr_addr, p, n);
+			kv_wr_addr += n;
+			p += n;
+			len -= n;
+		}
+	}
+	if (st != HAL_OK) {
+		kv_open = false;
+	}
+	return st;
+}
+
+HAL_StatusTypeDef kv_store_commit(void)
+{
+	uint32_t hdr[2] = { KV_BANK_MAGIC, kv_seq + 1U };
+	HAL_StatusTypeDef st;
+
+	if (!kv_open || kv_written != kv_rec.len) {
+		return HAL_ERROR;
+	}
+	kv_open = false;
+
+	if (kv_tail_len > 0) {
+		st = Flash_Write(kv_wr_addr, kv_tail, kv_tail_len);
+		if (st != HAL_OK) {
+			return st;
+		}
+	}
+	kv_rec.crc = kv_crc;
+	st = Flash_Write(kv_rec_addr, &kv_rec, sizeof(kv_rec));
+	if (st != HAL_OK) {
+		return st;
+	}
+
+	if (kv_target == kv_active) {
+		index_put(kv_rec.key, kv_rec_addr, (kv_rec.flags & KV_FLAG_DELETED) != 0);
+		kv_end = kv_rec_addr + rec_span(kv_rec.len);
+		kv_dirty = false;
+		return HAL_OK;
+	}
+
+	// compacted bank takes over once its header is in place
+	st = Flash_Write(bank_base(kv_target), hdr, sizeof(hdr));
+	if (st != HAL_OK) {
+		return st;
+	}
+	kv_active = kv_target;
+	kv_seq++;
+	kv_scan();
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef kv_store_set(uint16_t key, uint8_t version, const void *data, uint16_t len)
+{
+	HAL_StatusTypeDef st = kv_store_begin(key, version, len);
+
+	if (st == HAL_OK) {
+		st = kv_store_append(data, len);
+	}
+	if (st == HAL_OK) {
+		st = kv_store_commit();
+	}
+	return st;
+}
+
+HAL_StatusTypeDef kv_store_delete(uint16_t key)
+{
+	HAL_StatusTypeDef st;
+
+	if (kv_ensure_loaded() != HAL_OK) {
+		return HAL_ERROR;
+	}
+	if (index_find(key) < 0) {
+		return HAL_OK;
+	}
+	st = kv_open_record(key, 0, 0, KV_FLAG_DELETED);
+	if (st == HAL_OK) {
+		st = kv_store_commit();
+	}
+	return st;
+}
+
+const void *kv_store_ptr(uint16_t key, uint16_t *len, uint8_t *version)
+{
+	const kv_rec_hdr_t *h;
+	int i;
+
+	if (kv_ensure_loaded() != HAL_OK || (i = index_find(key)) < 0) {
+		return NULL;
+	}
+	h = (const kv_rec_hdr_t *)kv_index[i].addr;
+	if (len) *len = h->len;
+	if (version) *version = h->version;
+	return (const void *)(kv_index[i].addr + KV_REC_HDR_SIZE);
+}
+
+HAL_StatusTypeDef kv_store_get(uint16_t key, void *dst, uint16_t max_len, uint16_t *len, uint8_t *version)
+{
+	uint16_t rec_len = 0;
+	const void *src = kv_store_ptr(key, &rec_len, version);
+
+	if (src == NULL || rec_len > max_len) {
+		return HAL_ERROR;
+	}
+	memcpy(dst, src, rec_len);
+	if (len) *len = rec_len;
+	return HAL_OK;
+}
+
+uint16_t kv_store_list(kv_info_t *out, uint16_t max)
+{
+	uint16_t n = 0;
+
+	if (kv_ensure_loaded() != HAL_OK) {
+		return 0;
+	}
+	for (int i = 0; i < kv_index_count && n < max; i++, n++) {
+		const kv_rec_hdr_t *h = (const kv_rec_hdr_t *)kv_index[i].addr;
+		out[n].key = h->key;
+		out[n].len = h->len;
+		out[n].version = h->version;
+		out[n].reserved = 0;
+	}
+	return n;
+}
+
+// space left once the bank is compacted
+uint32_t kv_store_free(void)
+{
+	uint32_t used = KV_BANK_HDR_SIZE;
+
+	if (kv_ensure_loaded() != HAL_OK) {
+		return 0;
+	}
+	for (int i = 0; i < kv_index_count; i++) {
+		used += rec_span(((const kv_rec_hdr_t *)kv_index[i].addr)->len);
+	}
+	return KV_STORE_BANK_SIZE - used;
+}
+
+void kv_store_process(UartPacket *cmd, UartPacket *resp)
+{
+	bool ok = true;
+
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+	resp->data_len = 0;
+	resp->data = NULL;
+
+	switch (cmd->reserved)
+	{
+	case KV_OP_LIST:
+	{
+		uint32_t free_bytes = kv_store_free();
+		uint16_t count = kv_store_list((kv_info_t *)&kv_list_buf[sizeof(uint32_t)], KV_MAX_KEYS);
+		memcpy(kv_list_buf, &free_bytes, sizeof(free_bytes));
+		resp->data_len = sizeof(uint32_t) + count * sizeof(kv_info_t);
+		resp->data = kv_list_buf;
+		break;
+	}
+	case KV_OP_GET:
+	{
+		uint16_t len = 0;
+		uint16_t offset = 0;
+		const uint8_t *rec;
+
+		if (cmd->data_len != 2 && cmd->data_len != 4) {
+			ok = false;
+			break;
+		}
+		if (cmd->data_len == 4) {
+			offset = cmd->data[2] | (cmd->data[3] << 8);
+		}
+		rec = kv_store_ptr(cmd->data[0] | (cmd->data[1] << 8), &len, NULL);
+		if (rec == NULL || offset > len) {
+			ok = false;
+			break;
+		}
+		// straight from flash, records larger than a frame are read in pieces
+		resp->data_len = (len - offset) < DATA_MAX_SIZE ? (len - offset) : DATA_MAX_SIZE;
+		resp->data = (uint8_t *)&rec[offset];
+		break;
+	}
+	case KV_OP_WRITE:
+	{
+		uint16_t key;
+		uint16_t total;
+		uint16_t offset;
+
+		if (cmd->data_len < 8) {
+			ok = false;
+			break;
+		}
+		key = cmd->data[0] | (cmd->data[1] << 8);
+		total = cmd->data[4] | (cmd->data[5] << 8);
+		offset = cmd->data[6] | (cmd->data[7] << 8);
+		if (offset == 0) {
+			ok = kv_store_begin(key, cmd->data[2], total) == HAL_OK;
+		} else {
+			ok = kv_open && kv_rec.key == key && kv_written == offset;
+		}
+		if (ok) {
+			ok = kv_store_append(&cmd->data[8], cmd->data_len - 8) == HAL_OK;
+		}
+		if (ok && kv_written == total) {
+			ok = kv_store_commit() == HAL_OK;
+		}
+		break;
+	}
+	case KV_OP_DELETE:
+		if (cmd->data_len != 2) {
+			ok = false;
+			break;
+		}
+		ok = kv_store_delete(cmd->data[0] | (cmd->data[1] << 8)) == HAL_OK;
+		break;
+	default:
+		ok = false;
+		break;
+	}
+
+	if (!ok) {
+		resp->packet_type = OW_ERROR;
+		resp->data_len = 0;
+		resp->data = NULL;
+	}
+}
@@ -104,16 +104,8 @@ static HAL_StatusTypeDef lifu_cfg_writeback(void)
     lifu_cfg_normalize_json(&g_cfg);
     g_cfg.crc = lifu_cfg_calc_crc(&g_cfg);
 
-    // Erase page [ADDR_FLASH_PAGE_62 .. ADDR_FLASH_PAGE_63)
-    st = Flash_Erase(LIFU_CFG_PAGE_ADDR, LIFU_CFG_PAGE_END);
-    if (st != HAL_OK) {
-        return st;
-    }
-
-    // Program entire struct word-by-word
-    st = Flash_Write(LIFU_CFG_PAGE_ADDR,
-                     (uint32_t *)&g_cfg,
-                     (uint32_t)(sizeof(lifu_cfg_t) / sizeof(uint32_t)));
+    // Erase the page and program the entire struct
+    st = Flash_Commit(LIFU_CFG_PAGE_ADDR, &g_cfg, sizeof(lifu_cfg_t));
 
     return st;
 }
@@ -121,9 +113,7 @@ static HAL_StatusTypeDef lifu_cfg_writeback(void)
 // Raw load from flash into g_cfg
 static void lifu_cfg_load_raw(void)
 {
-    Flash_Read(LIFU_CFG_PAGE_ADDR,
-               (uint32_t *)&g_cfg,
-               (uint32_t)(sizeof(lifu_cfg_t) / sizeof(uint32_t)));
+    Flash_Read(LIFU_CFG_PAGE_ADDR, &g_cfg, sizeof(lifu_cfg_t));
 }
 
 // Ensure g_cfg is initialized and valid
@@ -0,0 +1,432 @@
+/*
+ * link_monitor.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Keeps the slave chain alive without a full reconfiguration.  The master
+ *  checks every slave's I2C address once a second and compares HWIDs in the
+ *  background.  A slave that stopped answering (it rebooted and lost its
+ *  address) is re-discovered at its own chain position and gets its TX7332
+ *  registers back from the journal of writes the master relayed to it.
+ *
+ *  While the host is quiet each slave is sent a short echo in turn.  Its
+ *  turnaround and every relay's feed a smoothed estimate per slave that sets
+ *  when the relay layer starts polling for a reply and how long it waits.
+ */
+
+#include "link_monitor.h"
+#include "module_manager.h"
+#include "if_commands.h"
+#include "uart_comms.h"
+#include "i2c_protocol.h"
+#include "i2c_master.h"
+
+#include <string.h>
+
+#define LINK_BITMAP_WORDS	((LINK_JOURNAL_REGS + 31) / 32)
+#define LINK_REPLAY_BLOCK	REG_DATA_LEN
+
+// register values live in the otherwise unused RAM2, only read where the bitmap says written
+static uint32_t journal_values[LINK_JOURNAL_SLAVES][TX_PER_MODULE][LINK_JOURNAL_REGS] __attribute__((section(".ram2")));
+static uint32_t journal_written[LINK_JOURNAL_SLAVES][TX_PER_MODULE][LINK_BITMAP_WORDS];
+
+static link_module_status_t link_status[MAX_MODULES];
+static bool hwid_valid[MAX_MODULES];
+static bool link_enabled = true;
+static uint32_t last_check_tick = 0;
+static uint32_t last_hwid_tick = 0;
+static uint8_t hwid_next = 1;
+static uint8_t replay_buff[4 + LINK_REPLAY_BLOCK * 4];
+
+static bool rtt_valid[MAX_MODULES];
+static uint32_t error_acc[MAX_MODULES];	// error_rate x 16
+static uint32_t last_probe_tick = 0;
+static uint8_t probe_next = 1;
+static uint16_t probe_seq = 0;
+static uint8_t probe_data[LINK_PROBE_LEN];
+static uint8_t probe_tx[HEADER_SIZE + LINK_PROBE_LEN];
+static uint32_t retry_tick[MAX_MODULES];
+static uint32_t retry_ms[MAX_MODULES];	// wait before the next recovery of an offline slave, 0 none
+
+extern uint8_t receive_buffer[];
+
+uint32_t link_elapsed_us(uint32_t since_cycles)
+{
+	return (DWT->CYCCNT - since_cycles) / (SystemCoreClock / 1000000U);
+}
+
+void link_rtt_sample(uint8_t module_id, uint32_t rtt_us, bool ok)
+{
+	link_module_status_t *st;
+
+	if (module_id == 0 || module_id >= MAX_MODULES) {
+		return;
+	}
+	st = &link_status[module_id];
+	st->samples++;
+	error_acc[module_id] -= error_acc[module_id] / 16;
+	if (!ok) {
+		st->errors++;
+		error_acc[module_id] += 1000;
+		st->error_rate = error_acc[module_id] / 16;
+		return;
+	}
+	st->error_rate = error_acc[module_id] / 16;
+
+	if (!rtt_valid[module_id]) {
+		st->srtt_us = rtt_us;
+		st->rttvar_us = rtt_us / 2;
+		st->baseline_us = rtt_us;
+		st->rtt_min_us = rtt_us;
+		st->rtt_max_us = rtt_us;
+		rtt_valid[module_id] = true;
+		return;
+	}
+	int32_t err = (int32_t)rtt_us - (int32_t)st->srtt_us;
+	st->srtt_us += err / 8;
+	st->rttvar_us += ((err < 0 ? -err : err) - (int32_t)st->rttvar_us) / 4;
+	st->baseline_us += ((int32_t)st->srtt_us - (int32_t)st->baseline_us) / 64;
+	if (rtt_us < st->rtt_min_us) st->rtt_min_us = rtt_us;
+	if (rtt_us > st->rtt_max_us) st->rtt_max_us = rtt_us;
+}
+
+/* Earliest a reply is worth polling for.  Never later than the fastest
+ * turnaround seen, a cheap command can come back that quickly. */
+uint32_t link_relay_first_poll_us(uint8_t module_id)
+{
+	const link_module_status_t *st = &link_status[module_id];
+	uint32_t first;
+
+	if (module_id >= MAX_MODULES || !rtt_valid[module_id]) {
+		return 0;
+	}
+	first = (st->srtt_us > 2 * st->rttvar_us) ? st->srtt_us - 2 * st->rttvar_us : 0;
+	return (first < st->rtt_min_us) ? first : st->rtt_min_us;
+}
+
+uint32_t link_relay_timeout_us(uint8_t module_id)
+{
+	const link_module_status_t *st = &link_status[module_id];
+	uint32_t limit;
+
+	if (module_id >= MAX_MODULES || !rtt_valid[module_id]) {
+		return LINK_RELAY_MIN_US;
+	}
+	limit = st->srtt_us + 4 * st->rttvar_us;
+	if (limit < LINK_RELAY_MIN_US) return LINK_RELAY_MIN_US;
+	if (limit > LINK_RELAY_MAX_US) return LINK_RELAY_MAX_US;
+	return limit;
+}
+
+/* Echo a short pattern off one slave over the global bus and time it from
+ * the end of the write to the first read that isn't busy. */
+static void link_probe(uint8_t module_id)
+{
+	ModuleInfo *mod = ModuleManager_GetModule(module_id);
+	I2C_TX_Packet pkt;
+	I2C_TX_Packet reply;
+	uint32_t sent;
+	uint32_t rtt_us = 0;
+	bool ok = false;
+
+	if (mod == NULL) {
+		return;
+	}
+
+	probe_seq++;
+	for (int i = 0; i < LINK_PROBE_LEN; i++) {
+		probe_data[i] = (uint8_t)((probe_seq >> ((i & 1) * 8)) ^ (0x5A + i * 0x11));
+	}
+	pkt.id = probe_seq;
+	pkt.cmd = OW_CMD_ECHO;
+	pkt.tx_id = 0;
+	pkt.reserved = 0;
+	pkt.data_len = LINK_PROBE_LEN;
+	pkt.pData = probe_data;
+	i2c_packet_toBuffer(&pkt, probe_tx);
+
+	if (send_buffer_to_slave_global(mod->i2c_address, probe_tx, sizeof(probe_tx)) != 0) {
+		link_rtt_sample(module_id, 0, false);
+		return;
+	}
+	sent = DWT->CYCCNT;
+	do {
+		memset(receive_buffer, 0, HEADER_SIZE);
+		if (read_buffer_of_slave_global(mod->i2c_address, receive_buffer, I2C_BUFFER_SIZE) == 0 ||
+			!i2c_packet_fromBuffer(receive_buffer, &reply)) {
+			break;
+		}
+		rtt_us = link_elapsed_us(sent);
+		if (reply.reserved != I2C_SLAVE_BUSY) {
+			ok = reply.reserved == OW_RESP && reply.id == probe_seq && reply.cmd == OW_CMD_ECHO &&
+				 reply.data_len == LINK_PROBE_LEN && memcmp(reply.pData, probe_data, LINK_PROBE_LEN) == 0;
+			break;
+		}
+		uint32_t t0 = DWT->CYCCNT;
+		while (link_elapsed_us(t0) < LINK_POLL_US) { }
+	} while (rtt_us < LINK_RELAY_MAX_US);
+
+	link_rtt_sample(module_id, rtt_us, ok);
+}
+
+static bool journal_slot(uint8_t module_id, uint8_t local_tx)
+{
+	return module_id >= 1 && module_id <= LINK_JOURNAL_SLAVES && local_tx < TX_PER_MODULE;
+}
+
+static uint16_t journal_count(uint8_t module_id)
+{
+	uint16_t count = 0;
+
+	if (!journal_slot(module_id, 0)) {
+		return 0xFFFF;
+	}
+	for (int tx = 0; tx < TX_PER_MODULE; tx++) {
+		for (int w = 0; w < LINK_BITMAP_WORDS; w++) {
+			count += __builtin_popcount(journal_written[module_id - 1][tx][w]);
+		}
+	}
+	return count;
+}
+
+void link_journal_write(uint8_t module_id, uint8_t local_tx, uint16_t reg, const uint8_t *le_values, uint16_t count)
+{
+	if (!journal_slot(module_id, local_tx)) {
+		return;
+	}
+	uint32_t *values = journal_values[module_id - 1][local_tx];
+	uint32_t *written = journal_written[module_id - 1][local_tx];
+
+	for (uint16_t i = 0; i < count && reg + i < LINK_JOURNAL_REGS; i++) {
+		const uint8_t *v = &le_values[i * 4];
+		values[reg + i] = v[0] | (v[1] << 8) | (v[2] << 16) | ((uint32_t)v[3] << 24);
+		written[(reg + i) / 32] |= 1U << ((reg + i) % 32);
+	}
+}
+
+static bool journal_replay(uint8_t module_id)
+{
+	UartPacket cmd;
+	UartPacket resp;
+
+	if (!journal_slot(module_id, 0)) {
+		return true;	// nothing kept for this position, host has to restore it
+	}
+
+	for (uint8_t tx = 0; tx < TX_PER_MODULE; tx++) {
+		uint32_t *values = journal_values[module_id - 1][tx];
+		uint32_t *written = journal_written[module_id - 1][tx];
+		uint16_t reg = 0;
+
+		while (reg < LINK_JOURNAL_REGS) {
+			if (!(written[reg / 32] & (1U << (reg % 32)))) {
+				reg++;
+				continue;
+			}
+			// contiguous run of written registers, one WBLOCK each
+			uint16_t count = 0;
+			while (reg + count < LINK_JOURNAL_REGS && count < LINK_REPLAY_BLOCK &&
+				   (written[(reg + count) / 32] & (1U << ((reg + count) % 32)))) {
+				memcpy(&replay_buff[4 + count * 4], &values[reg + count], 4);
+				count++;
+			}
+			replay_buff[0] = reg & 0xFF;
+			replay_buff[1] = reg >> 8;
+			replay_buff[2] = (uint8_t)count;
+			replay_buff[3] = 0;
+
+			memset(&cmd, 0, sizeof(cmd));
+			cmd.packet_type = OW_TX7332;
+			cmd.command = OW_TX7332_WBLOCK;
+			cmd.addr = module_id * TX_PER_MODULE + tx;
+			cmd.data_len = 4 + count * 4;
+			cmd.data = replay_buff;
+			process_if_command(&cmd, &resp);
+			if (resp.packet_type != OW_RESP) {
+				return false;
+			}
+			reg += count;
+		}
+	}
+	return true;
+}
+
+static bool read_hwid(uint8_t module_id, uint32_t hwid[3])
+{
+	UartPacket cmd;
+	UartPacket resp;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.packet_type = OW_CONTROLLER;
+	cmd.command = OW_CMD_HWID;
+	cmd.addr = module_id;
+	process_if_command(&cmd, &resp);
+	if (resp.packet_type != OW_RESP || resp.data_len != HW_ID_DATA_LENGTH || resp.data == NULL) {
+		return false;
+	}
+	memcpy(hwid, resp.data, HW_ID_DATA_LENGTH);
+	return true;
+}
+
+static bool slave_present(uint8_t module_id, uint32_t timeout_ms)
+{
+	ModuleInfo *mod = ModuleManager_GetModule(module_id);
+	uint32_t t0 = HAL_GetTick();
+
+	if (mod == NULL) {
+		return false;
+	}
+	do {
+		if (HAL_I2C_IsDeviceReady(GLOBAL_I2C_DEVICE, mod->i2c_address << 1, 1, 2) == HAL_OK) {
+			return true;
+		}
+	} while ((HAL_GetTick() - t0) < timeout_ms);
+	return false;
+}
+
+void link_monitor_init(void)
+{
+	memset(link_status, 0, sizeof(link_status));
+	memset(hwid_valid, 0, sizeof(hwid_valid));
+	memset(journal_written, 0, sizeof(journal_written));
+	memset(rtt_valid, 0, sizeof(rtt_valid));
+	memset(error_acc, 0, sizeof(error_acc));
+	memset(retry_ms, 0, sizeof(retry_ms));
+	for (int i = 0; i < MAX_MODULES; i++) {
+		link_status[i].journal_regs = journal_count(i);
+	}
+	last_check_tick = HAL_GetTick();
+	last_hwid_tick = last_check_tick;
+	last_probe_tick = last_check_tick;
+	hwid_next = 1;
+	probe_next = 1;
+}
+
+bool link_monitor_recover(uint8_t module_id)
+{
+	link_module_status_t *st = &link_status[module_id];
+	ModuleInfo *mod = ModuleManager_GetModule(module_id);
+	uint32_t hwid[3];
+	uint8_t reply;
+
+	if (module_id == 0 || mod == NULL) {
+		return false;
+	}
+
+	st->state = LINK_MISSING;
+	reply = comms_onewire_discover(module_id, mod->i2c_address);
+	if (reply == OW_ERROR || reply == OW_TIMEOUT || !slave_present(module_id, LINK_READY_TIMEOUT_MS)) {
+		st->state = LINK_OFFLINE;
+		return false;
+	}
+
+	if (read_hwid(module_id, hwid)) {
+		if (hwid_valid[module_id] && memcmp(hwid, st->hwid, sizeof(hwid)) != 0) {
+			st->hwid_changes++;
+		}
+		memcpy(st->hwid, hwid, sizeof(hwid));
+		hwid_valid[module_id] = true;
+	}
+
+	if (!journal_replay(module_id)) {
+		st->state = LINK_OFFLINE;
+		return false;
+	}
+
+	st->state = LINK_OK;
+	st->misses = 0;
+	st->recoveries++;
+	retry_ms[module_id] = 0;
+	return true;
+}
+
+static void check_hwid(uint8_t module_id)
+{
+	link_module_status_t *st = &link_status[module_id];
+	uint32_t hwid[3];
+
+	if (st->state != LINK_OK || !read_hwid(module_id, hwid)) {
+		return;
+	}
+	if (hwid_valid[module_id] && memcmp(hwid, st->hwid, sizeof(hwid)) != 0) {
+		// different board answering at this position, it only has what it booted with
+		st->hwid_changes++;
+		memcpy(st->hwid, hwid, sizeof(hwid));
+		if (!journal_replay(module_id)) {
+			st->state = LINK_OFFLINE;
+		}
+		return;
+	}
+	memcpy(st->hwid, hwid, sizeof(hwid));
+	hwid_valid[module_id] = true;
+}
+
+void link_monitor_process(void)
+{
+	uint32_t now = HAL_GetTick();
+	uint8_t count = get_module_count();
+
+	if (!link_enabled || get_device_role() != ROLE_MASTER || !get_configured() || count < 2) {
+		return;
+	}
+
+	if ((now - last_check_tick) >= LINK_CHECK_INTERVAL_MS) {
+		last_check_tick = now;
+		for (uint8_t id = 1; id < count; id++) {
+			link_module_status_t *st = &link_status[id];
+			if (st->state == LINK_OK && slave_present(id, 0)) {
+				st->misses = 0;
+				continue;
+			}
+			if (st->misses < 0xFF) st->misses++;
+			if (st->misses >= LINK_MISS_LIMIT || st->state != LINK_OK) {
+				// downstream positions are reached through this one, so stop here this round.
+				// A recovery blocks for up to a second, an offline slave is retried less and less often.
+				if (st->state == LINK_OFFLINE && (now - retry_tick[id]) < retry_ms[id]) {
+					break;
+				}
+				if (!link_monitor_recover(id)) {
+					retry_tick[id] = HAL_GetTick();
+					retry_ms[id] = retry_ms[id] ? retry_ms[id] * 2 : 2 * LINK_CHECK_INTERVAL_MS;
+					if (retry_ms[id] > LINK_RETRY_MAX_MS) retry_ms[id] = LINK_RETRY_MAX_MS;
+				}
+				break;
+			}
+		}
+	}
+
+	if ((now - last_hwid_tick) >= LINK_HWID_INTERVAL_MS) {
+		last_hwid_tick = now;
+		if (hwid_next >= count) hwid_next = 1;
+		check_hwid(hwid_next++);
+	}
+
+	// background self-test, only in the gaps the host leaves
+	if (comms_host_idle_ms() >= LINK_PROBE_IDLE_MS && (now - last_probe_tick) >= LINK_PROBE_INTERVAL_MS) {
+		last_probe_tick = now;
+		if (probe_next >= count) probe_next = 1;
+		if (link_status[probe_next].state == LINK_OK) {
+			link_probe(probe_next);
+		}
+		probe_next++;
+	}
+}
+
+void link_monitor_enable(bool enable)
+{
+	link_enabled = enable;
+}
+
+bool link_monitor_enabled(void)
+{
+	return link_enabled;
+}
+
+const link_module_status_t *link_monitor_status(uint8_t *count)
+{
+	*count = get_module_count();
+	for (int i = 0; i < *count; i++) {
+		link_status[i].journal_regs = journal_count(i);
+	}
+	return link_status;
+}
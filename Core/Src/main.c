@@ -33,6 +33,12 @@
 #include "trigger.h"
 #include "i2c_slave.h"
 #include "thermistor.h"
+#include "tx_power.h"
+#include "link_monitor.h"
+#include "tx_cal.h"
+#include "tx_tcomp.h"
+#include "cmd_macro.h"
+#include "interlock.h"
 
 #ifdef DEBUG_ENABLED
 #include "logging.h"
@@ -58,6 +64,8 @@
 
 #define BL_BKP_SIGNATURE (0x4F57424CU)     /* 'OWBL' */
 #define BL_BKP_REQ_DFU_MAGIC (0x21554644U) /* 'DFU!' */
+#define BL_BKP_REQ_INSTALL_MAGIC (0x54534E49U) /* 'INST' */
+#define BL_BKP_REQ_TRIAL_MAGIC (0x4C525454U) /* 'TTRL' */
 
 /* STM32L4 system-memory (ROM) bootloader entry point */
 #define STM32_SYS_BL_ADDR   (0x1FFF0000U)
@@ -102,6 +110,29 @@ void bootloader_mark_boot_ok(void)
   __ISB();
 }
 
+/* Ask the bootloader to install the staged image on the next reset */
+void bootloader_request_install(void)
+{
+  bl_bkp_enable();
+  RTC->BKP0R = BL_BKP_SIGNATURE;
+  RTC->BKP1R = BL_BKP_REQ_INSTALL_MAGIC;
+  __DSB();
+  __ISB();
+}
+
+/* Ask the bootloader to boot the A/B slot at slot_base once on trial.  If
+ * that image does not reach bootloader_mark_boot_ok the failure count runs
+ * out and the bootloader falls back to the other slot. */
+void bootloader_request_trial(uint32_t slot_base)
+{
+  bl_bkp_enable();
+  RTC->BKP0R = BL_BKP_SIGNATURE;
+  RTC->BKP4R = slot_base;
+  RTC->BKP1R = BL_BKP_REQ_TRIAL_MAGIC;
+  __DSB();
+  __ISB();
+}
+
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -418,6 +449,7 @@ int main(void)
 
   uint32_t last_led_toggle_time = HAL_GetTick(); // Store the initial time
   uint32_t last_temp_toggle_time = HAL_GetTick();
+  uint32_t last_ambient_time = HAL_GetTick();
   uint32_t current_time = 0;
 
   /* USER CODE END 1 */
@@ -468,7 +500,6 @@ int main(void)
 #ifdef DEBUG_ENABLED
   init_dma_logging();
 #endif
-  bootloader_mark_boot_ok();
   printf("\033c");
   printf("LIFU Transmitter Firmware\r\n");
   printf("VER: %s (%s)\r\n", FW_VERSION_STRING, FW_SHA_STRING);
@@ -496,6 +527,10 @@ int main(void)
   // I2C_scan();
   Detect_MAX31875_Bus();
   FW_DEBUG("MAX31875 bus detected\r\n");
+  if (!MAX31875_Init())
+  {
+    FW_DEBUG("MAX31875 config failed\r\n");
+  }
   HAL_Delay(5);
 
   // Initializing TX7332
@@ -519,6 +554,8 @@ int main(void)
   // configure CS for TX7332
   TX7332_Init(&transmitters[0], TX1_CS_GPIO_Port, TX1_CS_Pin);
   TX7332_Init(&transmitters[1], TX2_CS_GPIO_Port, TX2_CS_Pin);
+  tx_cal_init();
+  tx_tcomp_init();
   FW_DEBUG("TX7332 initialized (2 tx chips)\r\n");
   HAL_Delay(50);
 
@@ -532,6 +569,8 @@ int main(void)
   HAL_GPIO_WritePin(TR7_EN_GPIO_Port, TR7_EN_Pin, GPIO_PIN_SET);
   HAL_GPIO_WritePin(TR8_EN_GPIO_Port, TR8_EN_Pin, GPIO_PIN_SET);
   HAL_Delay(50);
+  tx_power_init();
+  cmd_macro_init();
   MX_USB_DEVICE_Init();
 
   HAL_Delay(500);
@@ -539,6 +578,9 @@ int main(void)
   // system entering ready state
   HAL_GPIO_WritePin(SYSTEM_RDY_GPIO_Port, SYSTEM_RDY_Pin, GPIO_PIN_RESET);
 
+  // only a fully initialized image confirms a trial boot
+  bootloader_mark_boot_ok();
+
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -559,6 +601,7 @@ int main(void)
         OW_TimerData timerDataConfig;
 
         ConfigureResetPin(true);
+        interlock_init(true);
         configure_master();
 
         timerDataConfig.TriggerFrequencyHz = 10;
@@ -586,6 +629,7 @@ int main(void)
         FW_DEBUG("Role: SLAVE — starting configuration\r\n");
         ConfigureHIzPin(TRIGGER_GPIO_Port, TRIGGER_Pin);
         ConfigureResetPin(false);
+        interlock_init(false);
         configure_slave();
         SetSlaveReadyState(true);
         FW_DEBUG("Slave ready state set\r\n");
@@ -600,6 +644,7 @@ int main(void)
         enumerate_slaves();
         FW_DEBUG("Slaves enumerated\r\n");
         set_configured(true);
+        link_monitor_init();
         HAL_Delay(1);
         I2C_scan_global();
         FW_DEBUG("Starting host comms\r\n");
@@ -631,12 +676,17 @@ int main(void)
       if (get_device_role() == ROLE_MASTER)
       {
         comms_host_check_received(); // check comms
+        comms_host_tx_poll();
+        link_monitor_process();
       }
       else
       {
         comms_onewire_check_received();
         I2C_Process();
       }
+      tx_power_process();
+      tx_tcomp_run();
+      cmd_macro_run_pending();
     }
 
     if ((current_time - last_led_toggle_time) >= TOGGLE_INTERVAL)
@@ -648,9 +698,15 @@ int main(void)
     if ((current_time - last_temp_toggle_time) >= TEMPERATURE_INTERVAL)
     {
       tx_temperature = Thermistor_ReadTemperature();
-      ambient_temperature = MAX31875_ReadTemperature();
       last_temp_toggle_time = current_time; // Update the last toggle time
     }
+
+    MAX31875_Process();
+    if ((current_time - last_ambient_time) >= MAX31875_SAMPLE_MS)
+    {
+      MAX31875_StartRead();
+      last_ambient_time = current_time;
+    }
   }
   /* USER CODE END 3 */
 }
@@ -1586,6 +1642,14 @@ void delay_ms(uint32_t ms)
   }
 }
 
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  if (GPIO_Pin == GPIO_1_Pin)
+  {
+    cmd_macro_event(CMD_MACRO_EVT_EXT);
+  }
+}
+
 void HAL_LPTIM_AutoReloadMatchCallback(LPTIM_HandleTypeDef *hlptim)
 {
 
@@ -0,0 +1,162 @@
+/*
+ * pc_sampler.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Statistical profiler.  LPTIM2, set up at boot but otherwise unused,
+ *  interrupts at the requested rate and the PC stacked on exception entry
+ *  is counted in a histogram over the code image.  tools/pc_profile.py
+ *  reads the bins back and maps them to functions through the ELF.
+ *
+ *  The sample interrupt runs at priority 0 like most peripheral handlers,
+ *  so it cannot preempt those: time spent in them is charged to the code
+ *  they interrupted.  The priority 3 timer handlers are sampled normally.
+ */
+
+#include "pc_sampler.h"
+
+#include <string.h>
+
+extern LPTIM_HandleTypeDef hlptim2;
+extern uint32_t _etext;
+
+static uint16_t pc_bins[PC_SAMPLE_BINS];
+static pc_sample_status_t pc_status;
+
+void pc_sampler_isr(const uint32_t *frame)
+{
+	uint32_t pc = frame[6];
+	uint32_t bin;
+
+	hlptim2.Instance->ICR = LPTIM_FLAG_ARRM | LPTIM_FLAG_ARROK;
+
+	pc_status.samples++;
+	if ((frame[7] & 0x1FF) != 0) {
+		pc_status.in_handler++;
+	}
+	bin = (pc - pc_status.base) >> pc_status.shift;
+	if (pc < pc_status.base || bin >= PC_SAMPLE_BINS) {
+		pc_status.outside++;
+		return;
+	}
+	if (pc_bins[bin] != 0xFFFF) {
+		pc_bins[bin]++;
+	}
+}
+
+// hand the exception frame of whatever was interrupted to pc_sampler_isr
+__attribute__((naked)) void LPTIM2_IRQHandler(void)
+{
+	__asm volatile(
+		"tst lr, #4\n"
+		"ite eq\n"
+		"mrseq r0, msp\n"
+		"mrsne r0, psp\n"
+		"b pc_sampler_isr\n");
+}
+
+static void pc_sampler_stop(void)
+{
+	HAL_NVIC_DisableIRQ(LPTIM2_IRQn);
+	HAL_LPTIM_Counter_Stop_IT(&hlptim2);
+	pc_status.running = 0;
+}
+
+static bool pc_sampler_start(const pc_sample_start_t *req)
+{
+	uint32_t clk = HAL_RCC_GetPCLK1Freq();
+	uint32_t rate = (req->rate_hz != 0) ? req->rate_hz : PC_SAMPLE_RATE_HZ;
+	uint32_t base = (req->base != 0) ? req->base : SCB->VTOR;
+	uint32_t shift = req->shift;
+	uint32_t presc = 0;
+	uint32_t period;
+
+	if (rate > PC_SAMPLE_RATE_MAX_HZ) {
+		return false;
+	}
+	if (req->base == 0 && req->shift == 0) {
+		// smallest bins that still cover the whole image
+		while (((uint32_t)&_etext - base) >> shift >= PC_SAMPLE_BINS) {
+			shift++;
+		}
+	}
+	if (shift > 16) {
+		return false;
+	}
+
+	// 16 bit period, prescaler 1..128 in powers of two
+	while ((clk >> presc) / rate > 0x10000 && presc < 7) {
+		presc++;
+	}
+	period = (clk >> presc) / rate;
+	if (period < 2 || period > 0x10000) {
+		return false;
+	}
+
+	pc_sampler_stop();
+	memset(pc_bins, 0, sizeof(pc_bins));
+	pc_status.shift = (uint8_t)shift;
+	pc_status.bins = PC_SAMPLE_BINS;
+	pc_status.base = base;
+	pc_status.rate_hz = (clk >> presc) / period;
+	pc_status.samples = 0;
+	pc_status.outside = 0;
+	pc_status.in_handler = 0;
+
+	hlptim2.Init.Clock.Prescaler = presc << LPTIM_CFGR_PRESC_Pos;
+	if (HAL_LPTIM_Init(&hlptim2) != HAL_OK ||
+		HAL_LPTIM_Counter_Start_IT(&hlptim2, period - 1) != HAL_OK) {
+		return false;
+	}
+	HAL_NVIC_SetPriority(LPTIM2_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(LPTIM2_IRQn);
+	pc_status.running = 1;
+	return true;
+}
+
+void pc_sampler_process(UartPacket *cmd, UartPacket *resp)
+{
+	pc_sample_start_t req;
+	uint16_t first;
+
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+	resp->data_len = sizeof(pc_status);
+	resp->data = (uint8_t *)&pc_status;
+
+	switch (cmd->reserved)
+	{
+	case PC_SAMPLE_OP_STATUS:
+		break;
+	case PC_SAMPLE_OP_START:
+		memset(&req, 0, sizeof(req));
+		if (cmd->data_len > sizeof(req)) {
+			resp->packet_type = OW_ERROR;
+			break;
+		}
+		memcpy(&req, cmd->data, cmd->data_len);
+		if (!pc_sampler_start(&req)) {
+			pc_sampler_stop();
+			resp->packet_type = OW_ERROR;
+		}
+		break;
+	case PC_SAMPLE_OP_STOP:
+		pc_sampler_stop();
+		break;
+	case PC_SAMPLE_OP_DUMP:
+		if (cmd->data_len != 2 || (first = cmd->data[0] | (cmd->data[1] << 8)) >= PC_SAMPLE_BINS) {
+			resp->packet_type = OW_ERROR;
+			break;
+		}
+		resp->data_len = (PC_SAMPLE_BINS - first) * sizeof(pc_bins[0]);
+		if (resp->data_len > DATA_MAX_SIZE) {
+			resp->data_len = DATA_MAX_SIZE;
+		}
+		resp->data = (uint8_t *)&pc_bins[first];
+		break;
+	default:
+		resp->packet_type = OW_ERROR;
+		break;
+	}
+}
@@ -0,0 +1,287 @@
+/*
+ * profile_cache.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Content addressed cache of register blocks.  Every block write that
+ *  passes through a module is kept in RAM under the hash of its data, so
+ *  a host switching between a few delay or pattern profiles can send the
+ *  four byte hash instead of the payload, through USB and the I2C relay.
+ *  The master also keeps the blocks it relays, which is what lets it
+ *  journal an apply done on a slave.  Blocks the host pins are copied to
+ *  the kv_store and stay known across resets.
+ */
+
+#include "profile_cache.h"
+#include "kv_store.h"
+#include "utils.h"
+
+#include <string.h>
+
+typedef struct {
+	bool valid;
+	uint8_t count;
+	uint16_t reg;
+	uint32_t hash;
+	uint32_t last_use;
+	uint32_t words[PROFILE_CACHE_MAX_WORDS];
+} pcache_entry_t;
+
+static pcache_entry_t pcache_entries[PROFILE_CACHE_ENTRIES];
+static uint32_t pcache_clock = 0;
+static profile_cache_status_t pcache_status;
+static profile_cache_result_t pcache_result;
+static uint8_t pcache_buf[(PROFILE_CACHE_ENTRIES + PROFILE_CACHE_PINNED) * sizeof(profile_cache_info_t)];
+
+static uint32_t get_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static pcache_entry_t *entry_find(uint32_t hash)
+{
+	for (int i = 0; i < PROFILE_CACHE_ENTRIES; i++) {
+		if (pcache_entries[i].valid && pcache_entries[i].hash == hash) {
+			return &pcache_entries[i];
+		}
+	}
+	return NULL;
+}
+
+// a free entry, else the least recently used one
+static pcache_entry_t *entry_victim(void)
+{
+	pcache_entry_t *lru = &pcache_entries[0];
+
+	for (int i = 0; i < PROFILE_CACHE_ENTRIES; i++) {
+		if (!pcache_entries[i].valid) {
+			return &pcache_entries[i];
+		}
+		if ((int32_t)(pcache_entries[i].last_use - lru->last_use) < 0) {
+			lru = &pcache_entries[i];
+		}
+	}
+	pcache_status.evictions++;
+	return lru;
+}
+
+static const profile_cache_hdr_t *pinned_get(int slot)
+{
+	const profile_cache_hdr_t *hdr;
+	uint16_t len = 0;
+	uint8_t version = 0;
+
+	hdr = kv_store_ptr(KV_KEY_PCACHE_BASE + slot, &len, &version);
+	if (hdr == NULL || version != PROFILE_CACHE_VERSION || len < sizeof(*hdr) ||
+		len != sizeof(*hdr) + (hdr->count * sizeof(uint32_t))) {
+		return NULL;
+	}
+	return hdr;
+}
+
+static int pinned_find(uint32_t hash)
+{
+	for (int slot = 0; slot < PROFILE_CACHE_PINNED; slot++) {
+		const profile_cache_hdr_t *hdr = pinned_get(slot);
+		if (hdr != NULL && hdr->hash == hash) {
+			return slot;
+		}
+	}
+	return -1;
+}
+
+void profile_cache_store(const UartPacket *cmd, const UartPacket *resp)
+{
+	pcache_entry_t *e;
+	uint32_t hash;
+	uint8_t count;
+
+	if (cmd->packet_type != OW_TX7332 || resp->packet_type != OW_RESP ||
+		(cmd->command != OW_TX7332_WBLOCK && cmd->command != OW_TX7332_VWBLOCK) || cmd->data_len < 4) {
+		return;
+	}
+	count = cmd->data[2];
+	if (count == 0 || cmd->data_len != (4 + (4 * count))) {
+		return;
+	}
+	if (count > PROFILE_CACHE_MAX_WORDS) {
+		pcache_status.too_large++;
+		return;
+	}
+
+	hash = fnv1a_32(cmd->data, cmd->data_len);
+	e = entry_find(hash);
+	if (e == NULL) {
+		e = entry_victim();
+	}
+	e->hash = hash;
+	e->reg = cmd->data[0] | (cmd->data[1] << 8);
+	e->count = count;
+	memcpy(e->words, &cmd->data[4], count * sizeof(uint32_t));
+	e->last_use = ++pcache_clock;
+	e->valid = true;
+	pcache_status.stores++;
+}
+
+bool profile_cache_find(uint32_t hash, uint16_t *reg, uint8_t *count, const uint32_t **words)
+{
+	pcache_entry_t *e = entry_find(hash);
+	int slot;
+
+	if (e != NULL) {
+		e->last_use = ++pcache_clock;
+		*reg = e->reg;
+		*count = e->count;
+		*words = e->words;
+		return true;
+	}
+	slot = pinned_find(hash);
+	if (slot >= 0) {
+		const profile_cache_hdr_t *hdr = pinned_get(slot);
+		*reg = hdr->reg;
+		*count = hdr->count;
+		*words = (const uint32_t *)(hdr + 1);
+		return true;
+	}
+	return false;
+}
+
+void profile_cache_apply(TX7332 *tx, const UartPacket *cmd, UartPacket *resp)
+{
+	uint32_t words[PROFILE_CACHE_MAX_WORDS];
+	const uint32_t *src;
+	uint16_t reg;
+	uint8_t count;
+	int n = cmd->data_len / 4;
+
+	pcache_result.status = OW_SUCCESS;
+	pcache_result.index = 0;
+	resp->data_len = sizeof(pcache_result);
+	resp->data = (uint8_t *)&pcache_result;
+
+	// all of them or none, a half applied focus is worse than the old one
+	for (int i = 0; i < n; i++) {
+		if (!profile_cache_find(get_le32(&cmd->data[i * 4]), &reg, &count, &src)) {
+			pcache_result.status = OW_CACHE_MISS;
+			pcache_result.index = (uint8_t)i;
+			pcache_status.misses++;
+			return;
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		profile_cache_find(get_le32(&cmd->data[i * 4]), &reg, &count, &src);
+		// the driver calibrates in place
+		memcpy(words, src, count * sizeof(uint32_t));
+		if (!TX7332_WriteBulk(tx, reg, words, count)) {
+			resp->packet_type = OW_ERROR;
+			return;
+		}
+	}
+	pcache_status.hits += n;
+}
+
+static bool pcache_pin(uint32_t hash)
+{
+	uint8_t rec[sizeof(profile_cache_hdr_t) + PROFILE_CACHE_MAX_WORDS * sizeof(uint32_t)];
+	profile_cache_hdr_t hdr;
+	pcache_entry_t *e;
+
+	if (pinned_find(hash) >= 0) {
+		return true;
+	}
+	e = entry_find(hash);
+	if (e == NULL) {
+		return false;
+	}
+	hdr.hash = e->hash;
+	hdr.reg = e->reg;
+	hdr.count = e->count;
+	hdr.reserved = 0;
+	memcpy(rec, &hdr, sizeof(hdr));
+	memcpy(&rec[sizeof(hdr)], e->words, e->count * sizeof(uint32_t));
+
+	for (int slot = 0; slot < PROFILE_CACHE_PINNED; slot++) {
+		if (pinned_get(slot) == NULL) {
+			return kv_store_set(KV_KEY_PCACHE_BASE + slot, PROFILE_CACHE_VERSION, rec,
+								sizeof(hdr) + (e->count * sizeof(uint32_t))) == HAL_OK;
+		}
+	}
+	return false;
+}
+
+static bool pcache_unpin(uint32_t hash)
+{
+	int slot = pinned_find(hash);
+	return slot >= 0 && kv_store_delete(KV_KEY_PCACHE_BASE + slot) == HAL_OK;
+}
+
+static uint16_t pcache_list(void)
+{
+	profile_cache_info_t info;
+	uint16_t len = 0;
+
+	for (int i = 0; i < PROFILE_CACHE_ENTRIES; i++) {
+		if (!pcache_entries[i].valid) continue;
+		info.hash = pcache_entries[i].hash;
+		info.reg = pcache_entries[i].reg;
+		info.count = pcache_entries[i].count;
+		info.pinned = 0;
+		memcpy(&pcache_buf[len], &info, sizeof(info));
+		len += sizeof(info);
+	}
+	for (int slot = 0; slot < PROFILE_CACHE_PINNED; slot++) {
+		const profile_cache_hdr_t *hdr = pinned_get(slot);
+		if (hdr == NULL) continue;
+		info.hash = hdr->hash;
+		info.reg = hdr->reg;
+		info.count = hdr->count;
+		info.pinned = 1;
+		memcpy(&pcache_buf[len], &info, sizeof(info));
+		len += sizeof(info);
+	}
+	return len;
+}
+
+void profile_cache_process(UartPacket *cmd, UartPacket *resp)
+{
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+
+	switch (cmd->reserved)
+	{
+	case PROFILE_CACHE_OP_STATUS:
+		break;
+	case PROFILE_CACHE_OP_LIST:
+		resp->data_len = pcache_list();
+		resp->data = pcache_buf;
+		return;
+	case PROFILE_CACHE_OP_PIN:
+		if (cmd->data_len != 4 || !pcache_pin(get_le32(cmd->data))) {
+			resp->packet_type = OW_ERROR;
+		}
+		break;
+	case PROFILE_CACHE_OP_UNPIN:
+		if (cmd->data_len != 4 || !pcache_unpin(get_le32(cmd->data))) {
+			resp->packet_type = OW_ERROR;
+		}
+		break;
+	case PROFILE_CACHE_OP_FLUSH:
+		memset(pcache_entries, 0, sizeof(pcache_entries));
+		break;
+	default:
+		resp->packet_type = OW_ERROR;
+		break;
+	}
+
+	pcache_status.entries = 0;
+	pcache_status.pinned = 0;
+	for (int i = 0; i < PROFILE_CACHE_ENTRIES; i++) {
+		pcache_status.entries += pcache_entries[i].valid ? 1 : 0;
+	}
+	for (int slot = 0; slot < PROFILE_CACHE_PINNED; slot++) {
+		pcache_status.pinned += pinned_get(slot) != NULL ? 1 : 0;
+	}
+	resp->data_len = sizeof(pcache_status);
+	resp->data = (uint8_t *)&pcache_status;
+}
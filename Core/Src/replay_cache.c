@@ -0,0 +1,141 @@
+/*
+ * replay_cache.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Remembers the last few successful register and config writes by
+ *  (packet id, type, command, addr, reserved, length, CRC) together with
+ *  their response.  A host that timed out and resends the exact same frame
+ *  gets the stored response back instead of the device redoing the SPI,
+ *  I2C relay or flash work.  Packet id 0 is never cached, hosts that don't
+ *  number their packets always execute.
+ */
+
+#include "replay_cache.h"
+
+#include <string.h>
+
+typedef struct {
+	bool valid;
+	uint16_t id;
+	uint8_t packet_type;
+	uint8_t command;
+	uint8_t addr;
+	uint8_t reserved;
+	uint16_t data_len;
+	uint16_t crc;
+
+	uint8_t resp_type;
+	uint8_t resp_addr;
+	uint8_t resp_reserved;
+	uint16_t resp_len;
+	uint8_t resp_data[REPLAY_CACHE_DATA_MAX];
+} replay_entry_t;
+
+static replay_entry_t replay_entries[REPLAY_CACHE_ENTRIES];
+static uint8_t replay_next = 0;
+static uint32_t replay_hits = 0;
+
+static bool replay_cacheable(const UartPacket *cmd)
+{
+	if (cmd->id == 0) {
+		return false;
+	}
+
+	switch (cmd->packet_type)
+	{
+	case OW_TX7332:
+		return cmd->command == OW_TX7332_WREG || cmd->command == OW_TX7332_WBLOCK ||
+			   cmd->command == OW_TX7332_VWREG || cmd->command == OW_TX7332_VWBLOCK ||
+			   cmd->command == OW_TX7332_SCATTER || cmd->command == OW_TX7332_PATTERN;
+	case OW_CMD:
+	case OW_CONTROLLER:
+		return cmd->command == OW_CMD_USR_CFG && cmd->reserved == 1;
+	default:
+		return false;
+	}
+}
+
+static bool replay_match(const replay_entry_t *e, const UartPacket *cmd)
+{
+	return e->valid && e->id == cmd->id && e->crc == cmd->crc &&
+		   e->packet_type == cmd->packet_type && e->command == cmd->command &&
+		   e->addr == cmd->addr && e->reserved == cmd->reserved &&
+		   e->data_len == cmd->data_len;
+}
+
+bool replay_cache_contains(const UartPacket *cmd)
+{
+	if (!replay_cacheable(cmd)) {
+		return false;
+	}
+	for (int i = 0; i < REPLAY_CACHE_ENTRIES; i++) {
+		if (replay_match(&replay_entries[i], cmd)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool replay_cache_lookup(const UartPacket *cmd, UartPacket *resp)
+{
+	if (!replay_cacheable(cmd)) {
+		return false;
+	}
+
+	for (int i = 0; i < REPLAY_CACHE_ENTRIES; i++) {
+		replay_entry_t *e = &replay_entries[i];
+		if (!replay_match(e, cmd)) {
+			continue;
+		}
+		resp->id = cmd->id;
+		resp->packet_type = e->resp_type;
+		resp->command = cmd->command;
+		resp->addr = e->resp_addr;
+		resp->reserved = e->resp_reserved;
+		resp->data_len = e->resp_len;
+		resp->data = e->resp_len ? e->resp_data : NULL;
+		replay_hits++;
+		return true;
+	}
+	return false;
+}
+
+void replay_cache_store(const UartPacket *cmd, const UartPacket *resp)
+{
+	if (!replay_cacheable(cmd) || resp->packet_type == OW_ERROR ||
+		resp->data_len > REPLAY_CACHE_DATA_MAX) {
+		return;
+	}
+
+	replay_entry_t *e = &replay_entries[replay_next];
+	replay_next = (replay_next + 1) % REPLAY_CACHE_ENTRIES;
+
+	e->id = cmd->id;
+	e->packet_type = cmd->packet_type;
+	e->command = cmd->command;
+	e->addr = cmd->addr;
+	e->reserved = cmd->reserved;
+	e->data_len = cmd->data_len;
+	e->crc = cmd->crc;
+
+	e->resp_type = resp->packet_type;
+	e->resp_addr = resp->addr;
+	e->resp_reserved = resp->reserved;
+	e->resp_len = resp->data_len;
+	if (resp->data_len && resp->data) {
+		memcpy(e->resp_data, resp->data, resp->data_len);
+	}
+	e->valid = true;
+}
+
+void replay_cache_clear(void)
+{
+	memset(replay_entries, 0, sizeof(replay_entries));
+	replay_next = 0;
+}
+
+uint32_t replay_cache_hits(void)
+{
+	return replay_hits;
+}
@@ -559,4 +559,12 @@ void USB_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles EXTI lines 10 to 15, GPIO_1 only.
+  */
+void EXTI15_10_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_1_Pin);
+}
+
 /* USER CODE END 1 */
@@ -138,8 +138,13 @@
 #else
 #define VECT_TAB_BASE_ADDRESS   FLASH_BASE      /*!< Vector Table base address field.
                                                      This value must be a multiple of 0x200. */
+#if defined(FW_SLOT_B)
+#define VECT_TAB_OFFSET         0x00026000U     /*!< Vector Table base offset field, second A/B slot.
+                                                     This value must be a multiple of 0x200. */
+#else
 #define VECT_TAB_OFFSET         0x00010000U     /*!< Vector Table base offset field.
                                                      This value must be a multiple of 0x200. */
+#endif /* FW_SLOT_B */
 #endif /* VECT_TAB_SRAM */
 #endif /* USER_VECT_TAB_ADDRESS */
 
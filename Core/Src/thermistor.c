@@ -6,12 +6,20 @@
  */
 #include "thermistor.h"
 #include "i2c_master.h"
-#include <math.h>
+#include "fx_math.h"
+
+#define THERM_ADC_FULL_SCALE	4095
+
+// Beta equation rearranged as T = B T0 / (B + T0 ln(R / R0)), B T0 in Q10 to fit
+static const q16_t therm_beta_q16 = FX_Q16(BETA);
+static const q16_t therm_t0_q16 = FX_Q16(T0);
+static const int32_t therm_bt0_q10 = (int32_t)(BETA * T0 * 1024.0 + 0.5);
+static const q16_t therm_kelvin_q16 = FX_Q16(273.15);
 
 // Private variables
 static ADC_HandleTypeDef *adcHandle = NULL;  // Pointer to the ADC handle
-static float referenceVoltage;        // ADC reference voltage
-static float pullUpResistance;        // Pull-up resistance value
+static q16_t lnPullUpRatio;           // ln(pull-up / R0)
+static thermistor_status_t thermStatus;
 
 volatile float tx_temperature = 0.0f;
 volatile float ambient_temperature = 0.0f;
@@ -20,8 +28,9 @@ volatile float ambient_temperature = 0.0f;
 void Thermistor_Start(ADC_HandleTypeDef *hadc, float vRef, float rPullUp)
 {
     adcHandle = hadc;
-    referenceVoltage = vRef;
-    pullUpResistance = rPullUp;
+    // the divider ratio doesn't depend on vRef, only the pull-up is kept
+    (void)vRef;
+    lnPullUpRatio = fx_ln_q16((q16_t)(rPullUp / (float)R0 * 65536.0f));
 
     __HAL_ADC_CLEAR_FLAG(adcHandle, ADC_FLAG_OVR | ADC_FLAG_EOC | ADC_FLAG_EOS);
 
@@ -43,8 +52,8 @@ void Thermistor_Stop()
     }
 }
 
-// Read thermistor resistance
-static float Thermistor_GetResistance(void)
+// Read the raw ADC code of the divider
+static bool Thermistor_GetCode(uint32_t *code)
 {
 
     // With AutoWait ENABLE, ADC won’t start the next conversion until DR is read.
@@ -55,27 +64,56 @@ static float Thermistor_GetResistance(void)
         return false;
     }
 
-    // Get ADC value
-    uint16_t adcValue = HAL_ADC_GetValue(adcHandle);
-
-    // Calculate voltage measured
-    float vADC = (referenceVoltage / 4095.0f) * adcValue;
-
-    // Calculate thermistor resistance
-    return pullUpResistance * (vADC/(referenceVoltage - vADC));
+    *code = HAL_ADC_GetValue(adcHandle);
+    return true;
 }
 
-// Read temperature in Celsius
-float Thermistor_ReadTemperature(void)
+// Read temperature in Celsius, Q16.16
+q16_t Thermistor_ReadTemperatureQ16(void)
 {
-    if(adcHandle)
+    uint32_t code;
+    uint32_t t0;
+    q16_t lnRatio;
+    q16_t den;
+    q16_t temp;
+
+    if(!adcHandle)
+    {
+        return 0;
+    }
+
+    // a failed conversion or a rail reading (open / shorted divider) reads as 0 K
+    if(!Thermistor_GetCode(&code) || code == 0 || code >= THERM_ADC_FULL_SCALE)
+    {
+        return -therm_kelvin_q16;
+    }
+
+    t0 = DWT->CYCCNT;
+
+    // R / R0 = (pull-up / R0) * code / (full scale - code), taken apart in logs
+    lnRatio = lnPullUpRatio + fx_ln_q16(FX_Q16_INT(code)) - fx_ln_q16(FX_Q16_INT(THERM_ADC_FULL_SCALE - code));
+    den = therm_beta_q16 + fx_mul_q16(therm_t0_q16, lnRatio);
+    if(den <= 0)
     {
-		float resistance = Thermistor_GetResistance();
+        return -therm_kelvin_q16;
+    }
+    temp = fx_div_q16(therm_bt0_q10, den >> 6) - therm_kelvin_q16;
 
-		// Use the Beta equation to calculate temperature
-		float invT = (1.0f / T0) + (log(resistance / R0) / BETA);
-		return (1.0f / invT) - 273.15f;  // Convert Kelvin to Celsius
+    thermStatus.conv_cycles = DWT->CYCCNT - t0;
+    if(thermStatus.conv_cycles > thermStatus.conv_max_cycles)
+    {
+        thermStatus.conv_max_cycles = thermStatus.conv_cycles;
     }
+    return temp;
+}
 
-    return 0;
+const thermistor_status_t *Thermistor_GetStatus(void)
+{
+    thermStatus.temperature = tx_temperature;
+    return &thermStatus;
+}
+
+float Thermistor_ReadTemperature(void)
+{
+    return fx_q16_to_float(Thermistor_ReadTemperatureQ16());
 }
@@ -1,5 +1,6 @@
 #include "trigger.h"
 #include "main.h"
+#include "interlock.h"
 
  #include "jsmn.h"
 
@@ -164,7 +165,6 @@ static void Configure_ONESHOT_Timer(TIM_HandleTypeDef* htim, uint16_t pulsewidth
 	  TIM_SlaveConfigTypeDef sSlaveConfig = {0};
 	  TIM_MasterConfigTypeDef sMasterConfig = {0};
 	  TIM_OC_InitTypeDef sConfigOC = {0};
-	  TIM_BreakDeadTimeConfigTypeDef sBreakDeadTimeConfig = {0};
 
 	  __HAL_TIM_DISABLE(htim);  // Stop timer if running
 
@@ -214,17 +214,8 @@ static void Configure_ONESHOT_Timer(TIM_HandleTypeDef* htim, uint16_t pulsewidth
 	  {
 	    Error_Handler();
 	  }
-	  sBreakDeadTimeConfig.OffStateRunMode = TIM_OSSR_DISABLE;
-	  sBreakDeadTimeConfig.OffStateIDLEMode = TIM_OSSI_DISABLE;
-	  sBreakDeadTimeConfig.LockLevel = TIM_LOCKLEVEL_OFF;
-	  sBreakDeadTimeConfig.DeadTime = 0;
-	  sBreakDeadTimeConfig.BreakState = TIM_BREAK_DISABLE;
-	  sBreakDeadTimeConfig.BreakPolarity = TIM_BREAKPOLARITY_HIGH;
-	  sBreakDeadTimeConfig.AutomaticOutput = TIM_AUTOMATICOUTPUT_DISABLE;
-	  if (HAL_TIMEx_ConfigBreakDeadTime(&TRIGGER_TIMER, &sBreakDeadTimeConfig) != HAL_OK)
-	  {
-	    Error_Handler();
-	  }
+	  // break input on the interlock line
+	  interlock_timer_config(&TRIGGER_TIMER);
 	  /* USER CODE BEGIN TIM15_Init 2 */
 
 	  /* USER CODE END TIM15_Init 2 */
@@ -364,8 +355,17 @@ uint8_t get_trigger_status(void)
 	return (uint8_t)_timerDataConfig.TriggerStatus;
 }
 
+// between the last pulse of a train and the next train, only trains with an interval have one
+bool trigger_in_train_gap(void)
+{
+	return _timerDataConfig.TriggerStatus == TRIGGER_STATUS_RUNNING &&
+		   _timerDataConfig.TriggerPulseTrainInterval > 0 &&
+		   _pulseCount >= _timerDataConfig.TriggerPulseCount;
+}
+
 uint8_t start_trigger_pulse(void) {
     if (_timerDataConfig.TriggerStatus != TRIGGER_STATUS_READY) return _timerDataConfig.TriggerStatus;
+    if (interlock_tripped()) return TRIGGER_STATUS_ERROR;	// output stays off until the interlock is cleared
 
 
     // Compute period from frequency (in microseconds)
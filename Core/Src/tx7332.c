@@ -1,5 +1,6 @@
 #include "main.h"
 #include "tx7332.h"
+#include "tx_cal.h"
 #include <stdio.h>
 #include <stdbool.h>
 
@@ -58,6 +59,7 @@ static void WriteAddr(uint16_t addr) {
 void TX7332_Init(TX7332* device, GPIO_TypeDef* cs_port, uint16_t cs_pin) {
     device->cs_port = cs_port;
     device->cs_pin = cs_pin;
+    device->cal = NULL;
     HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_SET);
 }
 
@@ -69,7 +71,7 @@ void TX7332_Reset(void) {
     HAL_Delay(5);
 }
 
-void TX7332_WriteReg(TX7332* device, uint16_t addr, uint32_t val) {
+static void WriteRegRaw(TX7332* device, uint16_t addr, uint32_t val) {
     HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_RESET);
     WriteAddr(addr);
     val = SwapEndian(val);
@@ -77,25 +79,29 @@ void TX7332_WriteReg(TX7332* device, uint16_t addr, uint32_t val) {
     HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_SET);
 }
 
+void TX7332_WriteReg(TX7332* device, uint16_t addr, uint32_t val) {
+    WriteRegRaw(device, addr, tx_cal_apply_reg(device->cal, addr, val));
+}
+
 uint32_t TX7332_ReadReg(TX7332* device, uint16_t addr) {
     uint32_t read[2];
 
     // Read chip 0
-    TX7332_WriteReg(device, 0, READ_DIE1);
+    WriteRegRaw(device, 0, READ_DIE1);
     HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_RESET);
     WriteAddr(addr);
     HAL_SPI_Receive(spi_, (uint8_t*)&read[0], 4, HAL_MAX_DELAY);
     HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_SET);
 
     // Read chip 1
-    TX7332_WriteReg(device, 0, READ_DIE2);
+    WriteRegRaw(device, 0, READ_DIE2);
     HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_RESET);
     WriteAddr(addr);
     HAL_SPI_Receive(spi_, (uint8_t*)&read[1], 4, HAL_MAX_DELAY);
     HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_SET);
 
     // Restore the original state
-    TX7332_WriteReg(device, 0, 0);
+    WriteRegRaw(device, 0, 0);
 
     // Combine the read values and return
     read[0] = read[0] | read[1];
@@ -103,7 +109,8 @@ uint32_t TX7332_ReadReg(TX7332* device, uint16_t addr) {
 }
 
 bool TX7332_WriteVerify(TX7332* device, uint16_t addr, uint32_t val){
-	TX7332_WriteReg(device, addr, val);
+	val = tx_cal_apply_reg(device->cal, addr, val);
+	WriteRegRaw(device, addr, val);
 	return TX7332_ReadReg(device, addr) == val;
 }
 
@@ -118,8 +125,10 @@ bool TX7332_WriteBulk(TX7332* device, uint16_t addr, uint32_t* pInts, int len) {
         return false;
     }
 
+    tx_cal_apply(device->cal, addr, pInts, len);
+
     if (len > 1) {
-        TX7332_WriteReg(device, 0, BURST_WR_EN);
+        WriteRegRaw(device, 0, BURST_WR_EN);
     }
 
     HAL_GPIO_WritePin(device->cs_port, device->cs_pin, GPIO_PIN_RESET);
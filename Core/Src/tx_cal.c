@@ -0,0 +1,185 @@
+/*
+ * tx_cal.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Per module channel delay calibration.  The table lives in the kv_store
+ *  of the module it was measured on and is applied by the TX7332 driver to
+ *  every delay profile word it writes, so host profiles can be the same
+ *  for every board.  Two channels are corrected per instruction with a
+ *  saturating halfword add and clamped to the delay range.
+ *
+ *  Temperature compensation adds its own offsets and a relative scale on
+ *  top.  The words are corrected on their way to the chip, so a copy of
+ *  what the host wrote is kept (in RAM2) to write them again when those
+ *  terms change.
+ */
+
+#include "tx_cal.h"
+#include "tx7332.h"
+#include "tx_pattern.h"
+#include "kv_store.h"
+
+#include <string.h>
+
+extern TX7332 transmitters[TX_PER_MODULE];
+
+#define TX_DELAY_REGS	(TX_DELAY_PROFILES * TX_DELAY_PROFILE_WORDS)
+
+static tx_cal_chip_t cal_chips[TX_PER_MODULE];
+static tx_cal_status_t cal_status;
+
+static int16_t temp_offset[TX_PER_MODULE][TX_CAL_CHANNELS];
+static int32_t temp_scale[TX_PER_MODULE];
+static uint32_t raw_delay[TX_PER_MODULE][TX_DELAY_REGS] __attribute__((section(".ram2")));
+static uint16_t raw_written[TX_PER_MODULE];		// profiles with at least one word in raw_delay
+
+// table and temperature offsets add up, both are int16 pairs in register order
+static void cal_chip_update(int chip)
+{
+	tx_cal_chip_t *c = &cal_chips[chip];
+	uint32_t table[TX_DELAY_PROFILE_WORDS];
+	uint32_t temp[TX_DELAY_PROFILE_WORDS];
+	bool temp_active = temp_scale[chip] != 0;
+
+	memcpy(table, cal_status.table.delay_offset[chip], sizeof(table));
+	memcpy(temp, temp_offset[chip], sizeof(temp));
+	for (int w = 0; w < TX_DELAY_PROFILE_WORDS; w++) {
+		c->delay_offset[w] = __QADD16(table[w], temp[w]);
+		temp_active |= temp[w] != 0;
+	}
+	c->delay_scale = temp_scale[chip];
+	c->pdn_force = cal_status.active ? ~cal_status.table.enable_mask[chip] : 0;
+	c->active = cal_status.active || temp_active;
+}
+
+static void tx_cal_load(void)
+{
+	const tx_cal_table_t *table;
+	uint16_t len = 0;
+	uint8_t version = 0;
+
+	memset(&cal_status.table, 0, sizeof(cal_status.table));
+	table = kv_store_ptr(KV_KEY_TX_CAL, &len, &version);
+	cal_status.active = (table != NULL && len == sizeof(tx_cal_table_t) && version == TX_CAL_VERSION);
+	if (cal_status.active) {
+		memcpy(&cal_status.table, table, sizeof(tx_cal_table_t));
+	}
+
+	for (int chip = 0; chip < TX_PER_MODULE; chip++) {
+		cal_chip_update(chip);
+		// always attached, the raw copy is kept even while nothing is corrected
+		transmitters[chip].cal = &cal_chips[chip];
+	}
+}
+
+void tx_cal_init(void)
+{
+	memset(&cal_status, 0, sizeof(cal_status));
+	memset(temp_offset, 0, sizeof(temp_offset));
+	memset(temp_scale, 0, sizeof(temp_scale));
+	memset(raw_delay, 0, sizeof(raw_delay));
+	memset(raw_written, 0, sizeof(raw_written));
+	tx_cal_load();
+}
+
+void tx_cal_set_temp(int chip, const int16_t offset[TX_CAL_CHANNELS], int32_t scale_q16)
+{
+	memcpy(temp_offset[chip], offset, sizeof(temp_offset[chip]));
+	temp_scale[chip] = scale_q16;
+	cal_chip_update(chip);
+}
+
+uint16_t tx_cal_profiles_written(int chip)
+{
+	return raw_written[chip];
+}
+
+const uint32_t *tx_cal_raw_profile(int chip, int profile)
+{
+	return &raw_delay[chip][profile * TX_DELAY_PROFILE_WORDS];
+}
+
+void tx_cal_apply(const tx_cal_chip_t *cal, uint16_t addr, uint32_t *words, int len)
+{
+	uint32_t t0;
+	uint32_t count = 0;
+	int chip;
+
+	if (cal == NULL) {
+		return;
+	}
+	chip = cal - cal_chips;
+	for (int i = 0; i < len; i++) {
+		uint16_t reg = addr + i;
+		if (reg >= TX_DELAY_PROFILE_BASE && reg < (TX_DELAY_PROFILE_BASE + TX_DELAY_REGS)) {
+			raw_delay[chip][reg - TX_DELAY_PROFILE_BASE] = words[i];
+			raw_written[chip] |= 1U << ((reg - TX_DELAY_PROFILE_BASE) / TX_DELAY_PROFILE_WORDS);
+		}
+	}
+	if (!cal->active) {
+		return;
+	}
+	t0 = DWT->CYCCNT;
+
+	for (int i = 0; i < len; i++) {
+		uint16_t reg = addr + i;
+		if (reg >= TX_DELAY_PROFILE_BASE && reg < (TX_DELAY_PROFILE_BASE + TX_DELAY_REGS)) {
+			uint32_t off = cal->delay_offset[(reg - TX_DELAY_PROFILE_BASE) % TX_DELAY_PROFILE_WORDS];
+			uint32_t w = words[i];
+			if (cal->delay_scale != 0) {
+				// each delay grows by delay * scale, low and high channel apart
+				int32_t lo = ((int16_t)w * cal->delay_scale) >> 16;
+				int32_t hi = ((int16_t)(w >> 16) * cal->delay_scale) >> 16;
+				w = __QADD16(w, __PKHBT(lo, hi, 16));
+			}
+			words[i] = __USAT16(__QADD16(w, off), TX_DELAY_BITS);
+			count++;
+		} else if (reg == TX_CHANNEL_PDN_REG) {
+			words[i] |= cal->pdn_force;
+		}
+	}
+
+	if (count > 0) {
+		cal_status.words_adjusted += count;
+		cal_status.last_words = count;
+		cal_status.last_cycles = DWT->CYCCNT - t0;
+	}
+}
+
+uint32_t tx_cal_apply_reg(const tx_cal_chip_t *cal, uint16_t addr, uint32_t val)
+{
+	tx_cal_apply(cal, addr, &val, 1);
+	return val;
+}
+
+void tx_cal_process(UartPacket *cmd, UartPacket *resp)
+{
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+
+	switch (cmd->reserved)
+	{
+	case TX_CAL_OP_GET:
+		break;
+	case TX_CAL_OP_SET:
+		if (cmd->data_len != sizeof(tx_cal_table_t) ||
+			kv_store_set(KV_KEY_TX_CAL, TX_CAL_VERSION, cmd->data, cmd->data_len) != HAL_OK) {
+			resp->packet_type = OW_ERROR;
+		}
+		tx_cal_load();
+		break;
+	case TX_CAL_OP_CLEAR:
+		if (kv_store_delete(KV_KEY_TX_CAL) != HAL_OK) {
+			resp->packet_type = OW_ERROR;
+		}
+		tx_cal_load();
+		break;
+	default:
+		resp->packet_type = OW_ERROR;
+		break;
+	}
+	resp->data_len = sizeof(cal_status);
+	resp->data = (uint8_t *)&cal_status;
+}
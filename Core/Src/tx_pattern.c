@@ -0,0 +1,114 @@
+/*
+ * tx_pattern.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Builds TX7332 pattern profile memory from a short waveform description
+ *  (frequency, cycles, polarity, phase, duty) so the host doesn't have to
+ *  ship the profile registers word by word.
+ */
+
+#include "tx_pattern.h"
+
+#include <string.h>
+
+typedef struct {
+	uint8_t *seg;
+	int count;
+	uint32_t carry;			// clocks too short for a segment, added to the next one
+	bool overflow;
+} pattern_builder_t;
+
+static void put_segment(pattern_builder_t *b, uint8_t level, uint32_t clks)
+{
+	if (b->count >= TX_PATTERN_MAX_SEGMENTS) {
+		b->overflow = true;
+		return;
+	}
+	b->seg[b->count++] = (uint8_t)(((clks - TX_PATTERN_SEG_MIN_CLKS) << 3) | level);
+}
+
+// Long levels are split into full length segments, never leaving a
+// remainder shorter than the minimum segment.  A level shorter than one
+// segment is carried into the next, so the period comes out whole.
+static void put_level(pattern_builder_t *b, uint8_t level, uint32_t clks)
+{
+	clks += b->carry;
+	b->carry = 0;
+	if (clks < TX_PATTERN_SEG_MIN_CLKS) {
+		b->carry = clks;
+		return;
+	}
+	while (clks >= TX_PATTERN_SEG_MIN_CLKS) {
+		uint32_t chunk = clks;
+		if (chunk > TX_PATTERN_SEG_MAX_CLKS) {
+			chunk = TX_PATTERN_SEG_MAX_CLKS;
+			if (clks - chunk < TX_PATTERN_SEG_MIN_CLKS) {
+				chunk -= TX_PATTERN_SEG_MIN_CLKS;
+			}
+		}
+		put_segment(b, level, chunk);
+		clks -= chunk;
+	}
+}
+
+/* Returns the number of segments used including the terminator, or -1 if
+ * the description doesn't fit one profile. */
+int tx_pattern_synthesize(const tx_pattern_desc_t *desc, uint32_t words[TX_PATTERN_PROFILE_WORDS])
+{
+	uint8_t seg[TX_PATTERN_MAX_SEGMENTS] = {0};
+	pattern_builder_t b = { seg, 0, 0, false };
+	uint8_t first = TX_PATTERN_LEVEL_HIGH;
+	uint8_t second = TX_PATTERN_LEVEL_LOW;
+
+	if (desc->frequency_hz == 0 || desc->frequency_hz > TX_PATTERN_CLK_HZ / (2 * TX_PATTERN_SEG_MIN_CLKS) ||
+		desc->cycles == 0 || desc->profile >= TX_PATTERN_PROFILES) {
+		return -1;
+	}
+
+	uint32_t period = (TX_PATTERN_CLK_HZ + desc->frequency_hz / 2) / desc->frequency_hz;
+	uint32_t half = period / 2;
+	uint32_t on = desc->duty ? (half * desc->duty + 127) / 255 : half;
+	uint32_t off = half - on;
+
+	if (desc->flags & TX_PATTERN_FLAG_INVERT) {
+		first = TX_PATTERN_LEVEL_LOW;
+		second = TX_PATTERN_LEVEL_HIGH;
+	}
+
+	put_level(&b, TX_PATTERN_LEVEL_GND, (uint32_t)(((uint64_t)period * (desc->phase_deg % 360)) / 360));
+	for (int i = 0; i < desc->cycles; i++) {
+		put_level(&b, first, on);
+		put_level(&b, TX_PATTERN_LEVEL_GND, off);
+		put_level(&b, second, on);
+		put_level(&b, TX_PATTERN_LEVEL_GND, (period - half) - on);
+	}
+	put_segment(&b, TX_PATTERN_LEVEL_END, TX_PATTERN_SEG_MIN_CLKS + b.carry);
+
+	if (b.overflow) {
+		return -1;
+	}
+
+	memset(words, 0, TX_PATTERN_PROFILE_WORDS * sizeof(uint32_t));
+	for (int i = 0; i < b.count; i++) {
+		words[i / 4] |= (uint32_t)seg[i] << (8 * (i % 4));
+	}
+	return b.count;
+}
+
+bool tx_pattern_apply(TX7332 *tx, const tx_pattern_desc_t *desc)
+{
+	uint32_t words[TX_PATTERN_PROFILE_WORDS];
+
+	if (tx_pattern_synthesize(desc, words) < 0) {
+		return false;
+	}
+	if (!TX7332_WriteBulk(tx, TX_PATTERN_PROFILE_BASE + desc->profile * TX_PATTERN_PROFILE_WORDS,
+						  words, TX_PATTERN_PROFILE_WORDS)) {
+		return false;
+	}
+	// pulser levels are fixed, apodization is which channels fire at all.
+	// Without a mask every channel fires, whatever an earlier pattern left.
+	return TX7332_WriteVerify(tx, TX_CHANNEL_PDN_REG,
+							  (desc->flags & TX_PATTERN_FLAG_APOD) ? ~desc->channel_mask : 0);
+}
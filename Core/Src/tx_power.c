@@ -0,0 +1,202 @@
+/*
+ * tx_power.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Standby management for the TX7332s and the TR switches.  The chips are
+ *  put in standby (TX_STDBY high, TR1-8 low) once nothing has needed them
+ *  for idle_timeout_ms and are woken again lead_time_us before a trigger
+ *  start.  On the master the start path also wakes the slaves, which stay
+ *  held active until the master itself goes idle.
+ */
+
+#include "tx_power.h"
+#include "trigger.h"
+#include "module_manager.h"
+#include "if_commands.h"
+
+#include <string.h>
+
+static tx_power_status_t tx_power = {
+	.idle_timeout_ms = TX_POWER_DEFAULT_IDLE_MS,
+	.lead_time_us = TX_POWER_DEFAULT_LEAD_US,
+	.state = TX_POWER_ACTIVE,
+};
+
+static uint32_t last_active_tick = 0;
+static uint32_t wake_cycles = 0;
+static bool slaves_held = false;
+static UartPacket notify_cmd;
+static bool notify_pending = false;
+
+static uint32_t cycles_per_us(void)
+{
+	return SystemCoreClock / 1000000U;
+}
+
+static void set_tx_pins(bool active)
+{
+	GPIO_PinState tr = active ? GPIO_PIN_SET : GPIO_PIN_RESET;
+
+	HAL_GPIO_WritePin(TX_STDBY_GPIO_Port, TX_STDBY_Pin, active ? GPIO_PIN_RESET : GPIO_PIN_SET);
+	HAL_GPIO_WritePin(TR1_EN_GPIO_Port, TR1_EN_Pin, tr);
+	HAL_GPIO_WritePin(TR2_EN_GPIO_Port, TR2_EN_Pin, tr);
+	HAL_GPIO_WritePin(TR3_EN_GPIO_Port, TR3_EN_Pin, tr);
+	HAL_GPIO_WritePin(TR4_EN_GPIO_Port, TR4_EN_Pin, tr);
+	HAL_GPIO_WritePin(TR5_EN_GPIO_Port, TR5_EN_Pin, tr);
+	HAL_GPIO_WritePin(TR6_EN_GPIO_Port, TR6_EN_Pin, tr);
+	HAL_GPIO_WritePin(TR7_EN_GPIO_Port, TR7_EN_Pin, tr);
+	HAL_GPIO_WritePin(TR8_EN_GPIO_Port, TR8_EN_Pin, tr);
+}
+
+static void enter_standby(void)
+{
+	set_tx_pins(false);
+	tx_power.state = TX_POWER_STANDBY;
+}
+
+/* One chained transmit to every slave, nothing waits for them here.  The
+ * replies are read back by notify_collect, a slave holds one and the next
+ * relay to it would otherwise take it for its own. */
+static void notify_send(TxPowerOp op)
+{
+	memset(&notify_cmd, 0, sizeof(notify_cmd));
+	notify_cmd.packet_type = OW_CONTROLLER;
+	notify_cmd.command = OW_CTRL_TX_POWER;
+	notify_cmd.reserved = (uint8_t)op;
+
+	for (uint8_t module = 1; module < get_module_count(); module++) {
+		if_relay_post(module, &notify_cmd);	// one that doesn't queue is relayed on its own below
+	}
+	if_relay_launch();
+	notify_pending = true;
+}
+
+static void notify_collect(void)
+{
+	if (!notify_pending) {
+		return;
+	}
+	notify_pending = false;
+	for (uint8_t module = 1; module < get_module_count(); module++) {
+		notify_cmd.addr = module;
+		if (!if_relay_command(module, &notify_cmd)) {
+			tx_power.notify_failed++;
+		}
+	}
+}
+
+static void hold_slaves(void)
+{
+	if (get_device_role() == ROLE_MASTER && !slaves_held && get_module_count() > 1) {
+		notify_send(TX_POWER_OP_WAKE);
+		slaves_held = true;
+		wake_cycles = DWT->CYCCNT;
+	}
+}
+
+void tx_power_init(void)
+{
+	// cycle counter for the wake latency measurement
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	// main() leaves the chips awake after reset
+	tx_power.state = TX_POWER_ACTIVE;
+	tx_power.held = 0;
+	slaves_held = false;
+	last_active_tick = HAL_GetTick();
+	wake_cycles = DWT->CYCCNT;
+}
+
+void tx_power_wake(bool hold)
+{
+	if (hold) {
+		tx_power.held = 1;
+	}
+	last_active_tick = HAL_GetTick();
+
+	if (tx_power.state == TX_POWER_STANDBY) {
+		set_tx_pins(true);
+		wake_cycles = DWT->CYCCNT;
+		tx_power.state = TX_POWER_ACTIVE;
+		tx_power.wake_count++;
+	}
+
+	if (hold) {
+		hold_slaves();
+		notify_collect();
+	}
+}
+
+void tx_power_release(void)
+{
+	tx_power.held = 0;
+	last_active_tick = HAL_GetTick();
+
+	// a slave only runs on its master's behalf, drop straight to standby
+	if (get_device_role() == ROLE_SLAVE && tx_power.idle_timeout_ms > 0) {
+		enter_standby();
+	}
+}
+
+/*
+ * Called right before start_trigger_pulse().  Wakes everything that may be
+ * asleep and then waits out whatever is left of the lead time, so the cost
+ * is zero when the array was already awake (e.g. armed ahead of time).
+ */
+bool tx_power_prepare_start(void)
+{
+	uint32_t t0 = DWT->CYCCNT;
+	uint32_t lead_cycles = tx_power.lead_time_us * cycles_per_us();
+	uint32_t latency_us;
+
+	tx_power_wake(false);
+	hold_slaves();
+
+	// the slaves wake while this waits, their replies are read after it
+	while ((DWT->CYCCNT - wake_cycles) < lead_cycles) { /* settle */ }
+	notify_collect();
+
+	latency_us = (DWT->CYCCNT - t0) / cycles_per_us();
+	tx_power.last_wake_latency_us = latency_us;
+	if (latency_us > tx_power.max_wake_latency_us) {
+		tx_power.max_wake_latency_us = latency_us;
+	}
+	return true;
+}
+
+void tx_power_process(void)
+{
+	uint32_t now = HAL_GetTick();
+
+	if (tx_power.held || get_trigger_status() == TRIGGER_STATUS_RUNNING) {
+		last_active_tick = now;
+		return;
+	}
+	if (tx_power.idle_timeout_ms == 0 || tx_power.state == TX_POWER_STANDBY) {
+		return;
+	}
+
+	if ((now - last_active_tick) >= tx_power.idle_timeout_ms) {
+		enter_standby();
+		if (slaves_held) {
+			notify_send(TX_POWER_OP_RELEASE);
+			notify_collect();
+			slaves_held = false;
+		}
+	}
+}
+
+void tx_power_set_config(uint32_t idle_timeout_ms, uint32_t lead_time_us)
+{
+	tx_power.idle_timeout_ms = idle_timeout_ms;
+	tx_power.lead_time_us = (lead_time_us > TX_POWER_MAX_LEAD_US) ? TX_POWER_MAX_LEAD_US : lead_time_us;
+	last_active_tick = HAL_GetTick();
+}
+
+const tx_power_status_t* tx_power_get_status(void)
+{
+	return &tx_power;
+}
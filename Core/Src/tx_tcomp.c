@@ -0,0 +1,252 @@
+/*
+ * tx_tcomp.c
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Temperature compensation of the channel delays.  The coefficient model
+ *  in the kv_store turns the distance from the temperature the profiles
+ *  were made for into an offset per channel (driver and element drift)
+ *  and a relative scale of every delay (speed of sound in the coupling
+ *  medium).  Each period the applied terms move towards that target by at
+ *  most max_step LSBs and go into the tx_cal correction, so every profile
+ *  write picks them up.  Profiles already in the chips are written again
+ *  from tx_cal's copy of the host words, one per pass, while the trigger
+ *  is idle or between trains; the next step waits until they all are.
+ */
+
+#include "tx_tcomp.h"
+#include "tx7332.h"
+#include "trigger.h"
+#include "thermistor.h"
+#include "kv_store.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TCOMP_TEMP_MIN		FX_Q16(-20.0)	// outside this the sensor is broken, not the room
+#define TCOMP_TEMP_MAX		FX_Q16(100.0)
+#define TCOMP_OFFSET_MAX	((1 << (TX_DELAY_BITS - 1)) - 1)
+#define TCOMP_SCALE_MAX		FX_Q16(0.25)
+#define TCOMP_SETTLE_MS		2000	// both sensors have been read at least once by then
+
+extern TX7332 transmitters[TX_PER_MODULE];
+
+static tx_tcomp_model_t model;
+static tx_tcomp_status_t tcomp_status;
+static int16_t target[TX_PER_MODULE][TX_CAL_CHANNELS];
+static q16_t target_scale = 0;
+static q16_t target_temp = 0;		// sample the target was computed from
+static bool target_valid = false;
+static uint16_t refresh_pending[TX_PER_MODULE];
+static uint32_t last_tick = 0;
+static uint32_t init_tick = 0;
+
+static int32_t clamp(int32_t v, int32_t limit)
+{
+	return v > limit ? limit : (v < -limit ? -limit : v);
+}
+
+static int32_t step_towards(int32_t cur, int32_t tgt, int32_t limit)
+{
+	return cur + clamp(tgt - cur, limit);
+}
+
+static bool model_valid(const tx_tcomp_model_t *m)
+{
+	return m->source <= TX_TCOMP_SRC_AMBIENT && m->max_step > 0 &&
+		   m->period_ms >= TX_TCOMP_MIN_PERIOD_MS && abs(m->scale_ppm) <= TX_TCOMP_MAX_SCALE_PPM;
+}
+
+static void tcomp_load(void)
+{
+	const tx_tcomp_model_t *stored;
+	uint16_t len = 0;
+	uint8_t version = 0;
+
+	stored = kv_store_ptr(KV_KEY_TX_TCOMP, &len, &version);
+	tcomp_status.enabled = (stored != NULL && len == sizeof(model) && version == TX_TCOMP_VERSION &&
+							model_valid(stored));
+	if (tcomp_status.enabled) {
+		memcpy(&model, stored, sizeof(model));
+	} else {
+		// keep the rate of the old model so a clear walks back as gently
+		memset(target, 0, sizeof(target));
+		target_scale = 0;
+	}
+	tcomp_status.source = model.source;
+	target_valid = false;
+}
+
+static bool tcomp_sample(q16_t *temp)
+{
+	if (model.source == TX_TCOMP_SRC_AMBIENT) {
+		*temp = (q16_t)(ambient_temperature * 65536.0f);
+	} else {
+		*temp = Thermistor_ReadTemperatureQ16();
+	}
+	return *temp >= TCOMP_TEMP_MIN && *temp <= TCOMP_TEMP_MAX;
+}
+
+static void tcomp_target(q16_t temp)
+{
+	q16_t delta = temp - ((q16_t)model.ref_temp_c8 * 256);
+
+	// coeff is Q8 and delta Q16, the product is Q24 LSBs
+	for (int chip = 0; chip < TX_PER_MODULE; chip++) {
+		for (int ch = 0; ch < TX_CAL_CHANNELS; ch++) {
+			int64_t v = ((int64_t)model.coeff[chip][ch] * delta + (1 << 23)) >> 24;
+			target[chip][ch] = (int16_t)clamp((int32_t)v, TCOMP_OFFSET_MAX);
+		}
+	}
+	target_scale = clamp((int32_t)(((int64_t)model.scale_ppm * delta) / 1000000), TCOMP_SCALE_MAX);
+	target_temp = temp;
+	target_valid = true;
+	tcomp_status.delta = delta;
+}
+
+// one rate limited step of every term, true if anything moved
+static bool tcomp_step(void)
+{
+	// a scale step moves the longest delay by at most max_step as well
+	int32_t scale_limit = (int32_t)model.max_step << (16 - TX_DELAY_BITS);
+	int32_t max_offset = 0, max_error = 0;
+	bool moved = false;
+
+	for (int chip = 0; chip < TX_PER_MODULE; chip++) {
+		for (int ch = 0; ch < TX_CAL_CHANNELS; ch++) {
+			int16_t cur = tcomp_status.offset[chip][ch];
+			int16_t next = (int16_t)step_towards(cur, target[chip][ch], model.max_step);
+			if (next != cur) {
+				tcomp_status.offset[chip][ch] = next;
+				moved = true;
+			}
+			if (abs(next) > max_offset) max_offset = abs(next);
+			if (abs(target[chip][ch] - next) > max_error) max_error = abs(target[chip][ch] - next);
+		}
+	}
+	if (tcomp_status.scale != target_scale) {
+		tcomp_status.scale = step_towards(tcomp_status.scale, target_scale, scale_limit);
+		moved = true;
+	}
+	tcomp_status.max_offset = (int16_t)max_offset;
+	tcomp_status.max_error = (int16_t)max_error;
+	return moved;
+}
+
+static bool refresh_idle(void)
+{
+	for (int chip = 0; chip < TX_PER_MODULE; chip++) {
+		if (refresh_pending[chip] != 0) return false;
+	}
+	return true;
+}
+
+// writes one profile again with the current terms, only where no train fires
+static void tcomp_refresh(void)
+{
+	uint32_t words[TX_DELAY_PROFILE_WORDS];
+
+	if (get_trigger_status() == TRIGGER_STATUS_RUNNING && !trigger_in_train_gap()) {
+		return;
+	}
+	for (int chip = 0; chip < TX_PER_MODULE; chip++) {
+		int profile;
+		if (refresh_pending[chip] == 0) continue;
+		profile = __builtin_ctz(refresh_pending[chip]);
+		// the driver corrects in place, the raw copy has to stay as the host wrote it
+		memcpy(words, tx_cal_raw_profile(chip, profile), sizeof(words));
+		TX7332_WriteBulk(&transmitters[chip], TX_DELAY_PROFILE_BASE + profile * TX_DELAY_PROFILE_WORDS,
+						 words, TX_DELAY_PROFILE_WORDS);
+		refresh_pending[chip] &= ~(1U << profile);
+		tcomp_status.profiles_rewritten++;
+		return;
+	}
+}
+
+void tx_tcomp_init(void)
+{
+	memset(&model, 0, sizeof(model));
+	memset(&tcomp_status, 0, sizeof(tcomp_status));
+	memset(refresh_pending, 0, sizeof(refresh_pending));
+	tcomp_load();
+	tcomp_status.converged = 1;
+	init_tick = HAL_GetTick();
+}
+
+void tx_tcomp_run(void)
+{
+	uint32_t now = HAL_GetTick();
+	q16_t temp;
+
+	if (!refresh_idle()) {
+		tcomp_refresh();
+		tcomp_status.converged = refresh_idle() && tcomp_status.max_error == 0 && tcomp_status.scale == target_scale;
+		return;
+	}
+	if ((!tcomp_status.enabled && tcomp_status.converged) || (now - last_tick) < model.period_ms ||
+		(now - init_tick) < TCOMP_SETTLE_MS) {
+		return;
+	}
+	last_tick = now;
+
+	if (tcomp_status.enabled) {
+		if (!tcomp_sample(&temp)) {
+			tcomp_status.sensor_faults++;
+			return;
+		}
+		tcomp_status.temp = temp;
+		if (!target_valid || abs(temp - target_temp) >= ((q16_t)model.deadband_c8 * 256)) {
+			tcomp_target(temp);
+		}
+	}
+
+	if (tcomp_step()) {
+		for (int chip = 0; chip < TX_PER_MODULE; chip++) {
+			int16_t offset[TX_CAL_CHANNELS];
+			memcpy(offset, tcomp_status.offset[chip], sizeof(offset));
+			tx_cal_set_temp(chip, offset, tcomp_status.scale);
+			refresh_pending[chip] = tx_cal_profiles_written(chip);
+		}
+		tcomp_status.updates++;
+		tcomp_status.last_update_tick = now;
+	}
+	tcomp_status.converged = refresh_idle() && tcomp_status.max_error == 0 && tcomp_status.scale == target_scale;
+}
+
+const tx_tcomp_status_t* tx_tcomp_get_status(void)
+{
+	return &tcomp_status;
+}
+
+void tx_tcomp_process(UartPacket *cmd, UartPacket *resp)
+{
+	resp->command = cmd->command;
+	resp->addr = cmd->addr;
+	resp->reserved = cmd->reserved;
+
+	switch (cmd->reserved)
+	{
+	case TX_TCOMP_OP_GET:
+		break;
+	case TX_TCOMP_OP_SET:
+		if (cmd->data_len != sizeof(tx_tcomp_model_t) || !model_valid((const tx_tcomp_model_t *)cmd->data) ||
+			kv_store_set(KV_KEY_TX_TCOMP, TX_TCOMP_VERSION, cmd->data, cmd->data_len) != HAL_OK) {
+			resp->packet_type = OW_ERROR;
+		}
+		tcomp_load();
+		tcomp_status.converged = 0;
+		break;
+	case TX_TCOMP_OP_CLEAR:
+		if (kv_store_delete(KV_KEY_TX_TCOMP) != HAL_OK) {
+			resp->packet_type = OW_ERROR;
+		}
+		tcomp_load();
+		tcomp_status.converged = 0;
+		break;
+	default:
+		resp->packet_type = OW_ERROR;
+		break;
+	}
+	resp->data_len = sizeof(tcomp_status);
+	resp->data = (uint8_t *)&tcomp_status;
+}
@@ -13,16 +13,24 @@
 #include "utils.h"
 #include "usbd_cdc_if.h"
 #include "thermistor.h"
+#include "replay_cache.h"
+#include "cmd_macro.h"
+#include "cmd_deadline.h"
+#include "tx_tcomp.h"
+#include "cmd_noack.h"
+#include "link_monitor.h"
 
 #include <string.h>
 #include <stdbool.h>
 
 #define ONEWIRE_TIMEOUT 500
+#define ONEWIRE_HEADER_LEN 9
+#define ONEWIRE_TURNAROUND_US 200	// ~2 characters at 115200, lets the far end turn its line around
 #define TX_TIMEOUT 500
 
 // Private variables
 uint8_t rxBuffer[COMMAND_MAX_SIZE];
-uint8_t txBuffer[COMMAND_MAX_SIZE];
+uint8_t txBuffer[2][COMMAND_MAX_SIZE];	// one fills while the other goes out
 uint8_t owRxBuffer[COMMAND_MAX_SIZE];
 uint8_t owTxBuffer[COMMAND_MAX_SIZE];
 
@@ -36,6 +44,18 @@ volatile uint8_t tx_ow_callout_flag = 0;
 volatile uint16_t ow_packetid = 0;
 
 volatile bool async_enabled = false;
+volatile bool credit_reports_enabled = false;
+
+static uint16_t host_rx_backlog;		// bytes buffered behind the frame being processed
+static uint16_t host_rx_backlog_frames;
+static host_credit_t host_credit;
+static uint16_t host_relay_scanned;	// batch offset the relay lookahead has covered
+static uint32_t host_last_rx_tick;	// when the last batch from the host was handled
+static uint8_t tx_cur;					// txBuffer being filled
+static volatile uint16_t tx_fill;		// bytes of frames queued in it
+static uint32_t tx_first_cycles;		// when the oldest of them was queued
+static volatile bool tx_from_isr;		// frames queued by an interrupt, the superloop sends them
+static host_coalesce_t host_coalesce;
 
 static uint16_t ow_packet_count;
 static UartPacket ow_send_packet;
@@ -111,58 +131,119 @@ static void buffer_to_packet(uint8_t* pBuffer, UartPacket* pPacket) {
     }
 }
 
-static void comms_interface_send(UartPacket* pResp)
+// Send what is queued as one transfer, filling goes on in the other buffer.
+// Only the transfer before it has to be done first.  Superloop only.
+static void comms_interface_flush(void)
 {
-    tx_flag = 0;  // Clear the flag before starting transmission
+    uint32_t start_time = HAL_GetTick();
+    uint32_t primask = __get_PRIMASK();
+    uint8_t result;
 
-    memset(txBuffer, 0, sizeof(txBuffer));
-    int bufferIndex = 0;
+    if (tx_fill == 0) {
+        return;
+    }
 
-    // Build the packet header
-    txBuffer[bufferIndex++] = OW_START_BYTE;
-    txBuffer[bufferIndex++] = pResp->id >> 8;
-    txBuffer[bufferIndex++] = pResp->id & 0xFF;
-    txBuffer[bufferIndex++] = pResp->packet_type;
-    txBuffer[bufferIndex++] = pResp->command;
-    txBuffer[bufferIndex++] = pResp->addr;
-    txBuffer[bufferIndex++] = pResp->reserved;
-    txBuffer[bufferIndex++] = (pResp->data_len) >> 8;
-    txBuffer[bufferIndex++] = (pResp->data_len) & 0xFF;
+    // interrupts may queue frames while the previous transfer finishes,
+    // they are taken along with the rest
+    for (;;) {
+        __disable_irq();
+        tx_flag = 0;  // Clear the flag before starting transmission
+        result = CDC_Transmit_FS(txBuffer[tx_cur], tx_fill);
+        if (result != USBD_BUSY || (HAL_GetTick() - start_time) >= TX_TIMEOUT) {
+            break;
+        }
+        __set_PRIMASK(primask);
+    }
+    if (result == USBD_OK) {
+        tx_cur ^= 1;
+        host_coalesce.transfers++;
+    }
+    // on a timeout the host isn't reading, the frames are dropped and the
+    // buffer still going out is left alone
+    tx_fill = 0;
+    tx_from_isr = false;
+    __set_PRIMASK(primask);
+}
+
+static bool coalesce_expired(void)
+{
+    return tx_fill > 0 && link_elapsed_us(tx_first_cycles) >= host_coalesce.window_us;
+}
+
+static void comms_interface_send(UartPacket* pResp)
+{
+    uint16_t frame_len = pResp->data_len + 12;
+    uint16_t limit = host_coalesce.max_bytes;
+    bool in_isr = __get_IPSR() != 0;
+    uint32_t primask;
+    uint8_t* frame;
+    int bufferIndex = 0;
 
     // Check for possible buffer overflow (optional)
-    if ( (bufferIndex + pResp->data_len + 4) > sizeof(txBuffer) ) {
+    if (frame_len > sizeof(txBuffer[0])) {
         // Handle error: packet too large for txBuffer
         return;
     }
 
+    // async frames come from interrupts, a frame is never left half built.
+    // The queue goes first when this one doesn't fit behind it, an
+    // interrupt can't wait for that and its frame is dropped.
+    for (;;) {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        if (tx_fill == 0 || ((tx_fill + frame_len) <= sizeof(txBuffer[0]) &&
+                             (limit == 0 || (tx_fill + frame_len) <= limit))) {
+            break;
+        }
+        __set_PRIMASK(primask);
+        if (in_isr) {
+            return;
+        }
+        comms_interface_flush();
+    }
+    if (tx_fill == 0) {
+        tx_first_cycles = DWT->CYCCNT;
+    }
+    frame = &txBuffer[tx_cur][tx_fill];
+
+    // Build the packet header
+    frame[bufferIndex++] = OW_START_BYTE;
+    frame[bufferIndex++] = pResp->id >> 8;
+    frame[bufferIndex++] = pResp->id & 0xFF;
+    frame[bufferIndex++] = pResp->packet_type;
+    frame[bufferIndex++] = pResp->command;
+    frame[bufferIndex++] = pResp->addr;
+    frame[bufferIndex++] = pResp->reserved;
+    frame[bufferIndex++] = (pResp->data_len) >> 8;
+    frame[bufferIndex++] = (pResp->data_len) & 0xFF;
+
     // Add data payload if any
     if(pResp->data_len > 0)
     {
-        memcpy(&txBuffer[bufferIndex], pResp->data, pResp->data_len);
+        memcpy(&frame[bufferIndex], pResp->data, pResp->data_len);
         bufferIndex += pResp->data_len;
     }
 
     // Compute CRC over the packet from index 1 for (pResp->data_len + 8) bytes
-    uint16_t crc = util_crc16(&txBuffer[1], pResp->data_len + 8);
-    txBuffer[bufferIndex++] = crc >> 8;
-    txBuffer[bufferIndex++] = crc & 0xFF;
+    uint16_t crc = util_crc16(&frame[1], pResp->data_len + 8);
+    frame[bufferIndex++] = crc >> 8;
+    frame[bufferIndex++] = crc & 0xFF;
 
     // Add the end byte
-    txBuffer[bufferIndex++] = OW_END_BYTE;
-
-    // Initiate transmission via USB CDC
-    CDC_Transmit_FS(txBuffer, bufferIndex);
+    frame[bufferIndex++] = OW_END_BYTE;
 
-    // Wait for the transmit complete flag with a timeout to avoid infinite loop.
-    uint32_t start_time = HAL_GetTick();
+    tx_fill += bufferIndex;
+    host_coalesce.frames++;
+    if (in_isr) {
+        tx_from_isr = true;
+    }
+    __set_PRIMASK(primask);
 
-    while(!tx_flag)
-    {
-        if ((HAL_GetTick() - start_time) >= TX_TIMEOUT)
-        {
-            // Timeout handling: Log error and break out or reset the flag.
-            break;
-        }
+    if (in_isr) {
+        return;
+    }
+    if (limit == 0 || tx_fill >= limit || (host_coalesce.window_us > 0 && coalesce_expired())) {
+        comms_interface_flush();
     }
 }
 
@@ -359,100 +440,411 @@ void comms_host_start(void)
 
     rx_flag = 0;
     tx_flag = 0;
+    host_last_rx_tick = HAL_GetTick();
 
 	CDC_ReceiveToIdle(rxBuffer, COMMAND_MAX_SIZE);
 
 }
 
-void comms_host_check_received(void)
+// Time since the host last sent anything, background work yields to it
+uint32_t comms_host_idle_ms(void)
 {
-	UartPacket cmd;
-	UartPacket resp;
-    uint16_t calculated_crc;
+	return HAL_GetTick() - host_last_rx_tick;
+}
 
-	if(!rx_flag) return;
+bool comms_host_set_coalesce(uint16_t max_bytes, uint16_t window_us)
+{
+	if (max_bytes > sizeof(txBuffer[0]) || window_us > HOST_COALESCE_MAX_WINDOW_US) {
+		return false;
+	}
+	// whatever waits goes out under the old settings
+	comms_interface_flush();
+	host_coalesce.max_bytes = max_bytes;
+	host_coalesce.window_us = window_us;
+	return true;
+}
 
-    int bufferIndex = 0;
+const host_coalesce_t *comms_host_get_coalesce(void)
+{
+	return &host_coalesce;
+}
 
-    if(rxBuffer[bufferIndex++] != OW_START_BYTE) {
-        // Send NACK doesn't have the correct start byte
-    	resp.id = 0xFFFF;
-        resp.data_len = 0;
-        resp.packet_type = OW_NAK;
-        goto NextDataPacket;
-    }
+// superloop: responses that have waited their window go out, and frames
+// queued from interrupts on the next pass
+void comms_host_tx_poll(void)
+{
+	if (tx_from_isr || coalesce_expired()) {
+		comms_interface_flush();
+	}
+}
 
-    cmd.id = (rxBuffer[bufferIndex] << 8 | (rxBuffer[bufferIndex+1] & 0xFF ));
+// Length of the frame at pBuffer, 0 while it is still incomplete, -1 if it can never be a frame
+static int32_t host_frame_length(const uint8_t* pBuffer, uint16_t avail)
+{
+	uint16_t data_len;
+
+	if(avail == 0) return 0;
+	if(pBuffer[0] != OW_START_BYTE) return -1;
+	if(avail < 9) return 0;
+
+	data_len = (pBuffer[7] << 8 | (pBuffer[8] & 0xFF ));
+	if(data_len > DATA_MAX_SIZE) return -1;
+	if(avail < data_len + 12) return 0;
+
+	return data_len + 12;
+}
+
+/* Fill cmd from a complete frame, OW_SUCCESS or why it can't be used */
+static uint8_t host_frame_parse(uint8_t* pBuffer, UartPacket* cmd)
+{
+    uint16_t calculated_crc;
+
+    // start byte and length were validated by host_frame_length
+    int bufferIndex = 1;
+
+    cmd->id = (pBuffer[bufferIndex] << 8 | (pBuffer[bufferIndex+1] & 0xFF ));
     bufferIndex+=2;
-    cmd.packet_type = rxBuffer[bufferIndex++];
-    cmd.command = rxBuffer[bufferIndex++];
-    cmd.addr = rxBuffer[bufferIndex++];
-    cmd.reserved = rxBuffer[bufferIndex++];
+    cmd->packet_type = pBuffer[bufferIndex++];
+    cmd->command = pBuffer[bufferIndex++];
+    cmd->addr = pBuffer[bufferIndex++];
+    cmd->reserved = pBuffer[bufferIndex++];
 
     // Extract payload length
-    cmd.data_len = (rxBuffer[bufferIndex] << 8 | (rxBuffer[bufferIndex+1] & 0xFF ));
+    cmd->data_len = (pBuffer[bufferIndex] << 8 | (pBuffer[bufferIndex+1] & 0xFF ));
     bufferIndex+=2;
 
-    // Check if data length is valid
-    if (cmd.data_len > DATA_MAX_SIZE) {
-        // Send NACK response due to no end byte
-    	// data can exceed buffersize but every buffer must have a start and end packet
-    	// command that will send more data than one buffer will follow with data packets to complete the request
-    	resp.id = cmd.id;
-    	resp.addr = 0;
-    	resp.reserved = 0;
-        resp.data_len = 0;
-        resp.packet_type = OW_ERROR;
-        goto NextDataPacket;
-    }
-
     // Extract data pointer
-    cmd.data = &rxBuffer[bufferIndex];
-    bufferIndex += cmd.data_len; // move pointer to end of data
-    
+    cmd->data = &pBuffer[bufferIndex];
+    bufferIndex += cmd->data_len; // move pointer to end of data
+
     // Extract received CRC
-    cmd.crc = (rxBuffer[bufferIndex] << 8 | (rxBuffer[bufferIndex+1] & 0xFF ));
+    cmd->crc = (pBuffer[bufferIndex] << 8 | (pBuffer[bufferIndex+1] & 0xFF ));
     bufferIndex+=2;
 
     // Calculate CRC for received data
-  	calculated_crc = util_crc16(&rxBuffer[1], cmd.data_len + 8);
+  	calculated_crc = util_crc16(&pBuffer[1], cmd->data_len + 8);
 
     // Check CRC
-    if (cmd.crc != calculated_crc) {
-        // Send NACK response due to bad CRC
-    	resp.id = cmd.id;
-    	resp.addr = 0;
-    	resp.reserved = OW_BAD_CRC;
-        resp.data_len = 0;
-        resp.packet_type = OW_ERROR;
-        goto NextDataPacket;
+    if (cmd->crc != calculated_crc) {
+        return OW_BAD_CRC;
     }
 
     // Check end byte
-    if (rxBuffer[bufferIndex++] != OW_END_BYTE) {
+    if (pBuffer[bufferIndex++] != OW_END_BYTE) {
+        return OW_ERROR;
+    }
+    return OW_SUCCESS;
+}
+
+static void comms_host_process_frame(uint8_t* pBuffer, uint16_t offset)
+{
+	UartPacket cmd;
+	UartPacket resp;
+	uint8_t status;
+	bool noack = false;
+
+	status = host_frame_parse(pBuffer, &cmd);
+	if(status != OW_SUCCESS) {
+        // Send NACK response due to bad CRC or missing end byte
     	resp.id = cmd.id;
-        resp.data_len = 0;
     	resp.addr = 0;
-    	resp.reserved = 0;
+    	resp.reserved = (status == OW_BAD_CRC) ? OW_BAD_CRC : 0;
+        resp.data_len = 0;
         resp.packet_type = OW_ERROR;
         goto NextDataPacket;
-    }
+	}
 
-	process_if_command(&cmd, &resp);
+	// fire and forget, only a failure is kept
+	noack = cmd_noack_strip(&cmd);
+
+	// a command with a deadline runs unwrapped, or not at all once it is stale
+	status = cmd_deadline_unwrap(&cmd, offset);
+	if(status != OW_SUCCESS) {
+		resp.id = cmd.id;
+		resp.command = cmd.command;
+		resp.addr = cmd.addr;
+		resp.reserved = status;
+		resp.data_len = 0;
+		resp.packet_type = OW_ERROR;
+		goto NextDataPacket;
+	}
+
+	// an exact resend of a write that already went through gets the same answer again
+	if(!replay_cache_lookup(&cmd, &resp)) {
+		process_if_command(&cmd, &resp);
+		replay_cache_store(&cmd, &resp);
+		cmd_macro_record(&cmd, &resp);
+	}
 
 NextDataPacket:
+	if(noack) {
+		cmd_noack_done(&cmd, &resp);
+		return;
+	}
 	comms_interface_send(&resp);
-	memset(rxBuffer, 0, sizeof(rxBuffer));
-	ptrReceive=0;
+}
+
+void comms_host_get_credit(host_credit_t *credit)
+{
+	uint16_t frames = host_rx_backlog_frames < HOST_RX_MAX_FRAMES ? host_rx_backlog_frames : HOST_RX_MAX_FRAMES;
+
+	credit->frames = HOST_RX_MAX_FRAMES - frames;
+	credit->bytes = COMMAND_MAX_SIZE - host_rx_backlog;
+	credit->max_frames = HOST_RX_MAX_FRAMES;
+	credit->max_bytes = COMMAND_MAX_SIZE;
+}
+
+/* When the frame at offset is work for the master's own chips and frames
+ * for slave chips follow the local run, start those relays now.  The I2C
+ * transfers then run while the local SPI work is done and each relay is
+ * joined when its frame comes up, in order, so responses go out unchanged. */
+static void comms_host_start_relays(uint16_t offset, uint16_t avail)
+{
+	UartPacket cmd;
+	int32_t frame_len;
+	bool queued = false;
+
+	if(offset < host_relay_scanned) {
+		return;	// already looked past this frame
+	}
+	while(offset < avail && (frame_len = host_frame_length(&rxBuffer[offset], avail - offset)) > 0) {
+		if(host_frame_parse(&rxBuffer[offset], &cmd) != OW_SUCCESS) {
+			break;
+		}
+		if(!queued && if_command_is_local(&cmd)) {
+			offset += frame_len;
+			continue;
+		}
+		if(replay_cache_contains(&cmd) || !if_relay_queue(&cmd)) {
+			break;
+		}
+		queued = true;
+		offset += frame_len;
+	}
+	host_relay_scanned = offset;
+	if_relay_launch();
+}
+
+void comms_host_check_received(void)
+{
+	UartPacket cmd;
+	UartPacket resp;
+	uint16_t avail;
+	uint16_t offset = 0;
+	uint16_t frames = 0;
+	uint16_t processed = 0;
+	int32_t frame_len;
+
+	if(!rx_flag) return;
+
+	host_last_rx_tick = HAL_GetTick();
+	avail = (uint16_t)ptrReceive;
+
+	// count what arrived so credits reflect the whole batch while it drains,
+	// and apply flushes now, to the frames already queued ahead of them
+	cmd_deadline_batch_start();
+	while(offset < avail && (frame_len = host_frame_length(&rxBuffer[offset], avail - offset)) > 0) {
+		if(rxBuffer[offset + 4] == OW_CTRL_DEADLINE && host_frame_parse(&rxBuffer[offset], &cmd) == OW_SUCCESS) {
+			cmd_deadline_scan(&cmd, offset);
+		}
+		offset += frame_len;
+		frames++;
+	}
+	offset = 0;
+
+	while(offset < avail) {
+		frame_len = host_frame_length(&rxBuffer[offset], avail - offset);
+		if(frame_len == 0 && processed > 0) {
+			break;	// rest of a frame still on its way, keep it
+		}
+		if(frame_len <= 0) {
+	        // Send NACK, no frame start or a frame that stopped arriving, drop what's left
+			memset(&resp, 0, sizeof(resp));
+			resp.id = 0xFFFF;
+			resp.packet_type = OW_NAK;
+			comms_interface_send(&resp);
+			offset = avail;
+			break;
+		}
+
+		processed++;
+		host_rx_backlog_frames = frames - processed;
+		host_rx_backlog = avail - (offset + frame_len);
+		comms_host_start_relays(offset, avail);
+		comms_host_process_frame(&rxBuffer[offset], offset);
+		offset += frame_len;
+	}
+	if_relay_abandon();
+	host_relay_scanned = 0;
+
+	// results of no-ack relays still out, then every failure the host wants to hear about
+	if_relay_noack_settle();
+	while(cmd_noack_next_report(&resp)) {
+		comms_interface_send(&resp);
+	}
+
+	// carry the partial frame over to the front, the rest of it lands behind it
+	host_rx_backlog = avail - offset;
+	host_rx_backlog_frames = 0;
+	if(host_rx_backlog > 0) {
+		memmove(rxBuffer, &rxBuffer[offset], host_rx_backlog);
+	}
+
+	if(credit_reports_enabled){
+		comms_host_get_credit(&host_credit);
+		memset(&resp, 0, sizeof(resp));
+		resp.packet_type = OW_DATA;
+		resp.command = OW_CMD_CREDIT;
+		resp.data_len = sizeof(host_credit);
+		resp.data = (uint8_t *)&host_credit;
+		comms_interface_send(&resp);
+	}
+
+	// without a window the answers to one batch go out together
+	if(host_coalesce.window_us == 0) {
+		comms_interface_flush();
+	}
+
+	ptrReceive = 0;
 	rx_flag = 0;
-	CDC_ReceiveToIdle(rxBuffer, COMMAND_MAX_SIZE);
+	CDC_ContinueReceiveToIdle(rxBuffer, COMMAND_MAX_SIZE, host_rx_backlog);
+}
+
+static void comms_onewire_turnaround(void)
+{
+	uint32_t t0 = DWT->CYCCNT;
+	uint32_t cycles = (SystemCoreClock / 1000000U) * ONEWIRE_TURNAROUND_US;
+	while ((DWT->CYCCNT - t0) < cycles) { }
+}
+
+static void comms_onewire_callin_rearm(void)
+{
+	memset(owRxBuffer, 0, sizeof(owRxBuffer));
+    rx_ow_callin_flag = 0;
+    if(HAL_HalfDuplex_EnableReceiver(&CALL_IN_UART) != HAL_OK) {
+    	// Receive Error
+		Error_Handler();
+    }
+
+	if (HAL_UARTEx_ReceiveToIdle_IT(&CALL_IN_UART, owRxBuffer, COMMAND_MAX_SIZE) != HAL_OK) {
+		// Receive Error
+		Error_Handler();
+	}
+}
+
+// bytes a ReceiveToIdle_IT has put in the buffer so far
+static uint16_t onewire_rx_count(UART_HandleTypeDef *huart)
+{
+	return huart->RxXferSize - huart->RxXferCount;
+}
+
+static int32_t onewire_frame_length(const uint8_t *pBuffer)
+{
+	uint16_t data_len = (pBuffer[7] << 8 | (pBuffer[8] & 0xFF ));
+	if (pBuffer[0] != OW_START_BYTE || data_len > DATA_MAX_SIZE) {
+		return -1;
+	}
+	return data_len + 12;
+}
+
+/* Feed out whatever of the frame has landed in buf so far while in is still
+ * receiving it.  Starting with a header's worth buffered keeps the outgoing
+ * line busy, so the far end doesn't see an idle gap mid frame. */
+static bool onewire_stream(UART_HandleTypeDef *in, uint8_t *buf, UART_HandleTypeDef *out,
+						   volatile uint8_t *tx_done, uint16_t frame_len)
+{
+	uint16_t sent = 0;
+	uint32_t start_time = HAL_GetTick();
+
+	if(HAL_HalfDuplex_EnableTransmitter(out) != HAL_OK) {
+		return false;
+	}
+
+	while (sent < frame_len) {
+		uint16_t avail = onewire_rx_count(in);
+		if (avail > frame_len) avail = frame_len;
+
+		if (avail > sent) {
+			*tx_done = 0;
+			if (HAL_UART_Transmit_IT(out, &buf[sent], avail - sent) != HAL_OK) {
+				return false;
+			}
+			while (!*tx_done) {
+				if ((HAL_GetTick() - start_time) >= ONEWIRE_TIMEOUT) return false;
+			}
+			sent = avail;
+		} else if ((HAL_GetTick() - start_time) >= ONEWIRE_TIMEOUT) {
+			return false;	// sender stalled mid frame
+		}
+	}
+	return true;
+}
+
+/* Discovery packets for slaves further down the chain are passed on as they
+ * arrive instead of after a full receive/parse/re-serialize.  The CRC is
+ * still checked once the frame is complete and the downstream reply is
+ * streamed back up the same way.  Returns false if the frame isn't one to
+ * relay, leaving it to the normal path. */
+static bool comms_onewire_cut_through(void)
+{
+	int32_t frame_len;
+	int32_t reply_len = -1;
+	uint32_t start_time;
+	bool ok;
+
+	if (onewire_rx_count(&CALL_IN_UART) < ONEWIRE_HEADER_LEN || !get_configured() || get_module_ID() == 0) {
+		return false;
+	}
+	if (owRxBuffer[3] != OW_ONE_WIRE || owRxBuffer[4] != OW_CMD_DISCOVERY ||
+		(frame_len = onewire_frame_length(owRxBuffer)) < 0) {
+		return false;
+	}
+
+	ok = onewire_stream(&CALL_IN_UART, owRxBuffer, &CALL_OUT_UART, &tx_ow_callout_flag, frame_len);
+	if (ok) {
+		// reply lands in owTxBuffer, nothing else uses it until we're done
+		rx_ow_callout_flag = 0;
+		ok = HAL_HalfDuplex_EnableReceiver(&CALL_OUT_UART) == HAL_OK &&
+			 HAL_UARTEx_ReceiveToIdle_IT(&CALL_OUT_UART, owTxBuffer, COMMAND_MAX_SIZE) == HAL_OK;
+	}
+
+	// let our own receive close so the CRC can be checked
+	start_time = HAL_GetTick();
+	while (!rx_ow_callin_flag && (HAL_GetTick() - start_time) < ONEWIRE_TIMEOUT) { }
+
+	if (ok && rx_ow_callin_flag &&
+		util_crc16(&owRxBuffer[1], frame_len - 4) == (owRxBuffer[frame_len - 3] << 8 | owRxBuffer[frame_len - 2])) {
+		start_time = HAL_GetTick();
+		while (onewire_rx_count(&CALL_OUT_UART) < ONEWIRE_HEADER_LEN && !rx_ow_callout_flag &&
+			   (HAL_GetTick() - start_time) < ONEWIRE_TIMEOUT) { }
+		if (onewire_rx_count(&CALL_OUT_UART) >= ONEWIRE_HEADER_LEN) {
+			reply_len = onewire_frame_length(owTxBuffer);
+		}
+	}
+
+	if (reply_len > 0) {
+		onewire_stream(&CALL_OUT_UART, owTxBuffer, &CALL_IN_UART, &tx_ow_callin_flag, reply_len);
+	} else {
+		HAL_UART_AbortReceive(&CALL_OUT_UART);
+	    memset((void*)&ow_send_packet, 0, sizeof(ow_send_packet));
+		ow_send_packet.id = (owRxBuffer[1] << 8 | owRxBuffer[2]);
+		ow_send_packet.packet_type = ok && rx_ow_callin_flag ? OW_TIMEOUT : OW_ERROR;
+		comms_onewire_turnaround();
+		comms_callin_onewire_send(&ow_send_packet);
+	}
+
+	comms_onewire_callin_rearm();
+	return true;
 }
 
 void comms_onewire_check_received()
 {
     uint16_t calculated_crc;
 
-	if(!rx_ow_callin_flag) return;
+	if(!rx_ow_callin_flag) {
+		comms_onewire_cut_through();
+		return;
+	}
 
     memset((void*)&ow_send_packet, 0, sizeof(ow_send_packet));
     memset((void*)&ow_receive_packet, 0, sizeof(ow_receive_packet));
@@ -537,22 +929,12 @@ void comms_onewire_check_received()
 	process_if_command(&ow_receive_packet, &ow_send_packet);
 
 NextOneWirePacket:
-	HAL_Delay(1);
+	comms_onewire_turnaround();
 	if(!comms_callin_onewire_send(&ow_send_packet))
 	{
 		// printf("failed to send onewire response\r\n");
 	}
-	memset(owRxBuffer, 0, sizeof(owRxBuffer));
-    rx_ow_callin_flag = 0;
-    if(HAL_HalfDuplex_EnableReceiver(&CALL_IN_UART) != HAL_OK) {
-    	// Receive Error
-		Error_Handler();
-    }
-
-	if (HAL_UARTEx_ReceiveToIdle_IT(&CALL_IN_UART, owRxBuffer, COMMAND_MAX_SIZE) != HAL_OK) {
-		// Receive Error
-		Error_Handler();
-	}
+	comms_onewire_callin_rearm();
 }
 
 bool comms_onewire_slave_start()
@@ -606,58 +988,61 @@ bool configure_slave()
 #define BASE_I2C_ADDRESS 0x20   // Starting address for slaves
 #define MAX_SLAVES       6      // Maximum number of slaves in the chain
 
+uint8_t comms_onewire_discover(uint8_t position, uint8_t i2c_address)
+{
+    // Clear the send packet structure before use.
+    memset((void*)&ow_send_packet, 0, sizeof(ow_send_packet));
+
+    // Prepare the discovery message, configured slaves relay it until it
+    // reaches the first unconfigured one, which takes the position.
+    ow_send_packet.packet_type = OW_ONE_WIRE;
+    ow_send_packet.command = OW_CMD_DISCOVERY;
+    ow_send_packet.reserved = position;
+    ow_send_packet.addr = i2c_address;
+
+    if (!comms_callout_onewire_send(&ow_send_packet))
+    {
+        return OW_ERROR;
+    }
+
+    // Wait for a response.
+    comms_callout_onewire_receive(&ow_receive_packet);
+    return ow_receive_packet.packet_type;
+}
+
 bool enumerate_slaves()
 {
     uint8_t next_address = BASE_I2C_ADDRESS;
     uint8_t slave_count = 1;
+    uint8_t reply;
     bool bRet = true;
 
 	// register found slaves
 
     while(slave_count < MAX_SLAVES)
     {
-        // Clear the send packet structure before use.
-        memset((void*)&ow_send_packet, 0, sizeof(ow_send_packet));
-
-        // Prepare the discovery message.
-        ow_send_packet.packet_type = OW_ONE_WIRE;
-        ow_send_packet.command = OW_CMD_DISCOVERY;
-        ow_send_packet.reserved = slave_count;
-        ow_send_packet.addr = next_address;
-
-        // Send the discovery packet to the current slave.
-        if (comms_callout_onewire_send(&ow_send_packet))
-        {
-            // Wait for a response.
-            comms_callout_onewire_receive(&ow_receive_packet);
-
-			// Check for an error response.
-			if (ow_receive_packet.packet_type != OW_ERROR && ow_receive_packet.packet_type != OW_TIMEOUT)
-			{
-				//printf("Slave found at I2C address 0x%02X\r\n", next_address);
-				// Record the slave if necessary, e.g. store the address.
-				ModuleManager_AddSlave(next_address);
-				slave_count++;
-				next_address++;  // Move on to the next address.
-			}
-			else if (ow_receive_packet.packet_type == OW_TIMEOUT)
-			{
-				// OW_TIMEOUT means the chain ended — no more slaves
-				break;
-			}
-			else
-			{
-				//printf("Received error from slave at address 0x%02X\r\n", next_address);
-				bRet = false;
-	            break;
-			}
-        }
-        else
-        {
-            //printf("Transmission failed for slave at address 0x%02X\r\n", next_address);
-            bRet = false;
+        reply = comms_onewire_discover(slave_count, next_address);
+
+		// Check for an error response.
+		if (reply != OW_ERROR && reply != OW_TIMEOUT)
+		{
+			//printf("Slave found at I2C address 0x%02X\r\n", next_address);
+			// Record the slave if necessary, e.g. store the address.
+			ModuleManager_AddSlave(next_address);
+			slave_count++;
+			next_address++;  // Move on to the next address.
+		}
+		else if (reply == OW_TIMEOUT)
+		{
+			// OW_TIMEOUT means the chain ended — no more slaves
+			break;
+		}
+		else
+		{
+			//printf("Received error from slave at address 0x%02X\r\n", next_address);
+			bRet = false;
             break;
-        }
+		}
 
         HAL_Delay(50);
     }
@@ -701,9 +1086,14 @@ void comms_handle_ow_CallOut_TxCpltCallback(UART_HandleTypeDef *huart)
 }
 
 void CDC_handle_RxCpltCallback(uint16_t len) {
+	ptrReceive = len;
 	rx_flag = 1;
 }
 
+bool CDC_handle_RxFrameCheck(const uint8_t* Buf, uint16_t len) {
+	return Buf != NULL && host_frame_length(Buf, len) > 0;
+}
+
 void CDC_handle_TxCpltCallback() {
 	tx_flag = 1;
 }
@@ -743,6 +1133,14 @@ void pulsetrain_complete_callback(uint32_t curr_count, uint32_t total_count) {
 			abs(amb_temp_int % 10)
         );
 
+        // applied delay correction and what is left to go, in delay LSBs
+        if (len > 0 && len < sizeof(owDataBuffer) && tx_tcomp_get_status()->enabled) {
+            len += snprintf((char*)owDataBuffer + len, sizeof(owDataBuffer) - len,
+                ",TCOMP:%d,TCOMP_ERR:%d",
+                tx_tcomp_get_status()->max_offset,
+                tx_tcomp_get_status()->max_error);
+        }
+
         if (len < 0 || len >= sizeof(owDataBuffer)) {
             // Handle truncation or error
             len = 0;
@@ -763,6 +1161,8 @@ void pulsetrain_complete_callback(uint32_t curr_count, uint32_t total_count) {
 // STATUS:RUNNING,MODE:SEQUENCE,PULSE_TRAIN:[2/5],PULSE:[3/10],TEMP_TX:32.6,TEMP_AMBIENT:29.1
 void sequence_complete_callback(uint32_t total_count) {
 
+	cmd_macro_event(CMD_MACRO_EVT_SEQ_DONE);
+
 	if(async_enabled){
 
 		int tx_temp_int = (int)(tx_temperature * 10);  // e.g. 32.6 → 326
@@ -45,8 +45,11 @@ const uint16_t crc16_tab[256] = {
 };
 
 uint16_t util_crc16(const uint8_t* buf, uint32_t size) {
-	uint16_t crc = 0xFFFF;
+	return util_crc16_update(0xFFFF, buf, size);
+}
 
+// continue a util_crc16 over data that arrives in pieces
+uint16_t util_crc16_update(uint16_t crc, const uint8_t* buf, uint32_t size) {
 	for (int i = 0; i < size; i++) {
 		uint8_t byte = buf[i];
 		crc = (crc<<8) ^ crc16_tab[(crc>>8)^byte];
@@ -62,6 +65,12 @@ uint16_t util_hw_crc16(uint8_t* buf, uint32_t size)
 	return (uint16_t)uwCRCValue;
 }
 
+// CRC-32/MPEG-2 (poly 0x04C11DB7, init 0xFFFFFFFF, no reflection) on the CRC unit
+uint32_t util_hw_crc32(const uint8_t* buf, uint32_t size)
+{
+	return HAL_CRC_Calculate(&hcrc, (uint32_t *)buf, size);
+}
+
 void get_unique_identifier(uint32_t* uid)
 {
     uid[0] = HAL_GetUIDw0();
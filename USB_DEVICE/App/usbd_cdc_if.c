@@ -23,7 +23,7 @@
 
 /* USER CODE BEGIN INCLUDE */
 #include "uart_comms.h"
-
+#include <string.h>
 
 /* USER CODE END INCLUDE */
 
@@ -40,6 +40,16 @@ volatile uint16_t rxIndex = 0;
 volatile uint16_t rxMaxSize = 0;
 uint8_t* pRX = 0;
 
+/* OUT data left un-armed because there was no room for it (endpoint NAKs).
+   It is copied out of the receive buffer: with the double-buffered endpoint a
+   packet already in the other PMA buffer still completes into the same Buf.
+   The HAL only NAKs once a whole packet size has been counted, so the packet
+   that gets there plus the one behind it is the most that can arrive. */
+static volatile uint8_t rx_held = 0;
+static uint8_t rx_held_buf[3 * CDC_DATA_FS_OUT_PACKET_SIZE];
+static uint16_t rx_held_len = 0;
+/* bytes the HAL has counted since the endpoint was last armed, *Len is cumulative */
+static uint16_t rx_armed_count = 0;
 
 /* USER CODE END PV */
 
@@ -138,6 +148,11 @@ static int8_t CDC_TransmitCplt_FS(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
 static int8_t CDC_TransmitCplt_FS(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
+static uint8_t CDC_Append(uint8_t* Buf, uint16_t len);
+static void CDC_RxProgress(void);
+
+extern void CDC_handle_RxCpltCallback(uint16_t len);
+extern bool CDC_handle_RxFrameCheck(const uint8_t* Buf, uint16_t len);
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -165,6 +180,9 @@ static int8_t CDC_Init_FS(void)
   /* Set Application Buffers */
   USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, 0);
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+  rx_held = 0;
+  rx_held_len = 0;
+  rx_armed_count = 0;
   return (USBD_OK);
   /* USER CODE END 3 */
 }
@@ -273,32 +291,39 @@ static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
   /* USER CODE BEGIN 6 */
   USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
 
-  uint8_t len = (uint8_t) *Len; // Get length
-  uint16_t tempHeadPos = rxIndex;
+  // only the newest packet is in Buf, the HAL counts from the last arm
+  uint16_t len = (uint16_t)(*Len - rx_armed_count);
 
   if(read_to_idle_enabled == 1){
-	  // Restart timer when data is received
 	  HAL_TIM_Base_Stop_IT(&CDC_TIMER);
-	__HAL_TIM_SET_COUNTER(&CDC_TIMER, 0); // Reset the timer counter
-
-	  if(pRX){
-		  for (uint32_t i = 0; i < len; i++) {
-			pRX[tempHeadPos] = Buf[i];
-			tempHeadPos = (uint16_t)((uint16_t)(tempHeadPos + 1) % rxMaxSize);
-
-			if (tempHeadPos == rxIndex) {
-			  return USBD_FAIL;
-			}
-		  }
+	  if(pRX != 0 && (uint32_t)rxIndex + len <= rxMaxSize){
+		  // re-arm first: the next packet lands in the other PMA buffer while
+		  // this one is copied, Buf itself is only refilled from this same ISR
+		  rx_armed_count = 0;
+		  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+		  CDC_Append(Buf, len);
+		  CDC_RxProgress();
+		  return (USBD_OK);
 	  }
-	  rxIndex = tempHeadPos;
-	  HAL_TIM_Base_Start_IT(&CDC_TIMER);
+	  // buffer is full, hand what we have to the parser before holding this one
+	  read_to_idle_enabled = 0;
+	  CDC_handle_RxCpltCallback(rxIndex);
   }
 
   if(receive_to_idle_cancelled == 1){
 	  receive_to_idle_cancelled = 0;
   }
-  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+
+  // Not ready for it: copy the packet aside and leave the endpoint NAKing the
+  // host until CDC_ContinueReceiveToIdle picks it up.  A packet already in the
+  // other PMA buffer is written over Buf[0] and comes back here with the
+  // combined length, it is appended behind this one.
+  if((uint32_t)rx_held_len + len <= sizeof(rx_held_buf)){
+	  memcpy(&rx_held_buf[rx_held_len], Buf, len);
+	  rx_held_len += len;
+  }
+  rx_armed_count += len;
+  rx_held = 1;
   return (USBD_OK);
   /* USER CODE END 6 */
 }
@@ -356,14 +381,73 @@ static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
 
 void CDC_FlushRxBuffer_FS() {
 	USBD_LL_FlushEP(&hUsbDeviceFS, CDC_OUT_EP);
+	if(rx_held){
+		// drop the stale packet but give the endpoint back to the host
+		rx_held = 0;
+		rx_held_len = 0;
+		rx_armed_count = 0;
+		USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+	}
+}
+
+static uint8_t CDC_Append(uint8_t* Buf, uint16_t len)
+{
+	if(pRX == 0 || (uint32_t)rxIndex + len > rxMaxSize){
+		return 0;
+	}
+	memcpy(&pRX[rxIndex], Buf, len);
+	rxIndex += len;
+	return 1;
+}
+
+static void CDC_RxProgress(void)
+{
+	if(CDC_handle_RxFrameCheck(pRX, rxIndex)){
+		// a whole frame is buffered, no need to wait for the line to go idle
+		HAL_TIM_Base_Stop_IT(&CDC_TIMER);
+		read_to_idle_enabled = 0;
+		CDC_handle_RxCpltCallback(rxIndex);
+		return;
+	}
+	// Restart timer when data is received
+	__HAL_TIM_SET_COUNTER(&CDC_TIMER, 0);
+	HAL_TIM_Base_Start_IT(&CDC_TIMER);
 }
 
 void CDC_ReceiveToIdle(uint8_t* Buf, uint16_t max_size)
 {
-    rxIndex = 0;
+	CDC_ContinueReceiveToIdle(Buf, max_size, 0);
+}
+
+void CDC_ContinueReceiveToIdle(uint8_t* Buf, uint16_t max_size, uint16_t offset)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+    rxIndex = offset;
     rxMaxSize = max_size;
     pRX = Buf;
 	read_to_idle_enabled = 1;
+
+	if(rx_held){
+		if(CDC_Append(rx_held_buf, rx_held_len)){
+			rx_held = 0;
+			rx_held_len = 0;
+			rx_armed_count = 0;
+			USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+			CDC_RxProgress();
+		}else{
+			// still no room, let the parser drain what is there first
+			read_to_idle_enabled = 0;
+			CDC_handle_RxCpltCallback(rxIndex);
+		}
+	}else if(offset > 0){
+		// partial frame carried over, give the rest of it the usual idle window
+		__HAL_TIM_SET_COUNTER(&CDC_TIMER, 0);
+		HAL_TIM_Base_Start_IT(&CDC_TIMER);
+	}
+
+	__set_PRIMASK(primask);
 }
 
 void CDC_Stop_ReceiveToIdle()
@@ -373,7 +457,6 @@ void CDC_Stop_ReceiveToIdle()
 	read_to_idle_enabled = 0;
 }
 
-extern void CDC_handle_RxCpltCallback(uint16_t len);
 void CDC_Idle_Timer_Handler()
 {
 	read_to_idle_enabled = 0;
@@ -74,6 +74,10 @@
 #define USBD_LPM_ENABLED     1U
 /*---------- -----------*/
 #define USBD_SELF_POWERED     1U
+/*---------- -----------*/
+/* CDC data IN on EP3 instead of EP1: a double buffered endpoint takes both
+ * halves of its EPnR, so data OUT and data IN need an endpoint number each */
+#define CDC_IN_EP     0x83U
 
 /****************************************/
 /* #define for FS and HS identification */
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""Build and send a block level delta / compressed firmware update.
+
+The device splits its image in FW_UPD_BLOCK_SIZE blocks. Blocks that are
+unchanged against the running image (identified by FW_SHA) are sent as COPY
+(no payload), everything else as RLE or RAW, whichever is smaller. See
+Core/Inc/fw_update.h for the wire format.
+
+On A/B builds the update goes to the slot that is not running, so the image
+has to be linked for that slot (FW_SLOT=A or B); the device reports which
+one in FW_UPD_INFO and the image's reset vector is checked against it.
+--activate then resets the module into the new slot on trial.
+
+    fw_delta.py new.bin --base old.bin --base-sha abc1234 --new-sha def5678
+    fw_delta.py new.bin --base old.bin ... --port /dev/ttyACM0 [--module 1] [--activate]
+"""
+
+import argparse
+import struct
+import sys
+
+BLOCK_SIZE = 1024
+SHA_LEN = 41
+SLOT_SIZE = 88 * 1024
+
+OW_CMD = 0xE2
+OW_ERROR = 0xEF
+OW_CMD_FW_UPDATE = 0x0B
+OW_CMD_RESET = 0x0F
+
+FW_UPD_INFO, FW_UPD_BEGIN, FW_UPD_BLOCK, FW_UPD_COMMIT, FW_UPD_ACTIVATE = 0, 2, 3, 4, 6
+INFO_FMT = "<IIIHHB%dsIIIB" % SHA_LEN
+FW_BLK_COPY, FW_BLK_RAW, FW_BLK_RLE = 0, 1, 2
+
+
+def crc32_mpeg2(data):
+    crc = 0xFFFFFFFF
+    for b in data:
+        crc ^= b << 24
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else (crc << 1)
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+def crc16_ccitt(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def rle_encode(data):
+    out = bytearray()
+    lit = bytearray()
+    i = 0
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and data[i + run] == data[i] and run < 130:
+            run += 1
+        if run >= 3:
+            if lit:
+                out += bytes([len(lit) - 1]) + lit
+                lit = bytearray()
+            out += bytes([0x80 + run - 3, data[i]])
+            i += run
+        else:
+            lit.append(data[i])
+            i += 1
+            if len(lit) == 128:
+                out += bytes([len(lit) - 1]) + lit
+                lit = bytearray()
+    if lit:
+        out += bytes([len(lit) - 1]) + lit
+    return bytes(out)
+
+
+def plan(new, base):
+    blocks = []
+    base_blocks = {}
+    if base:
+        for j in range(0, len(base), BLOCK_SIZE):
+            base_blocks.setdefault(base[j:j + BLOCK_SIZE], j // BLOCK_SIZE)
+    for idx in range(0, (len(new) + BLOCK_SIZE - 1) // BLOCK_SIZE):
+        blk = new[idx * BLOCK_SIZE:(idx + 1) * BLOCK_SIZE]
+        crc = crc32_mpeg2(blk)
+        if base and base[idx * BLOCK_SIZE:idx * BLOCK_SIZE + len(blk)] == blk:
+            blocks.append((idx, FW_BLK_COPY, b"", crc))
+        elif base and blk in base_blocks and len(blk) == BLOCK_SIZE:
+            blocks.append((idx, FW_BLK_COPY, struct.pack("<H", base_blocks[blk]), crc))
+        else:
+            rle = rle_encode(blk)
+            if len(rle) < len(blk):
+                blocks.append((idx, FW_BLK_RLE, rle, crc))
+            else:
+                blocks.append((idx, FW_BLK_RAW, blk, crc))
+    return blocks
+
+
+class Link:
+    def __init__(self, port):
+        import serial
+        self.ser = serial.Serial(port, 921600, timeout=2)
+        self.pkt_id = 0
+
+    def request(self, command, addr, reserved, data=b""):
+        self.pkt_id = (self.pkt_id + 1) & 0xFFFF
+        body = struct.pack(">HBBBBH", self.pkt_id, OW_CMD, command, addr, reserved, len(data)) + data
+        self.ser.write(b"\xAA" + body + struct.pack(">H", crc16_ccitt(body)) + b"\xDD")
+        hdr = self.ser.read(9)
+        if len(hdr) != 9 or hdr[0] != 0xAA:
+            raise IOError("no response")
+        length = struct.unpack(">H", hdr[7:9])[0]
+        rest = self.ser.read(length + 3)
+        return hdr[3], rest[:length]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("image")
+    ap.add_argument("--base", help="binary of the running image (enables COPY blocks)")
+    ap.add_argument("--base-sha", default="")
+    ap.add_argument("--new-sha", default="")
+    ap.add_argument("--port")
+    ap.add_argument("--module", type=int, default=0)
+    ap.add_argument("--reset", action="store_true", help="reset the module after commit")
+    ap.add_argument("--activate", action="store_true", help="reset into the committed image (trial boot on A/B builds)")
+    args = ap.parse_args()
+
+    new = open(args.image, "rb").read()
+    base = open(args.base, "rb").read() if args.base else b""
+    if base and not args.base_sha:
+        sys.exit("--base needs --base-sha")
+
+    blocks = plan(new, base)
+    wire = sum(len(p) + 8 for _, _, p, _ in blocks)
+    kinds = {k: sum(1 for b in blocks if b[1] == k) for k in (FW_BLK_COPY, FW_BLK_RAW, FW_BLK_RLE)}
+    print("%d blocks: %d copy, %d rle, %d raw; %d bytes on the wire (image %d)" %
+          (len(blocks), kinds[FW_BLK_COPY], kinds[FW_BLK_RLE], kinds[FW_BLK_RAW], wire, len(new)))
+
+    if not args.port:
+        return
+
+    link = Link(args.port)
+    ptype, info = link.request(OW_CMD_FW_UPDATE, args.module, FW_UPD_INFO)
+    if ptype != OW_ERROR and len(info) >= struct.calcsize(INFO_FMT):
+        running_base, target_base, running_seq, ab_slots = struct.unpack_from(INFO_FMT, info)[6:10]
+        reset_vector = struct.unpack_from("<I", new, 4)[0] & ~1
+        print("running 0x%08X (seq %d), update goes to 0x%08X" % (running_base, running_seq, target_base))
+        if ab_slots and not target_base <= reset_vector < target_base + SLOT_SIZE:
+            sys.exit("image is linked for 0x%08X, build it for the slot at 0x%08X" % (reset_vector, target_base))
+    begin = struct.pack("<II", len(new), crc32_mpeg2(new))
+    begin += args.base_sha.encode().ljust(SHA_LEN, b"\0")[:SHA_LEN]
+    begin += args.new_sha.encode().ljust(SHA_LEN, b"\0")[:SHA_LEN]
+    if link.request(OW_CMD_FW_UPDATE, args.module, FW_UPD_BEGIN, begin)[0] == OW_ERROR:
+        sys.exit("begin rejected (base sha mismatch?)")
+    for idx, enc, payload, crc in blocks:
+        data = struct.pack("<HBBI", idx, enc, 0, crc) + payload
+        if link.request(OW_CMD_FW_UPDATE, args.module, FW_UPD_BLOCK, data)[0] == OW_ERROR:
+            sys.exit("block %d rejected" % idx)
+    if link.request(OW_CMD_FW_UPDATE, args.module, FW_UPD_COMMIT)[0] == OW_ERROR:
+        sys.exit("commit rejected")
+    print("committed")
+    if args.activate:
+        if link.request(OW_CMD_FW_UPDATE, args.module, FW_UPD_ACTIVATE)[0] == OW_ERROR:
+            sys.exit("activate rejected")
+    elif args.reset:
+        link.request(OW_CMD_RESET, args.module, 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,268 @@
+#!/usr/bin/env python3
+"""Host accuracy check of Core/Src/fx_math.c against double precision.
+
+Builds fx_math.c with the host C compiler, the CMSIS intrinsics it uses
+(CLZ, SSAT, QADD16) given plain C stand-ins, and runs every Q16 routine
+over random arguments spread across its whole input range: bit length
+first, then the bits.  --exhaustive runs the single argument routines over
+every argument instead (about three minutes).  The worst error of each is
+compared with the bound documented in Core/Inc/fx_math.h.  The channel
+array routines are checked for exact agreement with a saturating scalar
+reference.  The thermistor conversion is run over every ADC code against
+the double beta equation.
+
+    fx_math_check.py [--count 20000000] [--seed 1] [--exhaustive] [--cc gcc]
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# name: (LSB bound, relative bound), from fx_math.h
+BOUNDS = {
+    "fx_div_q16": (0.5, 0.0),
+    "fx_recip_q16": (0.5, 0.0),
+    "fx_log2_q16": (0.50004, 0.0),
+    "fx_ln_q16": (0.85, 0.0),
+    "fx_exp2_q16": (0.5, 3e-9),
+    "fx_exp_q16": (0.5, 5e-9),
+    "fx_sqrt_q16": (1.0, 0.0),
+}
+THERM_BOUND_C = 0.0016
+
+STUB_MAIN_H = """
+#ifndef MAIN_H_STUB
+#define MAIN_H_STUB
+#include <stdint.h>
+static inline uint32_t __CLZ(uint32_t x) { return x ? __builtin_clz(x) : 32; }
+static inline int32_t __SSAT(int32_t v, int bits)
+{
+	int32_t hi = (1 << (bits - 1)) - 1, lo = -hi - 1;
+	return v > hi ? hi : v < lo ? lo : v;
+}
+static inline uint32_t __QADD16(uint32_t a, uint32_t b)
+{
+	int32_t lo = __SSAT((int16_t)a + (int16_t)b, 16);
+	int32_t hi = __SSAT((int16_t)(a >> 16) + (int16_t)(b >> 16), 16);
+	return (uint16_t)lo | ((uint32_t)(uint16_t)hi << 16);
+}
+#endif
+"""
+
+HARNESS_C = r"""
+#include "fx_math.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint64_t rng;
+
+static uint32_t next(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return (uint32_t)(rng >> 32);
+}
+
+// a positive Q16 raw value whose bit length is uniform over 1..31
+static int32_t spread(void)
+{
+	int bits = 1 + next() % 31;
+	uint32_t v = next() & ((1U << bits) - 1);
+	return (int32_t)(v | (1U << (bits - 1)));
+}
+
+static int32_t spread_signed(void)
+{
+	return (next() & 1) ? -spread() : spread();
+}
+
+typedef struct {
+	const char *name;
+	double worst;		// LSB, after the relative term is taken off
+	long faults;		// results that break the documented behaviour outright
+} stat_t;
+
+static void err(stat_t *s, double got, double want, double rel)
+{
+	double e = fabs(got - want) - rel * fabs(want);
+	if (e > s->worst) s->worst = e;
+}
+
+static void report(const stat_t *s)
+{
+	printf("%s %.6f %ld\n", s->name, s->worst, s->faults);
+}
+
+static stat_t dv = {"fx_div_q16"}, recip = {"fx_recip_q16"}, lg2 = {"fx_log2_q16"}, ln = {"fx_ln_q16"};
+static stat_t ex2 = {"fx_exp2_q16"}, ex = {"fx_exp_q16"}, sq = {"fx_sqrt_q16"};
+static stat_t vec = {"vector"}, therm = {"thermistor"};
+
+// exp2 is finite below 2^15 and taken as 0 below 2^-17, exp the same in e
+#define EXP2_LO		(-17 << 16)
+#define EXP2_HI		(15 << 16)
+#define EXP_LO		(-787000)
+#define EXP_HI		681391
+
+// x > 0
+static void check_x(int32_t x)
+{
+	int32_t s = fx_sqrt_q16(x);
+	double want = sqrt(x / 65536.0) * 65536.0;
+
+	err(&lg2, fx_log2_q16(x), log2(x / 65536.0) * 65536.0, 0);
+	err(&ln, fx_ln_q16(x), log(x / 65536.0) * 65536.0, 0);
+	if (fx_log2_q16(-x) != FX_Q16_MIN || fx_ln_q16(-x) != FX_Q16_MIN) lg2.faults++;
+
+	if (s > want + 1e-9) sq.faults++;	// floor
+	err(&sq, s, want, 0);
+	if (fx_isqrt_u32((uint32_t)x) != (uint32_t)floor(sqrt((double)(uint32_t)x))) sq.faults++;
+}
+
+// b != 0
+static void check_recip(int32_t b)
+{
+	double want = 4294967296.0 / b;
+	if (fabs(want) < 2147483647.0) err(&recip, fx_recip_q16(b), want, 0);
+}
+
+static void check_exp2(int32_t e)
+{
+	err(&ex2, fx_exp2_q16(e), exp2(e / 65536.0) * 65536.0, BOUNDS_EXP2_REL);
+}
+
+static void check_exp(int32_t e)
+{
+	err(&ex, fx_exp_q16(e), exp(e / 65536.0) * 65536.0, BOUNDS_EXP_REL);
+}
+
+int main(int argc, char **argv)
+{
+	long count = atol(argv[1]);
+	int exhaustive = atoi(argv[3]);
+
+	rng = 0x9E3779B97F4A7C15ULL * (uint64_t)atol(argv[2]) | 1;
+
+	for (long i = 0; i < count; i++) {
+		int32_t a = spread_signed(), b = spread_signed(), x = spread();
+		double want = (double)a / b * 65536.0;
+
+		if (fabs(want) < 2147483647.0) err(&dv, fx_div_q16(a, b), want, 0);
+		else if (fx_div_q16(a, b) != (want > 0 ? FX_Q16_MAX : FX_Q16_MIN)) dv.faults++;
+		if (fx_exp2_q16(EXP2_HI + (x & 0xFFFFF)) != FX_Q16_MAX) ex2.faults++;
+
+		if (!exhaustive) {
+			check_x(x);
+			check_recip(b);
+			check_exp2(EXP2_LO + (int32_t)(next() % (uint32_t)(EXP2_HI - EXP2_LO)));
+			check_exp(EXP_LO + (int32_t)(next() % (uint32_t)(EXP_HI - EXP_LO)));
+		}
+	}
+	if (exhaustive) {
+		for (int64_t x = 1; x <= 0x7FFFFFFF; x++) {
+			check_x((int32_t)x);
+			check_recip((int32_t)x);
+			check_recip((int32_t)-x);
+		}
+		for (int32_t e = EXP2_LO; e < EXP2_HI; e++) check_exp2(e);
+		for (int32_t e = EXP_LO; e < EXP_HI; e++) check_exp(e);
+	}
+
+	// channel arrays against a saturating scalar sum/product, odd length for the tail
+	for (long i = 0; i < count / 1000 + 1; i++) {
+		q15_t p[33], q[33], out[33];
+		q15_t off = (q15_t)next(), scale = (q15_t)next(), lo = (q15_t)next(), hi = (q15_t)next();
+		uint8_t shift = next() % 17;
+		int sh = 15 - (shift > 15 ? 15 : shift);
+		for (int k = 0; k < 33; k++) { p[k] = (q15_t)next(); q[k] = (q15_t)next(); }
+		fx_vadd_q15(p, q, out, 33);
+		for (int k = 0; k < 33; k++) if (out[k] != (q15_t)fmax(-32768, fmin(32767, p[k] + q[k]))) vec.faults++;
+		fx_voffset_q15(p, off, out, 33);
+		for (int k = 0; k < 33; k++) if (out[k] != (q15_t)fmax(-32768, fmin(32767, p[k] + off))) vec.faults++;
+		fx_vscale_q15(p, scale, shift, out, 33);
+		for (int k = 0; k < 33; k++) {
+			double w = floor(((double)p[k] * scale + (sh ? ldexp(1, sh - 1) : 0)) / ldexp(1, sh));
+			if (out[k] != (q15_t)fmax(-32768, fmin(32767, w))) vec.faults++;
+		}
+		fx_vclamp_q15(p, lo, hi, out, 33);
+		for (int k = 0; k < 33; k++) if (out[k] != (p[k] < lo ? lo : p[k] > hi ? hi : p[k])) vec.faults++;
+	}
+
+	// Thermistor_ReadTemperatureQ16 for a 10k pull-up, every code between the rails
+	{
+		const double beta = 3380.0, t0 = 298.15;
+		q16_t beta_q16 = FX_Q16(3380.0), t0_q16 = FX_Q16(298.15), kelvin_q16 = FX_Q16(273.15);
+		int32_t bt0_q10 = (int32_t)(beta * t0 * 1024.0 + 0.5);
+		q16_t ln_pullup = fx_ln_q16(FX_Q16_ONE);
+		for (int code = 1; code < 4095; code++) {
+			q16_t l = ln_pullup + fx_ln_q16(FX_Q16_INT(code)) - fx_ln_q16(FX_Q16_INT(4095 - code));
+			q16_t den = beta_q16 + fx_mul_q16(t0_q16, l);
+			double r = (double)code / (4095 - code);
+			double want = beta * t0 / (beta + t0 * log(r)) - 273.15;
+			if (den <= 0) { therm.faults++; continue; }
+			err(&therm, fx_q16_to_float(fx_div_q16(bt0_q10, den >> 6) - kelvin_q16), want, 0);
+		}
+	}
+
+	report(&dv); report(&recip); report(&lg2); report(&ln);
+	report(&ex2); report(&ex); report(&sq); report(&vec); report(&therm);
+	return 0;
+}
+"""
+
+
+def build(cc, tmp):
+    for src in ("Core/Inc/fx_math.h", "Core/Src/fx_math.c"):
+        shutil.copy(os.path.join(ROOT, src), tmp)
+    with open(os.path.join(tmp, "main.h"), "w") as f:
+        f.write(STUB_MAIN_H)
+    with open(os.path.join(tmp, "harness.c"), "w") as f:
+        f.write(HARNESS_C.replace("BOUNDS_EXP2_REL", repr(BOUNDS["fx_exp2_q16"][1]))
+                         .replace("BOUNDS_EXP_REL", repr(BOUNDS["fx_exp_q16"][1])))
+    exe = os.path.join(tmp, "harness")
+    subprocess.run([cc, "-std=c11", "-Wall", "-O2", "-I", tmp, "-o", exe,
+                    os.path.join(tmp, "harness.c"), os.path.join(tmp, "fx_math.c"), "-lm"], check=True)
+    return exe
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--count", type=int, default=20000000, help="random arguments per routine")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--exhaustive", action="store_true", help="every argument of the single argument routines")
+    parser.add_argument("--cc", default=os.environ.get("CC", "cc"), help="host C compiler")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        out = subprocess.run([build(args.cc, tmp), str(args.count), str(args.seed),
+                              "1" if args.exhaustive else "0"],
+                             capture_output=True, text=True, check=True).stdout
+
+    failures = 0
+    for line in out.splitlines():
+        name, worst, faults = line.split()
+        worst, faults = float(worst), int(faults)
+        if name in BOUNDS:
+            bound, rel = BOUNDS[name]
+            ok = worst <= bound and faults == 0
+            limit = "%g LSB" % bound + (" + %g relative" % rel if rel else "")
+            print("%-14s worst %.5f LSB  bound %s  %s" % (name, worst, limit, "ok" if ok else "FAIL"))
+        elif name == "thermistor":
+            ok = worst <= THERM_BOUND_C and faults == 0
+            print("%-14s worst %.5f C over every ADC code  bound %.4f C  %s" %
+                  (name, worst, THERM_BOUND_C, "ok" if ok else "FAIL"))
+        else:
+            ok = faults == 0
+            print("%-14s %d mismatches  %s" % (name, faults, "ok" if ok else "FAIL"))
+        failures += 0 if ok else 1
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Run the on-device PC sampler and attribute the samples to functions.
+
+The device counts interrupted PCs in PC_SAMPLE_BINS bins of 2^shift bytes
+from base (see Core/Inc/pc_sampler.h).  Each bin is shared out between the
+functions it overlaps, in proportion to the bytes of each inside it, using
+the symbol table of the ELF the device is running (read with nm).
+
+    pc_profile.py build/lifu-transmitter-fw.elf --port /dev/ttyACM0 --seconds 10
+    pc_profile.py fw.elf --port /dev/ttyACM0 --rate 5000 --base 0x08012000 --shift 2
+    pc_profile.py fw.elf --port /dev/ttyACM0 --dump-only     # histogram of a run still going
+"""
+
+import argparse
+import bisect
+import struct
+import subprocess
+import sys
+import time
+
+OW_CONTROLLER = 0xEA
+OW_RESP = 0xE3
+OW_CTRL_PROFILE = 0x1E
+
+PC_SAMPLE_OP_STATUS, PC_SAMPLE_OP_START, PC_SAMPLE_OP_STOP, PC_SAMPLE_OP_DUMP = 0, 1, 2, 3
+STATUS_FMT = "<BBHIIIII"
+
+
+def crc16_ccitt(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+class Link:
+    def __init__(self, port):
+        import serial
+        self.ser = serial.Serial(port, 921600, timeout=2)
+        self.pkt_id = 0
+
+    def request(self, addr, reserved, data=b""):
+        self.pkt_id = (self.pkt_id + 1) & 0xFFFF
+        body = struct.pack(">HBBBBH", self.pkt_id, OW_CONTROLLER, OW_CTRL_PROFILE, addr, reserved, len(data)) + data
+        self.ser.write(b"\xAA" + body + struct.pack(">H", crc16_ccitt(body)) + b"\xDD")
+        hdr = self.ser.read(9)
+        if len(hdr) != 9 or hdr[0] != 0xAA:
+            raise IOError("no response")
+        length = struct.unpack(">H", hdr[7:9])[0]
+        rest = self.ser.read(length + 3)
+        if hdr[3] != OW_RESP:
+            raise IOError("profiler request %d refused" % reserved)
+        return rest[:length]
+
+
+def status(link, module):
+    keys = ("running", "shift", "bins", "base", "rate_hz", "samples", "outside", "in_handler")
+    return dict(zip(keys, struct.unpack(STATUS_FMT, link.request(module, PC_SAMPLE_OP_STATUS))))
+
+
+def dump(link, module, nbins):
+    bins = []
+    while len(bins) < nbins:
+        data = link.request(module, PC_SAMPLE_OP_DUMP, struct.pack("<H", len(bins)))
+        if not data:
+            break
+        bins += struct.unpack("<%dH" % (len(data) // 2), data)
+    return bins[:nbins]
+
+
+def load_symbols(elf, nm):
+    out = subprocess.run([nm, "-n", "-S", "--defined-only", elf], check=True,
+                         capture_output=True, text=True).stdout
+    syms = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 4 and parts[2] in "tTwW":
+            addr, size = int(parts[0], 16) & ~1, int(parts[1], 16)
+            if size:
+                syms.append((addr, addr + size, parts[3]))
+    syms.sort()
+    return syms
+
+
+def attribute(bins, base, shift, syms):
+    starts = [s[0] for s in syms]
+    totals = {}
+    width = 1 << shift
+    for i, count in enumerate(bins):
+        if not count:
+            continue
+        lo = base + i * width
+        hi = lo + width
+        j = max(bisect.bisect_right(starts, lo) - 1, 0)
+        shares = []
+        while j < len(syms) and syms[j][0] < hi:
+            overlap = min(hi, syms[j][1]) - max(lo, syms[j][0])
+            if overlap > 0:
+                shares.append((syms[j][2], overlap))
+            j += 1
+        covered = sum(o for _, o in shares)
+        if not covered:
+            totals["<0x%08x>" % lo] = totals.get("<0x%08x>" % lo, 0) + count
+            continue
+        for name, o in shares:
+            totals[name] = totals.get(name, 0) + count * o / covered
+    return totals
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("elf")
+    ap.add_argument("--port", required=True)
+    ap.add_argument("--module", type=int, default=0)
+    ap.add_argument("--seconds", type=float, default=10.0)
+    ap.add_argument("--rate", type=int, default=0, help="samples per second, 0 for the device default")
+    ap.add_argument("--base", type=lambda v: int(v, 0), default=0, help="first address binned, 0 for the image start")
+    ap.add_argument("--shift", type=int, default=0, help="log2 bytes per bin, 0 to fit the image")
+    ap.add_argument("--dump-only", action="store_true", help="read the current histogram, don't start or stop")
+    ap.add_argument("--top", type=int, default=25)
+    ap.add_argument("--nm", default="arm-none-eabi-nm")
+    args = ap.parse_args()
+
+    syms = load_symbols(args.elf, args.nm)
+    link = Link(args.port)
+
+    if not args.dump_only:
+        link.request(args.module, PC_SAMPLE_OP_START, struct.pack("<IIB", args.rate, args.base, args.shift))
+        time.sleep(args.seconds)
+        link.request(args.module, PC_SAMPLE_OP_STOP)
+
+    st = status(link, args.module)
+    bins = dump(link, args.module, st["bins"])
+    if not st["samples"]:
+        sys.exit("no samples")
+
+    print("%d samples at %d Hz, bins of %d bytes from 0x%08x; %d outside the window, %d in handlers" %
+          (st["samples"], st["rate_hz"], 1 << st["shift"], st["base"], st["outside"], st["in_handler"]))
+    if max(bins) == 0xFFFF:
+        print("note: some bins saturated, shorten the run or lower the rate")
+
+    totals = attribute(bins, st["base"], st["shift"], syms)
+    for name, count in sorted(totals.items(), key=lambda kv: -kv[1])[:args.top]:
+        print("%6.2f%%  %8.1f  %s" % (100.0 * count / st["samples"], count, name))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,231 @@
+#!/usr/bin/env python3
+"""Host check of tx_pattern_synthesize() against the demo register table.
+
+Builds Core/Src/tx_pattern.c with the host C compiler, against a stub of
+the TX7332 driver, and compares the profile it synthesizes for a 1 MHz
+single cycle descriptor with profile 0 (0x120-0x127) of reg_1mhz_3p_values
+in Core/Src/demo.c.  A few other descriptors are decoded segment by
+segment and checked for length, polarity and rejection, and each one is
+applied to check the channel power down word written with it.
+
+    tx_pattern_check.py [--cc gcc]
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+CLK_HZ = 192000000
+PROFILE_BASE = 0x120
+PROFILE_WORDS = 8
+SEG_MIN_CLKS = 2
+LEVEL_GND, LEVEL_LOW, LEVEL_HIGH, LEVEL_END = 0, 1, 2, 7
+FLAG_INVERT, FLAG_APOD = 0x01, 0x02
+PDN_REG = 0x1A
+
+# the real tx7332.h pulls in the HAL, tx_pattern.c only needs these.
+# Single register writes are kept for the harness to report.
+STUB_TX7332_H = """
+#ifndef TI7332_H
+#define TI7332_H
+#include <stdint.h>
+#include <stdbool.h>
+typedef struct TX7332 { int unused; } TX7332;
+extern int stub_pdn_writes;
+extern uint32_t stub_pdn_value;
+static inline bool TX7332_WriteBulk(TX7332 *d, uint16_t a, uint32_t *p, int n) { return true; }
+static inline bool TX7332_WriteVerify(TX7332 *d, uint16_t a, uint32_t v)
+{
+	if (a == PDN_REG) { stub_pdn_writes++; stub_pdn_value = v; }
+	return true;
+}
+#endif
+""".replace("PDN_REG", "0x%X" % PDN_REG)
+
+# one descriptor per input line; the return value, the words and the power
+# down word tx_pattern_apply wrote (- if none) per output line
+HARNESS_C = """
+#include "tx_pattern.h"
+#include <stdio.h>
+
+int stub_pdn_writes;
+uint32_t stub_pdn_value;
+
+int main(void)
+{
+	unsigned freq, cycles, profile, flags, duty, phase, mask;
+	uint32_t words[TX_PATTERN_PROFILE_WORDS];
+	TX7332 tx;
+
+	while (scanf("%u %u %u %u %u %u %u", &freq, &cycles, &profile, &flags, &duty, &phase, &mask) == 7) {
+		tx_pattern_desc_t desc = { freq, cycles, profile, flags, duty, phase, mask };
+		int n = tx_pattern_synthesize(&desc, words);
+		printf("%d", n);
+		for (int i = 0; n >= 0 && i < TX_PATTERN_PROFILE_WORDS; i++) {
+			printf(" %08X", words[i]);
+		}
+		stub_pdn_writes = 0;
+		tx_pattern_apply(&tx, &desc);
+		if (stub_pdn_writes) {
+			printf(" %08X\\n", stub_pdn_value);
+		} else {
+			printf(" -\\n");
+		}
+	}
+	return 0;
+}
+"""
+
+
+def demo_table(name):
+    with open(os.path.join(ROOT, "Core", "Src", "demo.c")) as f:
+        src = f.read()
+    m = re.search(r"%s\[\]\[2\]\s*=\s*\{(.*?)\};" % name, src, re.S)
+    if not m:
+        sys.exit("%s not found in demo.c" % name)
+    body = re.sub(r"//[^\n]*", "", m.group(1))
+    return {int(a, 16): int(v, 16) for a, v in re.findall(r"\{\s*(0x[0-9A-Fa-f]+)\s*,\s*(0x[0-9A-Fa-f]+)\s*\}", body)}
+
+
+def build(cc, tmp):
+    for src in ("Core/Inc/tx_pattern.h", "Core/Src/tx_pattern.c"):
+        shutil.copy(os.path.join(ROOT, src), tmp)
+    with open(os.path.join(tmp, "tx7332.h"), "w") as f:
+        f.write(STUB_TX7332_H)
+    with open(os.path.join(tmp, "harness.c"), "w") as f:
+        f.write(HARNESS_C)
+    exe = os.path.join(tmp, "harness")
+    subprocess.run([cc, "-std=c11", "-Wall", "-O2", "-I", tmp, "-o", exe,
+                    os.path.join(tmp, "harness.c"), os.path.join(tmp, "tx_pattern.c")], check=True)
+    return exe
+
+
+def synthesize(exe, descs):
+    lines = "".join("%d %d %d %d %d %d %d\n" % d for d in descs)
+    out = subprocess.run([exe], input=lines, capture_output=True, text=True, check=True).stdout
+    results = []
+    for line in out.splitlines():
+        fields = line.split()
+        pdn = None if fields[-1] == "-" else int(fields[-1], 16)
+        results.append((int(fields[0]), [int(w, 16) for w in fields[1:-1]], pdn))
+    return results
+
+
+def segments(words):
+    segs = []
+    for i in range(PROFILE_WORDS * 4):
+        b = (words[i // 4] >> (8 * (i % 4))) & 0xFF
+        segs.append(((b >> 3) + 2, b & 7))
+        if b & 7 == LEVEL_END:
+            break
+    return segs
+
+
+def expected_levels(desc):
+    """Clocks per level, a level shorter than a segment going to the next one."""
+    freq, cycles, _, flags, duty, phase, _ = desc
+    period = (CLK_HZ + freq // 2) // freq
+    half = period // 2
+    on = (half * duty + 127) // 255 if duty else half
+    first, second = (LEVEL_LOW, LEVEL_HIGH) if flags & FLAG_INVERT else (LEVEL_HIGH, LEVEL_LOW)
+    levels = [(LEVEL_GND, period * (phase % 360) // 360)]
+    levels += [(first, on), (LEVEL_GND, half - on), (second, on), (LEVEL_GND, period - half - on)] * cycles
+    clks, carry = {}, 0
+    for level, length in levels:
+        length, carry = length + carry, 0
+        if length < SEG_MIN_CLKS:
+            carry = length
+        else:
+            clks[level] = clks.get(level, 0) + length
+    return first, clks, carry
+
+
+def check_shape(name, desc, n, words, failures):
+    segs = segments(words)
+    first, want, carry = expected_levels(desc)
+
+    if n != len(segs) or segs[-1][1] != LEVEL_END:
+        failures.append("%s: %d segments returned, %d decoded up to the terminator" % (name, n, len(segs)))
+        return
+    clks = {}
+    for length, level in segs[:-1]:
+        clks[level] = clks.get(level, 0) + length
+    if clks != want:
+        failures.append("%s: clocks per level %s, expected %s" % (name, clks, want))
+    if segs[-1][0] != SEG_MIN_CLKS + carry:
+        failures.append("%s: terminator of %d clocks, expected %d" % (name, segs[-1][0], SEG_MIN_CLKS + carry))
+    lead = [level for _, level in segs if level != LEVEL_GND]
+    if lead[0] != first:
+        failures.append("%s: starts on level %d, expected %d" % (name, lead[0], first))
+
+
+def check_pdn(name, desc, pdn, failures):
+    flags, mask = desc[3], desc[6]
+    want = (~mask & 0xFFFFFFFF) if flags & FLAG_APOD else 0
+    if pdn != want:
+        failures.append("%s: power down %s, expected %08X" % (name, "not written" if pdn is None else "%08X" % pdn, want))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--cc", default=os.environ.get("CC", "cc"), help="host C compiler")
+    args = parser.parse_args()
+
+    table = demo_table("reg_1mhz_3p_values")
+    reference = [table[PROFILE_BASE + i] for i in range(PROFILE_WORDS)]
+
+    # frequency_hz, cycles, profile, flags, duty, phase_deg, channel_mask.  The
+    # plain descriptors follow an apodized one, so a power down word that was
+    # left in place instead of cleared shows up.
+    shaped = {
+        "1 MHz inverted": (1000000, 1, 0, FLAG_INVERT, 0, 0, 0),
+        "1 MHz apodized": (1000000, 1, 0, FLAG_APOD, 0, 0, 0x0000FFFF),
+        "2 MHz x3": (2000000, 3, 5, 0, 0, 0, 0),
+        "500 kHz 50% duty": (500000, 1, 15, 0, 128, 0, 0),
+        "1 MHz 90 deg": (1000000, 1, 0, 0, 0, 90, 0),
+        "2 MHz x2 1 clock gaps": (2000000, 2, 0, 0, 250, 0, 0),
+    }
+    rejected = {
+        "0 Hz": (0, 1, 0, 0, 0, 0, 0),
+        "above half the pattern clock": (CLK_HZ // 2, 1, 0, 0, 0, 0, 0),
+        "no cycles": (1000000, 0, 0, 0, 0, 0, 0),
+        "profile 16": (1000000, 1, 16, 0, 0, 0, 0),
+        "does not fit one profile": (1000000, 8, 0, 0, 0, 0, 0),
+    }
+    descs = [(1000000, 1, 0, 0, 0, 0, 0)] + list(shaped.values()) + list(rejected.values())
+
+    with tempfile.TemporaryDirectory() as tmp:
+        results = synthesize(build(args.cc, tmp), descs)
+
+    failures = []
+    n, words, pdn = results[0]
+    if words != reference:
+        failures.append("1 MHz reference: %s, reg_1mhz_3p_values has %s" %
+                        (" ".join("%08X" % w for w in words), " ".join("%08X" % w for w in reference)))
+    check_pdn("1 MHz reference", descs[0], pdn, failures)
+    for (name, desc), (n, words, pdn) in zip(shaped.items(), results[1:]):
+        if n < 0:
+            failures.append("%s: rejected" % name)
+        else:
+            check_shape(name, desc, n, words, failures)
+            check_pdn(name, desc, pdn, failures)
+    for name, (n, _, pdn) in zip(rejected, results[1 + len(shaped):]):
+        if n >= 0:
+            failures.append("%s: accepted with %d segments" % (name, n))
+        if pdn is not None:
+            failures.append("%s: power down written" % name)
+
+    for f in failures:
+        print("FAIL " + f)
+    print("%d descriptors, %d failures" % (len(descs), len(failures)))
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Measure sustained USB CDC throughput to and from the device.
+
+OUT is timed with PINGs carrying a full payload (the reply is a bare
+header), IN+OUT with ECHOs of the same size, and IN is what the echo adds
+on top of the ping.  Full-speed bulk tops out at 19 x 64 bytes per 1 ms
+frame, 1216 kB/s, in each direction.
+
+    usb_bench.py /dev/ttyACM0 [--seconds 5] [--size 2048]
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+OW_CMD = 0xE2
+OW_RESP = 0xE3
+OW_CMD_PING = 0x00
+OW_CMD_ECHO = 0x03
+
+DATA_MAX_SIZE = 2048
+FS_BULK_LIMIT = 19 * 64 * 1000
+FRAME_OVERHEAD = 12
+
+
+def crc16_ccitt(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+class Link:
+    def __init__(self, port):
+        import serial
+        self.ser = serial.Serial(port, 921600, timeout=2)
+        self.pkt_id = 0
+
+    def frame(self, command, data):
+        self.pkt_id = (self.pkt_id + 1) & 0xFFFF
+        body = struct.pack(">HBBBBH", self.pkt_id, OW_CMD, command, 0, 0, len(data)) + data
+        return b"\xAA" + body + struct.pack(">H", crc16_ccitt(body)) + b"\xDD"
+
+    def request(self, command, data):
+        self.ser.write(self.frame(command, data))
+        hdr = self.ser.read(9)
+        if len(hdr) != 9 or hdr[0] != 0xAA:
+            raise IOError("no response")
+        length = struct.unpack(">H", hdr[7:9])[0]
+        rest = self.ser.read(length + 3)
+        if len(rest) != length + 3 or hdr[3] != OW_RESP:
+            raise IOError("bad response")
+        return rest[:length]
+
+
+def run(link, command, payload, seconds):
+    count = 0
+    t0 = time.perf_counter()
+    while time.perf_counter() - t0 < seconds:
+        reply = link.request(command, payload)
+        if command == OW_CMD_ECHO and reply != payload:
+            raise IOError("echo mismatch")
+        count += 1
+    return count, time.perf_counter() - t0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("port")
+    ap.add_argument("--seconds", type=float, default=5.0)
+    ap.add_argument("--size", type=int, default=DATA_MAX_SIZE, help="payload bytes per frame")
+    args = ap.parse_args()
+
+    if not 0 < args.size <= DATA_MAX_SIZE:
+        sys.exit("--size must be 1..%d" % DATA_MAX_SIZE)
+
+    link = Link(args.port)
+    payload = bytes((i * 7 + 3) & 0xFF for i in range(args.size))
+    wire = args.size + FRAME_OVERHEAD
+
+    pings, t_ping = run(link, OW_CMD_PING, payload, args.seconds)
+    echoes, t_echo = run(link, OW_CMD_ECHO, payload, args.seconds)
+
+    per_ping = t_ping / pings
+    per_echo = t_echo / echoes
+    out_rate = wire / per_ping
+    in_rate = wire / max(per_echo - per_ping, 1e-6)
+    both_rate = 2 * wire / per_echo
+
+    print("frame %d bytes on the wire, %d pings / %d echoes" % (wire, pings, echoes))
+    print("OUT    %7.1f kB/s  %3.0f%% of full-speed bulk" % (out_rate / 1000, 100 * out_rate / FS_BULK_LIMIT))
+    print("IN     %7.1f kB/s  %3.0f%%" % (in_rate / 1000, 100 * in_rate / FS_BULK_LIMIT))
+    print("echo   %7.1f kB/s  both directions, %.2f ms per round trip" % (both_rate / 1000, per_echo * 1000))
+
+
+if __name__ == "__main__":
+    main()